@@ -0,0 +1,23 @@
+// EpochClock.h — wall-clock seconds for stamps and periods that must survive
+// a reboot (outbox records, the data-budget period).
+//
+// The RTC starts at 1970 until NTP or the modem sets it, so anything before
+// 2020 is reported as 0, "not synced yet", rather than as a bogus date.
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+namespace hyphen {
+namespace wallclock {
+
+const time_t kSyncedAfter = 1577836800;  // 2020-01-01T00:00:00Z
+
+// Unix time, or 0 while the clock is unset.
+inline uint32_t epochNow() {
+  time_t now = time(nullptr);
+  return now > kSyncedAfter ? (uint32_t)now : 0;
+}
+
+}  // namespace wallclock
+}  // namespace hyphen
@@ -2,4 +2,5 @@
 #include "managers/SubscriptionManager.h"
 #include "managers/LightManager.h"
 #include "managers/FileManager.h"
+#include "managers/Outbox.h"
 #include "managers/LoggingManager.h"
@@ -1,6 +1,7 @@
 #include <ArduinoLog.h>
 #include <Arduino.h>
 #include "managers/CoreDelay.h"
+#include "connections/TlsSession.h"
 #ifndef connection_h
 #define connection_h
 
@@ -44,6 +45,14 @@ public:
                         const char *domainName = nullptr) = 0;
     // virtual bool verify(const char *fp, uint16_t port) = 0;
     virtual void setClient(Client *) = 0;
+    ///--- Session resumption (optional) ---
+    // Hooks only: a transport that can hand mbedTLS a previous session
+    // before its handshake overrides these. The bundled WiFi and cellular
+    // clients handshake inside connect() and keep the defaults, which mean
+    // "unsupported", so every connect is a full handshake.
+    virtual size_t exportSession(uint8_t *, size_t) { return 0; }
+    virtual bool offerSession(const uint8_t *, size_t) { return false; }
+    virtual bool sessionResumed() { return false; }
     // Allow connect() overload that configures certs inline
     using Client::connect;
     virtual int connect(const char *host, uint16_t port,
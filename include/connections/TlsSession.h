@@ -0,0 +1,97 @@
+#ifndef __tls_session_h
+#define __tls_session_h
+#include <Arduino.h>
+
+#ifndef TLS_SESSION_MAX_BYTES
+#define TLS_SESSION_MAX_BYTES 1024 // largest serialized TLS session kept for resumption
+#endif
+
+/**
+ * @brief one serialized TLS session, laid out to live in RTC memory so it
+ * survives deep sleep and soft resets. Nothing in it is trusted until
+ * TlsSessionStore has checked the magic, endpoint and checksum.
+ */
+struct TlsSession
+{
+    uint32_t magic;
+    uint32_t endpoint;
+    uint32_t checksum;
+    uint16_t length;
+    uint8_t data[TLS_SESSION_MAX_BYTES];
+};
+
+struct TlsStats
+{
+    uint32_t handshakes = 0; // successful transport connects
+    uint32_t resumed = 0;    // of those, abbreviated handshakes
+    uint32_t failed = 0;
+    unsigned long lastHandshakeMs = 0;
+    unsigned long maxHandshakeMs = 0;
+};
+
+/**
+ * @brief validates and updates a TlsSession slot for one broker endpoint
+ */
+class TlsSessionStore
+{
+public:
+    TlsSessionStore(TlsSession &slot) : slot(slot) {}
+
+    /**
+     * @brief the stored session for host:port, or nullptr if there is none or
+     * the slot holds garbage (first boot, brown-out, another endpoint)
+     */
+    const TlsSession *find(const char *host, uint16_t port)
+    {
+        if (slot.magic != MAGIC || slot.length == 0 || slot.length > TLS_SESSION_MAX_BYTES ||
+            slot.endpoint != endpointKey(host, port) || slot.checksum != fnv1a(slot.data, slot.length))
+        {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    /**
+     * @brief refills the slot in place: `fill(data, capacity)` writes the
+     * serialized session and returns its length (0 leaves the slot empty)
+     */
+    template <typename Fill>
+    bool update(const char *host, uint16_t port, Fill fill)
+    {
+        slot.magic = 0;
+        size_t length = fill(slot.data, (size_t)TLS_SESSION_MAX_BYTES);
+        if (length == 0 || length > TLS_SESSION_MAX_BYTES)
+        {
+            return false;
+        }
+        slot.length = length;
+        slot.endpoint = endpointKey(host, port);
+        slot.checksum = fnv1a(slot.data, length);
+        slot.magic = MAGIC;
+        return true;
+    }
+
+    void clear() { slot.magic = 0; }
+
+private:
+    static const uint32_t MAGIC = 0x544C5331; // "TLS1"
+    TlsSession &slot;
+
+    static uint32_t fnv1a(const uint8_t *data, size_t length, uint32_t hash = 2166136261u)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    static uint32_t endpointKey(const char *host, uint16_t port)
+    {
+        uint32_t hash = fnv1a((const uint8_t *)host, strlen(host));
+        uint8_t p[2] = {(uint8_t)(port >> 8), (uint8_t)port};
+        return fnv1a(p, 2, hash);
+    }
+};
+
+#endif
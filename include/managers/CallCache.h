@@ -0,0 +1,138 @@
+#ifndef __call_cache_h
+#define __call_cache_h
+#include <Arduino.h>
+#include <array>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#ifndef CALL_CACHE_SIZE
+#define CALL_CACHE_SIZE 8 // recently handled function calls remembered to answer redeliveries
+#endif
+
+#ifndef CALL_CACHE_ID_BYTES
+#define CALL_CACHE_ID_BYTES 64 // longest "<function>/<callId>" remembered; longer calls are not deduplicated
+#endif
+
+struct CallCacheStats
+{
+    uint32_t hits = 0;      // redeliveries answered from the cache
+    uint32_t misses = 0;    // calls run
+    uint32_t evictions = 0; // entries displaced by newer calls
+    uint32_t uncached = 0;  // calls with an id too long to remember
+};
+
+/**
+ * @brief remembers the results of the last CALL_CACHE_SIZE function calls by
+ * function name and call id. A persistent session may redeliver a request
+ * after a reconnect; the cached result is published again instead of running
+ * the function twice. Least recently used entries are evicted first.
+ */
+class CallCache
+{
+public:
+    CallCache() : mutex(xSemaphoreCreateMutex()) {}
+
+    /**
+     * @brief looks up a call, counting a hit or a miss
+     *
+     * @return true - the call was handled before; `result` holds its value
+     */
+    bool find(const char *key, const char *callId, int &result)
+    {
+        Lock lock(mutex);
+        for (auto &entry : entries)
+        {
+            if (entry.used && matches(entry, key, callId))
+            {
+                entry.lastUsed = ++clock;
+                result = entry.result;
+                stats.hits++;
+                return true;
+            }
+        }
+        stats.misses++;
+        return false;
+    }
+
+    /**
+     * @brief records the result of a call that just ran
+     */
+    void remember(const char *key, const char *callId, int result)
+    {
+        Lock lock(mutex);
+        size_t keyLength = strlen(key);
+        size_t idLength = strlen(callId);
+        if (keyLength + 1 + idLength + 1 > CALL_CACHE_ID_BYTES)
+        {
+            stats.uncached++;
+            return;
+        }
+        Entry *slot = &entries[0];
+        for (auto &entry : entries)
+        {
+            if (!entry.used)
+            {
+                slot = &entry;
+                break;
+            }
+            if (entry.lastUsed < slot->lastUsed)
+            {
+                slot = &entry;
+            }
+        }
+        if (slot->used)
+        {
+            stats.evictions++;
+        }
+        memcpy(slot->id, key, keyLength);
+        slot->id[keyLength] = '/';
+        memcpy(slot->id + keyLength + 1, callId, idLength + 1);
+        slot->keyLength = keyLength;
+        slot->result = result;
+        slot->lastUsed = ++clock;
+        slot->used = true;
+    }
+
+    void clear()
+    {
+        Lock lock(mutex);
+        for (auto &entry : entries)
+        {
+            entry.used = false;
+        }
+    }
+
+    CallCacheStats getStats()
+    {
+        Lock lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        char id[CALL_CACHE_ID_BYTES]; // "<key>/<callId>"
+        size_t keyLength = 0;
+        int result = 0;
+        uint32_t lastUsed = 0;
+        bool used = false;
+    };
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    SemaphoreHandle_t mutex;
+    std::array<Entry, CALL_CACHE_SIZE> entries;
+    uint32_t clock = 0; // use counter ordering the entries
+    CallCacheStats stats;
+
+    static bool matches(const Entry &entry, const char *key, const char *callId)
+    {
+        return strncmp(entry.id, key, entry.keyLength) == 0 && key[entry.keyLength] == '\0' &&
+               strcmp(entry.id + entry.keyLength + 1, callId) == 0;
+    }
+};
+
+#endif
@@ -2,45 +2,133 @@
 #define COMMUNICATION_REGISTRY_H
 #include <Arduino.h>
 #include <ArduinoLog.h>
-#include <unordered_map>
 #include <functional>
-#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
+#include "managers/TopicIndex.h"
+#include "managers/Snapshot.h"
+#ifndef TEXT_CALLBACK_STACK_BYTES
+#define TEXT_CALLBACK_STACK_BYTES 256 // payloads below this reach text callbacks via a stack copy
+#endif
+#ifndef REGISTRY_READER_SLOTS
+#define REGISTRY_READER_SLOTS 4 // registry reads (dispatches, lookups) that may run at once, nested ones included
+#endif
+#ifndef REGISTRY_MAX_FILTERS
+#define REGISTRY_MAX_FILTERS 30 // topic filters that can be registered at once
+#endif
+#ifndef REGISTRY_MAX_CALLBACKS
+#define REGISTRY_MAX_CALLBACKS (REGISTRY_MAX_FILTERS * 2) // callbacks across all filters, any number per filter
+#endif
+#ifndef REGISTRY_MAX_NODES
+#define REGISTRY_MAX_NODES (REGISTRY_MAX_FILTERS * 4) // topic index nodes: one per filter level not shared with another filter
+#endif
+
+struct RegistryStats
+{
+    size_t filters = 0;
+    size_t filtersHighWater = 0;
+    size_t callbacks = 0;
+    size_t callbacksHighWater = 0;
+    size_t nodes = 0; // topic index nodes, the root included
+    size_t nodesHighWater = 0;
+    uint32_t rejected = 0; // registrations refused because a pool was full or the filter invalid
+};
+
+/**
+ * @brief Maps topic filters to callbacks. Filters, callbacks and the topic
+ * index live in fixed pools sized by REGISTRY_MAX_FILTERS,
+ * REGISTRY_MAX_CALLBACKS and REGISTRY_MAX_NODES; registering fails when one
+ * is full instead of growing. Dispatch and lookups run under a snapshot
+ * without locking, so a subscribe or unsubscribe on another core never stalls
+ * or tears an in-progress dispatch. Only the filter order is versioned (two
+ * bytes per filter): the compiled filters, callbacks and topic index nodes are
+ * shared, changed in place so that a running dispatch sees a concurrent change
+ * whole or not at all, and reused only once no reader holds a snapshot from
+ * before they were removed.
+ */
 class CommunicationRegistry
 {
 
 public:
+    typedef std::function<void(const char *, const uint8_t *, size_t)> Callback;
     // Delete copy constructor and assignment operator to prevent copying
-    static const size_t CALLBACK_SIZE = 30;
     CommunicationRegistry(const CommunicationRegistry &) = delete;
     CommunicationRegistry &operator=(const CommunicationRegistry &) = delete;
     static CommunicationRegistry &getInstance();
-    // Method to register a callback for a specific topic
+    // Method to register a callback for a specific topic. False when the
+    // filter is invalid or a pool is full.
+    bool registerCallback(const std::string &topic, Callback callback);
+    // Text callbacks are adapted onto the binary path and receive a
+    // NUL-terminated copy of the payload.
     bool registerCallback(const std::string &topic, std::function<void(const char *, const char *)> callback);
     bool unregisterCallback(const std::string &topic);
-    // Method to trigger all callbacks for a specific topic
-    void triggerCallbacks(const std::string &topic, const char *payload);
+    // Method to trigger all callbacks for a specific topic. The payload is
+    // passed through as-is (it may contain NULs and is not terminated).
+    void triggerCallbacks(const char *topic, const uint8_t *payload, size_t length);
+    void triggerCallbacks(const char *topic, const char *payload);
+    // true when any registered filter matches the topic
     bool hasCallback(const std::string &topic);
-    const std::array<std::string, CALLBACK_SIZE> &getCallbacks();
+    // true when exactly this filter is registered
+    bool hasFilter(const std::string &filter);
+    // the registered filters, in registration order
+    std::vector<std::string> getCallbacks();
     size_t getCallbackCount();
     void iterateCallbacks(std::function<void(const char *)> callback);
+    // snapshots published so far, and replaced ones still held by a reader
+    uint32_t getVersion();
+    size_t getPendingReclaim();
+    RegistryStats getStats();
 
 private:
-    // SemaphoreHandle_t _mutex;
-    static CommunicationRegistry instance;
-    // std::function<void(char *, byte *, unsigned int)> mqttCallbackFunction;
-    std::array<std::string, CALLBACK_SIZE> callbacks;
-    size_t callbackCount = 0;
-    u_int8_t hasWildCard(String);
-    String callbackName(String);
-    bool matchCallback(String, String);
-    int callbackIndex(const std::string &topic);
-    void addCallback(const std::string &topic);
+    static const uint16_t NONE = 0xFFFF;
+    // Pool entries are written only while no published snapshot names them;
+    // `retiredAt` is the snapshot that dropped the entry, reusable once every
+    // held snapshot is at least that recent.
+    struct FilterSlot
+    {
+        std::atomic<uint16_t> head{NONE}; // first callback
+        uint16_t tail = NONE;
+        bool live = false;
+        uint32_t retiredAt = 0;
+    };
+    struct CallbackSlot
+    {
+        Callback callback;
+        std::atomic<uint16_t> next{NONE};
+        bool live = false;
+        uint32_t retiredAt = 0;
+    };
+    // one immutable version of the registry: which filter slots are
+    // registered, in order
+    struct Table
+    {
+        uint32_t serial = 0;
+        uint16_t order[REGISTRY_MAX_FILTERS];
+        size_t count = 0;
+    };
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    TopicFilter filters[REGISTRY_MAX_FILTERS]; // compiled once, apart from the slots so the index can read them
+    FilterSlot filterSlots[REGISTRY_MAX_FILTERS];
+    CallbackSlot callbacks[REGISTRY_MAX_CALLBACKS];
+    TopicIndex<REGISTRY_MAX_NODES> index; // changed in place by the writer, read under a snapshot
+    Snapshot<Table, REGISTRY_READER_SLOTS> table;
+    SemaphoreHandle_t writeMutex; // serializes writers; readers never take it
+    RegistryStats stats;
     CommunicationRegistry();
-    std::unordered_map<std::string, std::array<std::function<void(const char *, const char *)>, 3>> topicCallbacks;
     // Destructor is private to control destruction
     ~CommunicationRegistry() = default;
+    int find(const Table &current, const std::string &filter);
+    uint32_t oldestHeld();
+    int allocateFilter(uint32_t oldest);
+    int allocateCallback(uint32_t oldest);
 };
 
 #endif // COMMUNICATION_REGISTRY_H
\ No newline at end of file
@@ -4,19 +4,27 @@
 #include <ArduinoLog.h>
 #include "FS.h"     // File system for SPIFFS
 #include "SPIFFS.h" // ESP32 SPIFFS
+#include <memory>
+#include <new>
 
 class FileManager
 {
 private:
     bool isRunning = false;
+    // SPIFFS is a single global mount shared by every FileManager (certificates,
+    // outbox). Count the holders so one owner's end() doesn't unmount it from
+    // under another.
+    static uint8_t mounts;
 
 public:
     FileManager();
     String loadFileContents(const char *name);
     String fileContentsOpen(const char *name);
+    size_t loadFileBuffer(const char *name, std::unique_ptr<char[]> &out);
     bool start();
     void end();
     bool running();
+    fs::FS &fs();
 };
 
 #endif // __FILE_MANAGER_H_
\ No newline at end of file
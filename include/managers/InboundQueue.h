@@ -0,0 +1,343 @@
+#ifndef __inbound_queue_h
+#define __inbound_queue_h
+#include <Arduino.h>
+#include <functional>
+#include <array>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "managers/MessageRing.h"
+
+#ifndef INBOUND_QUEUE_BYTES
+#define INBOUND_QUEUE_BYTES 4096 // arena holding received messages until the worker dispatches them
+#endif
+
+#ifndef INBOUND_QUEUE_DEPTH
+#define INBOUND_QUEUE_DEPTH 16 // max received messages awaiting dispatch
+#endif
+
+#ifndef INBOUND_POLICY_RULES
+#define INBOUND_POLICY_RULES 8 // topic-prefix overflow policies that can be configured
+#endif
+
+#ifndef INBOUND_BLOCK_MS
+#define INBOUND_BLOCK_MS 200 // longest a BLOCK topic holds up the receive loop waiting for room
+#endif
+
+/**
+ * @brief what happens to a received message when the inbound queue is full
+ */
+enum class InboundPolicy
+{
+    DROP_OLDEST, // discard the oldest waiting messages to make room (the default)
+    COALESCE,    // replace a waiting message on the same topic, else drop the oldest
+    BLOCK        // wait up to INBOUND_BLOCK_MS for room, then drop the new message
+};
+
+struct InboundStats
+{
+    uint32_t received = 0;
+    uint32_t dispatched = 0;
+    uint32_t inlined = 0;   // too large for the queue, dispatched on the receive loop
+    uint32_t dropped = 0;   // discarded for lack of room
+    uint32_t coalesced = 0; // replaced by a newer message on the same topic
+    uint32_t blocked = 0;   // had to wait for room
+    uint32_t highWater = 0;
+    unsigned long lastWaitMs = 0; // queueing time of the last dispatched message
+    unsigned long maxWaitMs = 0;
+};
+
+/**
+ * @brief bounded hand-off from the MQTT receive loop to the dispatch worker.
+ * The receive loop copies each message in and returns at once; the worker is
+ * the single consumer and runs the callbacks outside the lock, straight from
+ * the ring. The message being dispatched is never discarded: overflow evicts
+ * the messages queued behind it, and when it alone leaves too little room a
+ * new message is dropped instead.
+ */
+class InboundQueue
+{
+public:
+    InboundQueue() : mutex(xSemaphoreCreateMutex()), ready(xSemaphoreCreateBinary()), room(xSemaphoreCreateBinary()) {}
+
+    /**
+     * @brief sets the overflow policy for topics starting with `prefix`; the
+     * longest matching prefix applies and "" sets the default
+     *
+     * @return false - the rule table is full
+     */
+    bool setPolicy(const char *prefix, InboundPolicy policy)
+    {
+        Lock lock(mutex);
+        Rule *rule = nullptr;
+        for (auto &r : rules)
+        {
+            if (r.used && r.prefix == prefix)
+            {
+                rule = &r;
+                break;
+            }
+        }
+        for (auto &r : rules)
+        {
+            if (!rule && !r.used)
+            {
+                rule = &r;
+            }
+        }
+        if (!rule)
+        {
+            return false;
+        }
+        rule->used = true;
+        rule->prefix = prefix;
+        rule->policy = policy;
+        return true;
+    }
+
+    /**
+     * @brief true when a message this size can ever be queued
+     */
+    static bool fits(const char *topic, size_t length)
+    {
+        return strlen(topic) + length + 2 <= INBOUND_QUEUE_BYTES;
+    }
+
+    /**
+     * @brief copies a received message in for the worker
+     *
+     * @return false - the message was dropped
+     */
+    bool push(const char *topic, const uint8_t *payload, size_t length)
+    {
+        unsigned long waitedFrom = millis();
+        bool waited = false;
+        while (true)
+        {
+            // clear a stale wake-up before looking, so a wait below only
+            // returns for a dispatch that happened after this check
+            xSemaphoreTake(room, 0);
+            uint32_t seen;
+            {
+                Lock lock(mutex);
+                InboundPolicy policy = policyFor(topic);
+                if (policy != InboundPolicy::BLOCK)
+                {
+                    makeRoom(topic, length, policy == InboundPolicy::COALESCE);
+                }
+                Entry entry;
+                entry.queuedAt = millis();
+                if (ring.push(topic, payload, length, entry))
+                {
+                    if (policy == InboundPolicy::COALESCE)
+                    {
+                        coalesce(topic);
+                    }
+                    stats.received++;
+                    if (ring.size() > stats.highWater)
+                    {
+                        stats.highWater = ring.size();
+                    }
+                    xSemaphoreGive(ready);
+                    return true;
+                }
+                if (policy != InboundPolicy::BLOCK || millis() - waitedFrom >= INBOUND_BLOCK_MS)
+                {
+                    stats.dropped++;
+                    return false;
+                }
+                if (!waited)
+                {
+                    stats.blocked++;
+                    waited = true;
+                }
+                seen = popped;
+            }
+            TickType_t left = pdMS_TO_TICKS(INBOUND_BLOCK_MS - (millis() - waitedFrom));
+            bool woke = xSemaphoreTake(room, left) == pdTRUE;
+            Lock lock(mutex);
+            if (!woke || popped == seen)
+            {
+                stats.dropped++;
+                return false;
+            }
+        }
+    }
+
+    /**
+     * @brief dispatches the oldest waiting message through `deliver`, waiting
+     * up to `wait` ticks for one to arrive. Only the worker calls this.
+     *
+     * @return false - nothing arrived in time
+     */
+    bool dispatchNext(std::function<void(const char *, const uint8_t *, size_t)> deliver, TickType_t wait = 0)
+    {
+        Ring::View view;
+        if (!take(view) && (wait == 0 || xSemaphoreTake(ready, wait) != pdTRUE || !take(view)))
+        {
+            return false;
+        }
+        unsigned long waitMs = millis() - view.meta->queuedAt;
+        deliver(view.topic, view.payload, view.length);
+        {
+            Lock lock(mutex);
+            ring.pop();
+            popped++;
+            busy = false;
+            stats.dispatched++;
+            stats.lastWaitMs = waitMs;
+            if (waitMs > stats.maxWaitMs)
+            {
+                stats.maxWaitMs = waitMs;
+            }
+        }
+        xSemaphoreGive(room);
+        return true;
+    }
+
+    /**
+     * @brief counts a message that bypassed the queue
+     */
+    void recordInline()
+    {
+        Lock lock(mutex);
+        stats.inlined++;
+    }
+
+    size_t size()
+    {
+        Lock lock(mutex);
+        return ring.size();
+    }
+
+    InboundStats getStats()
+    {
+        Lock lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        unsigned long queuedAt = 0;
+        bool coalesced = false; // superseded; popped without dispatch
+    };
+    struct Rule
+    {
+        bool used = false;
+        String prefix;
+        InboundPolicy policy = InboundPolicy::DROP_OLDEST;
+    };
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    typedef MessageRing<INBOUND_QUEUE_BYTES, INBOUND_QUEUE_DEPTH, Entry> Ring;
+
+    SemaphoreHandle_t mutex;
+    SemaphoreHandle_t ready; // given on every push, wakes the worker
+    SemaphoreHandle_t room;  // given on every dispatch, wakes a BLOCK push
+    std::array<Rule, INBOUND_POLICY_RULES> rules;
+    Ring ring;
+    InboundStats stats;
+    bool busy = false;   // the front entry is being dispatched
+    uint32_t popped = 0; // dispatches so far, to tell a real wake-up from a timeout
+
+    InboundPolicy policyFor(const char *topic)
+    {
+        const Rule *best = nullptr;
+        for (const auto &rule : rules)
+        {
+            size_t n = rule.prefix.length();
+            if (rule.used && strncmp(topic, rule.prefix.c_str(), n) == 0 && (!best || n > best->prefix.length()))
+            {
+                best = &rule;
+            }
+        }
+        return best ? best->policy : InboundPolicy::DROP_OLDEST;
+    }
+
+    // marks the messages waiting on `topic` before the one just pushed as
+    // superseded by it
+    void coalesce(const char *topic)
+    {
+        for (size_t i = busy ? 1 : 0; i + 1 < ring.size(); i++)
+        {
+            Ring::View entry = ring.at(i);
+            if (!entry.meta->coalesced && strcmp(entry.topic, topic) == 0)
+            {
+                entry.meta->coalesced = true;
+                stats.coalesced++;
+            }
+        }
+    }
+
+    bool hasRoom(size_t need)
+    {
+        return !ring.full() && ring.freeBytes() >= need;
+    }
+
+    // evicts waiting messages until the new one fits: superseded ones first,
+    // then (when coalescing) earlier ones on its topic, then the oldest. The
+    // message in dispatch is never evicted, and nothing is when the new one
+    // would not fit beside it anyway.
+    void makeRoom(const char *topic, size_t length, bool coalescing)
+    {
+        size_t need = strlen(topic) + length + 2;
+        size_t keep = busy ? 1 : 0;
+        if (need > ring.largestFree(keep) || Ring::capacity() <= keep)
+        {
+            return;
+        }
+        for (size_t i = keep; i < ring.size() && !hasRoom(need);)
+        {
+            if (ring.at(i).meta->coalesced)
+            {
+                ring.erase(i);
+                continue;
+            }
+            i++;
+        }
+        for (size_t i = keep; coalescing && i < ring.size() && !hasRoom(need);)
+        {
+            if (strcmp(ring.at(i).topic, topic) == 0)
+            {
+                ring.erase(i);
+                stats.coalesced++;
+                continue;
+            }
+            i++;
+        }
+        while (ring.size() > keep && !hasRoom(need))
+        {
+            ring.erase(keep);
+            stats.dropped++;
+        }
+    }
+
+    // pops superseded messages at the front
+    void skipCoalesced()
+    {
+        while (!busy && !ring.empty() && ring.front().meta->coalesced)
+        {
+            ring.pop();
+        }
+    }
+
+    // claims the front message for dispatch
+    bool take(Ring::View &view)
+    {
+        Lock lock(mutex);
+        skipCoalesced();
+        if (ring.empty())
+        {
+            return false;
+        }
+        busy = true;
+        view = ring.front();
+        return true;
+    }
+};
+
+#endif
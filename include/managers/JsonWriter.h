@@ -0,0 +1,231 @@
+// JsonWriter.h — JSON written straight into a fixed buffer.
+//
+// A forward-only writer for small, fixed-shape documents such as function and
+// variable results: keys and values are appended as they are given, commas are
+// placed by tracking the nesting, and strings are escaped the way ArduinoJson
+// escapes them. Numbers are formatted without printf, which on newlib may
+// allocate for doubles, so writing never touches the heap.
+//
+// When the buffer runs out the writer stops writing but keeps counting:
+// overflowed() reports it and size() is the length the document needs, so a
+// caller can retry once with a buffer that fits.
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef JSON_WRITER_MAX_DEPTH
+#define JSON_WRITER_MAX_DEPTH 8  // deepest object/array nesting a JsonWriter tracks
+#endif
+
+static_assert(JSON_WRITER_MAX_DEPTH <= 32, "the nesting is tracked in a 32-bit mask");
+
+class JsonWriter {
+ public:
+  // `buf` receives the document and its terminator.
+  JsonWriter(char* buf, size_t capacity) : buf_(buf), capacity_(capacity) { terminate(); }
+
+  JsonWriter& beginObject() { return open('{'); }
+  JsonWriter& endObject() { return close('}'); }
+  JsonWriter& beginArray() { return open('['); }
+  JsonWriter& endArray() { return close(']'); }
+
+  JsonWriter& key(const char* name) { return key(name, strlen(name)); }
+  JsonWriter& key(const char* name, size_t length) {
+    separate();
+    quoted(name, length);
+    put(':');
+    afterKey_ = true;
+    return *this;
+  }
+
+  JsonWriter& value(const char* text) { return text ? value(text, strlen(text)) : null(); }
+  JsonWriter& value(const char* text, size_t length) {
+    separate();
+    quoted(text, length);
+    return *this;
+  }
+  JsonWriter& value(bool b) {
+    separate();
+    return raw(b ? "true" : "false");
+  }
+  JsonWriter& value(int n) { return value((long long)n); }
+  JsonWriter& value(long n) { return value((long long)n); }
+  JsonWriter& value(long long n) {
+    separate();
+    if (n < 0) {
+      put('-');
+      return digits(0 - (unsigned long long)n);
+    }
+    return digits((unsigned long long)n);
+  }
+  JsonWriter& value(unsigned int n) { return value((unsigned long long)n); }
+  JsonWriter& value(unsigned long n) { return value((unsigned long long)n); }
+  JsonWriter& value(unsigned long long n) {
+    separate();
+    return digits(n);
+  }
+  JsonWriter& value(float n) { return value((double)n); }
+  JsonWriter& value(double n);
+  JsonWriter& null() {
+    separate();
+    return raw("null");
+  }
+
+  // The document so far, always terminated (truncated after an overflow).
+  const char* c_str() const { return buf_; }
+  // Bytes the document takes (or would take), terminator excluded.
+  size_t size() const { return size_; }
+  bool overflowed() const { return size_ >= capacity_; }
+
+ private:
+  char* buf_;
+  size_t capacity_;
+  size_t size_ = 0;
+  uint32_t started_ = 0;  // bit d: the container at depth d has an element
+  uint8_t depth_ = 0;
+  bool afterKey_ = false;
+
+  void terminate() {
+    if (capacity_ > 0) buf_[size_ < capacity_ ? size_ : capacity_ - 1] = '\0';
+  }
+  void put(char c) {
+    if (size_ + 1 < capacity_) buf_[size_] = c;
+    size_++;
+    terminate();
+  }
+  JsonWriter& raw(const char* text) {
+    while (*text) put(*text++);
+    return *this;
+  }
+
+  // The comma before an element, unless it follows its key or opens a container.
+  void separate() {
+    if (afterKey_) {
+      afterKey_ = false;
+      return;
+    }
+    if (depth_ == 0) return;
+    uint32_t bit = 1u << (depth_ - 1);
+    if (started_ & bit) put(',');
+    started_ |= bit;
+  }
+  JsonWriter& open(char c) {
+    separate();
+    put(c);
+    if (depth_ < JSON_WRITER_MAX_DEPTH) {
+      depth_++;
+      started_ &= ~(1u << (depth_ - 1));
+    }
+    return *this;
+  }
+  JsonWriter& close(char c) {
+    if (depth_ > 0) depth_--;
+    put(c);
+    return *this;
+  }
+
+  void quoted(const char* text, size_t length) {
+    static const char kHex[] = "0123456789abcdef";
+    put('"');
+    for (size_t i = 0; i < length; i++) {
+      unsigned char c = (unsigned char)text[i];
+      const char* escape = nullptr;
+      switch (c) {
+        case '"': escape = "\\\""; break;
+        case '\\': escape = "\\\\"; break;
+        case '\b': escape = "\\b"; break;
+        case '\f': escape = "\\f"; break;
+        case '\n': escape = "\\n"; break;
+        case '\r': escape = "\\r"; break;
+        case '\t': escape = "\\t"; break;
+      }
+      if (escape) {
+        raw(escape);
+      } else if (c < 0x20) {
+        raw("\\u00");
+        put(kHex[c >> 4]);
+        put(kHex[c & 0x0F]);
+      } else {
+        put((char)c);
+      }
+    }
+    put('"');
+  }
+
+  JsonWriter& digits(unsigned long long n, int width = 1) {
+    char tmp[20];
+    int count = 0;
+    do {
+      tmp[count++] = (char)('0' + n % 10);
+      n /= 10;
+    } while (n > 0);
+    for (; count < width; width--) put('0');
+    while (count > 0) put(tmp[--count]);
+    return *this;
+  }
+};
+
+// Up to nine significant decimals after the point, trailing zeros dropped, and
+// an exponent outside [1e-5, 1e7) — the layout ArduinoJson uses. NaN and
+// infinities are not JSON and are written as null.
+inline JsonWriter& JsonWriter::value(double n) {
+  if (isnan(n) || isinf(n)) return null();
+  separate();
+  if (n < 0) {
+    put('-');
+    n = -n;
+  }
+  static const double kPowers[] = {1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256};
+  static const double kInversePowers[] = {1e-1, 1e-2, 1e-4, 1e-8, 1e-16, 1e-32, 1e-64, 1e-128, 1e-256};
+  int exponent = 0;
+  if (n >= 1e7) {
+    for (int i = 8; i >= 0; i--) {
+      if (n >= kPowers[i]) {
+        n /= kPowers[i];
+        exponent += 1 << i;
+      }
+    }
+  }
+  if (n > 0 && n <= 1e-5) {
+    for (int i = 8; i >= 0; i--) {
+      if (n < kInversePowers[i] * 10) {
+        n *= kPowers[i];
+        exponent -= 1 << i;
+      }
+    }
+  }
+  uint32_t integral = (uint32_t)n;
+  double fraction = (n - integral) * 1e9;
+  uint32_t decimals = (uint32_t)fraction;
+  if (fraction - decimals >= 0.5) decimals++;
+  if (decimals >= 1000000000) {
+    decimals = 0;
+    integral++;
+    if (exponent != 0 && integral >= 10) {
+      exponent++;
+      integral = 1;
+    }
+  }
+  int places = 9;
+  while (places > 0 && decimals % 10 == 0) {
+    decimals /= 10;
+    places--;
+  }
+  digits(integral);
+  if (places > 0) {
+    put('.');
+    digits(decimals, places);
+  }
+  if (exponent != 0) {
+    put('e');
+    if (exponent < 0) {
+      put('-');
+      exponent = -exponent;
+    }
+    digits((unsigned)exponent);
+  }
+  return *this;
+}
@@ -0,0 +1,138 @@
+// Lz4Block.h — LZ4 block format compression without allocation.
+//
+// Produces standard LZ4 blocks (sequences of token, literals, 16-bit offset
+// and match length) that any LZ4 block decoder reads, e.g. lz4.block in
+// Python or LZ4_decompress_safe. The compressor is the greedy single-probe
+// kind: one hash table of 2^HashBits 16-bit positions supplied by the caller
+// is all the memory it needs, so inputs are limited to 64 KB. decompress() is
+// bounds-checked and mostly here for tests and host tools.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace hyphen {
+namespace lz4 {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5;  // the block must end in literals
+constexpr size_t kMatchLimit = 12;   // no match may start within this of the end
+constexpr size_t kMaxInput = 0xFFFE;
+
+// Worst-case compressed size of `n` bytes (incompressible input).
+constexpr size_t bound(size_t n) { return n + n / 255 + 16; }
+
+namespace detail {
+inline uint32_t read32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Writes the 15+ length continuation bytes; false when out of room.
+inline bool putLength(uint8_t*& op, const uint8_t* end, size_t length) {
+  for (; length >= 255; length -= 255) {
+    if (op >= end) return false;
+    *op++ = 255;
+  }
+  if (op >= end) return false;
+  *op++ = (uint8_t)length;
+  return true;
+}
+
+inline bool putSequence(uint8_t*& op, const uint8_t* end, const uint8_t* literals, size_t literalLength,
+                        size_t offset, size_t matchLength) {
+  if (op >= end) return false;
+  uint8_t* token = op++;
+  *token = (uint8_t)((literalLength >= 15 ? 15 : literalLength) << 4);
+  if (literalLength >= 15 && !putLength(op, end, literalLength - 15)) return false;
+  if ((size_t)(end - op) < literalLength) return false;
+  memcpy(op, literals, literalLength);
+  op += literalLength;
+  if (matchLength == 0) return true;  // the closing literal run
+  if (end - op < 2) return false;
+  *op++ = (uint8_t)(offset & 0xFF);
+  *op++ = (uint8_t)(offset >> 8);
+  size_t extra = matchLength - kMinMatch;
+  *token |= (uint8_t)(extra >= 15 ? 15 : extra);
+  return extra < 15 || putLength(op, end, extra - 15);
+}
+}  // namespace detail
+
+// Compresses `n` bytes of `src` into `dst` using `table` (2^HashBits entries,
+// any contents). Returns the block size, or 0 when it would not fit in
+// `capacity` or the input is too large.
+template <unsigned HashBits>
+size_t compress(const uint8_t* src, size_t n, uint8_t* dst, size_t capacity, uint16_t (&table)[1u << HashBits]) {
+  if (n > kMaxInput) return 0;
+  memset(table, 0, sizeof(table));  // positions are stored + 1; 0 is empty
+  uint8_t* op = dst;
+  const uint8_t* end = dst + capacity;
+  size_t anchor = 0;
+  if (n > kMatchLimit) {
+    size_t ip = 0;
+    while (ip < n - kMatchLimit) {
+      uint32_t seq = detail::read32(src + ip);
+      uint32_t h = (seq * 2654435761u) >> (32 - HashBits);
+      size_t ref = table[h];
+      table[h] = (uint16_t)(ip + 1);
+      if (ref == 0 || detail::read32(src + ref - 1) != seq) {
+        ip++;
+        continue;
+      }
+      ref--;
+      size_t length = kMinMatch;
+      while (ip + length < n - kLastLiterals && src[ref + length] == src[ip + length]) {
+        length++;
+      }
+      if (!detail::putSequence(op, end, src + anchor, ip - anchor, ip - ref, length)) return 0;
+      ip += length;
+      anchor = ip;
+    }
+  }
+  if (!detail::putSequence(op, end, src + anchor, n - anchor, 0, 0)) return 0;
+  return op - dst;
+}
+
+// Decodes a block into `dst`. Returns the decoded size, or 0 for a malformed
+// block or one that does not fit in `capacity`.
+inline size_t decompress(const uint8_t* src, size_t n, uint8_t* dst, size_t capacity) {
+  const uint8_t* ip = src;
+  const uint8_t* in = src + n;
+  uint8_t* op = dst;
+  const uint8_t* out = dst + capacity;
+  auto length = [&](size_t base, size_t& value) {
+    value = base;
+    if (base != 15) return true;
+    uint8_t b;
+    do {
+      if (ip >= in) return false;
+      b = *ip++;
+      value += b;
+    } while (b == 255);
+    return true;
+  };
+  while (ip < in) {
+    uint8_t token = *ip++;
+    size_t literals, match;
+    if (!length(token >> 4, literals) || (size_t)(in - ip) < literals || (size_t)(out - op) < literals) return 0;
+    memcpy(op, ip, literals);
+    op += literals;
+    ip += literals;
+    if (ip == in) break;  // the closing literal run
+    if (in - ip < 2) return 0;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > (size_t)(op - dst) || !length(token & 0x0F, match)) return 0;
+    match += kMinMatch;
+    if ((size_t)(out - op) < match) return 0;
+    for (size_t i = 0; i < match; i++, op++) {
+      *op = *(op - offset);  // overlapping copies repeat the pattern
+    }
+  }
+  return op - dst;
+}
+
+}  // namespace lz4
+}  // namespace hyphen
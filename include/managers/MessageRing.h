@@ -0,0 +1,199 @@
+// MessageRing.h — fixed-capacity FIFO of (topic, payload) messages.
+//
+// Messages are copied into one preallocated byte arena, so queueing never
+// touches the heap and the memory bound is fixed at compile time. Each entry
+// carries a caller-defined Meta (timestamps, completion callback, ...). Topic
+// and payload are both stored NUL-terminated so consumers can hand them to
+// C-string APIs without another copy.
+//
+// Not synchronized: owners wrap it in their own lock. With a single consumer,
+// the front entry stays valid while producers push, so the consumer may read
+// it outside the lock and pop() afterwards; erase() of any later entry keeps
+// the front where it is.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <array>
+
+template <size_t Bytes, size_t Depth, typename Meta>
+class MessageRing {
+ public:
+  struct View {
+    const char* topic;
+    const uint8_t* payload;
+    size_t length;
+    Meta* meta;
+  };
+
+  bool push(const char* topic, const uint8_t* payload, size_t length,
+            const Meta& meta) {
+    size_t topicLength = strlen(topic);
+    uint8_t* at = allocate(topicLength, length, meta);
+    if (!at) {
+      return false;
+    }
+    memcpy(at, topic, topicLength);
+    at[topicLength] = '\0';
+    if (length) {
+      memcpy(at + topicLength + 1, payload, length);
+    }
+    return true;
+  }
+
+  // Reserves a `length`-byte payload under an empty topic and returns it for
+  // the caller to fill in place (saves a staging copy when the payload is
+  // encoded rather than copied). nullptr when the ring is full.
+  uint8_t* emplace(size_t length, const Meta& meta) {
+    uint8_t* at = allocate(0, length, meta);
+    if (!at) {
+      return nullptr;
+    }
+    at[0] = '\0';
+    return at + 1;
+  }
+
+  bool empty() const { return count_ == 0; }
+  bool full() const { return count_ == Depth; }
+  size_t size() const { return count_; }
+  static constexpr size_t capacity() { return Depth; }
+
+  View front() { return at(0); }
+
+  // i-th oldest entry, 0 == front.
+  View at(size_t i) {
+    Slot& slot = slots_[(first_ + i) % Depth];
+    const uint8_t* base = arena_.data() + slot.offset;
+    return View{(const char*)base, base + slot.topicLength + 1, slot.length,
+                &slot.meta};
+  }
+
+  void pop() {
+    if (count_ == 0) {
+      return;
+    }
+    slots_[first_].meta = Meta();
+    first_ = (first_ + 1) % Depth;
+    count_--;
+    if (count_ == 0) {
+      first_ = 0;
+      tail_ = 0;
+    }
+  }
+
+  // Removes the i-th oldest entry. The entries after it are moved down over
+  // its bytes, so the space is reusable at once; views of them go stale, while
+  // the entries before it (the front included, for i > 0) stay put.
+  void erase(size_t i) {
+    if (i >= count_) {
+      return;
+    }
+    if (i == 0) {
+      pop();
+      return;
+    }
+    Slot& before = slots_[(first_ + i - 1) % Depth];
+    size_t end = before.offset + bytesOf(before);
+    for (size_t j = i; j + 1 < count_; j++) {
+      Slot& slot = slots_[(first_ + j) % Depth];
+      slot = slots_[(first_ + j + 1) % Depth];
+      size_t need = bytesOf(slot);
+      size_t offset = Bytes - end >= need ? end : 0;
+      memmove(arena_.data() + offset, arena_.data() + slot.offset, need);
+      slot.offset = offset;
+      end = offset + need;
+    }
+    slots_[(first_ + count_ - 1) % Depth].meta = Meta();
+    count_--;
+    tail_ = end;
+  }
+
+  // The most contiguous room there can be once every entry but the first
+  // `keep` (0 or 1) has been erased.
+  size_t largestFree(size_t keep) const {
+    if (keep == 0 || count_ == 0) return Bytes;
+    const Slot& front = slots_[first_];
+    size_t end = front.offset + bytesOf(front);
+    return Bytes - end > front.offset ? Bytes - end : front.offset;
+  }
+
+  // Bytes still available for one contiguous message (topic + payload + 2).
+  size_t freeBytes() const {
+    if (count_ == 0) return Bytes;
+    size_t head = slots_[first_].offset;
+    if (tail_ > head) {
+      size_t end = Bytes - tail_;
+      return end > head ? end : head;
+    }
+    return head - tail_;
+  }
+
+ private:
+  struct Slot {
+    size_t offset = 0;
+    size_t topicLength = 0;
+    size_t length = 0;
+    Meta meta{};
+  };
+
+  static size_t bytesOf(const Slot& slot) { return slot.topicLength + 1 + slot.length + 1; }
+
+  // Claims space and a slot for one message; returns the start of its bytes
+  // (topic first) with the payload terminator already written.
+  uint8_t* allocate(size_t topicLength, size_t length, const Meta& meta) {
+    size_t need = topicLength + 1 + length + 1;
+    if (count_ == Depth || need > Bytes) {
+      return nullptr;
+    }
+    size_t offset;
+    if (!reserve(need, offset)) {
+      return nullptr;
+    }
+    uint8_t* at = arena_.data() + offset;
+    at[topicLength + 1 + length] = '\0';
+
+    Slot& slot = slots_[(first_ + count_) % Depth];
+    slot.offset = offset;
+    slot.topicLength = topicLength;
+    slot.length = length;
+    slot.meta = meta;
+    tail_ = offset + need;
+    count_++;
+    return at;
+  }
+
+  // Finds `need` contiguous bytes after the newest entry, wrapping to the start
+  // of the arena when the end is too short (the skipped tail bytes are simply
+  // unused until the ring drains past them).
+  bool reserve(size_t need, size_t& offset) {
+    if (count_ == 0) {
+      offset = 0;
+      return true;
+    }
+    size_t head = slots_[first_].offset;
+    if (tail_ > head) {
+      if (Bytes - tail_ >= need) {
+        offset = tail_;
+        return true;
+      }
+      if (head >= need) {
+        offset = 0;
+        return true;
+      }
+      return false;
+    }
+    if (head - tail_ >= need) {
+      offset = tail_;
+      return true;
+    }
+    return false;
+  }
+
+  std::array<uint8_t, Bytes> arena_{};
+  std::array<Slot, Depth> slots_{};
+  size_t first_ = 0;
+  size_t count_ = 0;
+  size_t tail_ = 0;
+};
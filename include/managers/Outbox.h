@@ -0,0 +1,109 @@
+#ifndef __outbox_h
+#define __outbox_h
+#include <Arduino.h>
+#include <ArduinoLog.h>
+#include <functional>
+#include <freertos/semphr.h>
+#include "managers/FileManager.h"
+#include "EpochClock.h"
+
+#ifndef OUTBOX_MAX_BYTES
+#define OUTBOX_MAX_BYTES 65536 // flash the outbox may use before the oldest segment is dropped
+#endif
+
+#ifndef OUTBOX_SEGMENT_BYTES
+#define OUTBOX_SEGMENT_BYTES 8192 // size of one append-only segment file
+#endif
+
+#ifndef OUTBOX_DRAIN_PER_SECOND
+#define OUTBOX_DRAIN_PER_SECOND 5 // replayed publishes per second once the session is up
+#endif
+
+#ifndef OUTBOX_CURSOR_SYNC
+#define OUTBOX_CURSOR_SYNC 8 // drained records between read-cursor writes (bounds replays after a reboot)
+#endif
+
+#define OUTBOX_PATH_PREFIX "/obx"
+#define OUTBOX_CURSOR_PATH "/obx.cur"
+
+/**
+ * @brief Flash-backed store-and-forward queue for publishes made while the
+ * MQTT session is down.
+ *
+ * Records are appended to fixed-size segment files on SPIFFS and replayed in
+ * order, at a bounded rate, once the session is back. A small cursor file
+ * records how far the oldest segment has been drained, so the queue survives
+ * a reboot (delivery is at-least-once: up to OUTBOX_CURSOR_SYNC records may be
+ * replayed again after a power loss). When the outbox reaches OUTBOX_MAX_BYTES
+ * the oldest segment is deleted to make room.
+ */
+class Outbox
+{
+public:
+    Outbox();
+    bool begin();
+    bool enqueue(const char *topic, const uint8_t *payload, size_t length);
+    size_t drain(std::function<bool(const char *, const uint8_t *, size_t)> publisher);
+    bool empty() { return depth == 0; }
+    // counters
+    uint32_t getDepth() { return depth; }
+    uint32_t getBytes() { return totalBytes; }
+    uint32_t getDropped() { return dropped; }
+    uint32_t getDrained() { return drained; }
+    uint32_t oldestAgeSeconds();
+    float drainRate();
+
+private:
+    struct __attribute__((packed)) RecordHeader
+    {
+        uint8_t magic;
+        uint8_t flags;
+        uint16_t topicLength;
+        uint32_t payloadLength;
+        uint32_t stamp; // epoch seconds, 0 when the clock was not set
+    };
+    static const uint8_t RECORD_MAGIC = 0xB0;
+    struct Lock
+    {
+        Lock() { xSemaphoreTakeRecursive(mutex(), portMAX_DELAY); }
+        ~Lock() { xSemaphoreGiveRecursive(mutex()); }
+        static SemaphoreHandle_t &mutex()
+        {
+            static SemaphoreHandle_t m = xSemaphoreCreateRecursiveMutex();
+            return m;
+        }
+    };
+    FileManager fm;
+    bool started = false;
+    uint32_t headSegment = 0;
+    uint32_t tailSegment = 0;
+    uint32_t readOffset = 0;
+    uint32_t tailSize = 0;
+    uint32_t totalBytes = 0;
+    uint32_t depth = 0;
+    uint32_t dropped = 0;
+    uint32_t drained = 0;
+    uint32_t unsyncedDrains = 0;
+    uint32_t oldestStamp = 0;
+    unsigned long oldestSeenMs = 0;
+    float drainTokens = 0;
+    bool draining = false; // a drain() is sending outside the lock
+    unsigned long lastDrainMs = 0;
+    unsigned long rateWindowStart = 0;
+    uint32_t rateWindowCount = 0;
+    float lastRate = 0;
+    static void segmentPath(uint32_t segment, char *path, size_t size);
+    uint32_t countRecords(uint32_t segment, uint32_t from, uint32_t *firstStamp);
+    bool readHeader(File &file, RecordHeader &header);
+    void dropHeadSegment();
+    void retireHeadSegment(uint32_t segmentSize);
+    void skipHeadSegment(const char *path, uint32_t segmentSize);
+    void advanceHead(uint32_t recordBytes, uint32_t segmentSize, bool sizeUnknown);
+    void loadCursor();
+    void saveCursor();
+    void refreshOldest();
+    void recordDrain();
+    void rollRateWindow(unsigned long now);
+};
+
+#endif
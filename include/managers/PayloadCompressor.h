@@ -0,0 +1,208 @@
+#ifndef __payload_compressor_h
+#define __payload_compressor_h
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <new>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "managers/Lz4Block.h"
+
+#ifndef PAYLOAD_COMPRESS_MIN_BYTES
+#define PAYLOAD_COMPRESS_MIN_BYTES 256 // default size from which enableCompression() compresses a payload
+#endif
+
+#ifndef PAYLOAD_COMPRESS_MAX_BYTES
+#define PAYLOAD_COMPRESS_MAX_BYTES 4096 // largest payload compressed
+#endif
+
+#ifndef PAYLOAD_COMPRESS_HASH_BITS
+#define PAYLOAD_COMPRESS_HASH_BITS 10 // match table of 2^bits 16-bit entries (2 KB at 10), allocated by enable()
+#endif
+
+struct CompressionStats
+{
+    uint32_t compressed = 0; // payloads sent compressed
+    uint32_t stored = 0;     // considered, but sent as is (did not shrink or too large)
+    uint32_t escaped = 0;    // plain payloads wrapped because they began with an envelope marker
+    uint64_t bytesIn = 0;    // of the compressed payloads
+    uint64_t bytesOut = 0;   // their envelopes
+    uint64_t totalMicros = 0;
+    uint32_t maxMicros = 0;
+    // compressed size as a percentage of the original
+    uint32_t ratioPercent() const { return bytesIn ? (uint32_t)(bytesOut * 100 / bytesIn) : 100; }
+};
+
+/**
+ * @brief optional LZ4 compression of outgoing payloads. Once enabled, a
+ * payload of at least the threshold is compressed and sent in a one-byte
+ * envelope when that makes it smaller:
+ *
+ *   0xFF, original length (LEB128 varint), LZ4 block   - compressed
+ *   0xFE, payload                                     - stored as is
+ *
+ * Any other first byte is a plain payload. Text payloads never start with
+ * 0xFE/0xFF (not valid UTF-8); a plain payload that does is sent stored, so a
+ * receiver can always tell. The match table is allocated by enable() and
+ * used under the compressor's lock; each envelope is built in its own buffer
+ * and sent after the lock is released. While disabled, payloads pass straight
+ * through without locking.
+ */
+class PayloadCompressor
+{
+public:
+    static const uint8_t COMPRESSED = 0xFF;
+    static const uint8_t STORED = 0xFE;
+    typedef std::function<bool(const uint8_t *, size_t)> Sender;
+
+    PayloadCompressor() : mutex(xSemaphoreCreateMutex()) {}
+
+    /**
+     * @return false - the match table could not be allocated
+     */
+    bool enable(size_t threshold)
+    {
+        Lock lock(mutex);
+        if (!table)
+        {
+            table.reset(new (std::nothrow) Table);
+            if (!table)
+            {
+                return false;
+            }
+        }
+        this->threshold = threshold;
+        enabled = true;
+        return true;
+    }
+
+    void disable()
+    {
+        Lock lock(mutex);
+        enabled = false;
+        table.reset();
+    }
+
+    bool isEnabled()
+    {
+        return enabled;
+    }
+
+    /**
+     * @brief sends `payload` through `send` as is, stored or compressed
+     *
+     * @return what `send` returned
+     */
+    bool send(const uint8_t *payload, size_t length, Sender send)
+    {
+        if (!enabled)
+        {
+            return send(payload, length);
+        }
+        std::unique_ptr<uint8_t[]> envelope;
+        size_t size = compress(payload, length, envelope);
+        if (size > 0)
+        {
+            return send(envelope.get(), size);
+        }
+        bool marked = length > 0 && (payload[0] == COMPRESSED || payload[0] == STORED);
+        return marked ? sendStored(payload, length, send) : send(payload, length);
+    }
+
+    CompressionStats getStats()
+    {
+        Lock lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    struct Table
+    {
+        uint16_t entries[1u << PAYLOAD_COMPRESS_HASH_BITS];
+    };
+    SemaphoreHandle_t mutex;
+    std::atomic<bool> enabled{false};
+    size_t threshold = PAYLOAD_COMPRESS_MIN_BYTES;
+    std::unique_ptr<Table> table;
+    CompressionStats stats;
+
+    // builds the compressed envelope of `payload` into `envelope` under the
+    // lock; 0 when the payload is sent as it is instead
+    size_t compress(const uint8_t *payload, size_t length, std::unique_ptr<uint8_t[]> &envelope)
+    {
+        Lock lock(mutex);
+        if (!enabled || !table || length < threshold)
+        {
+            return 0;
+        }
+        size_t capacity = 1 + 5 + hyphen::lz4::bound(length);
+        if (length <= PAYLOAD_COMPRESS_MAX_BYTES)
+        {
+            envelope.reset(new (std::nothrow) uint8_t[capacity]);
+        }
+        if (!envelope)
+        {
+            stats.stored++;
+            return 0;
+        }
+        unsigned long started = micros();
+        uint8_t *out = envelope.get();
+        size_t header = 1 + varint(out + 1, length);
+        out[0] = COMPRESSED;
+        size_t block = hyphen::lz4::compress<PAYLOAD_COMPRESS_HASH_BITS>(payload, length, out + header,
+                                                                           capacity - header, table->entries);
+        unsigned long took = micros() - started;
+        stats.totalMicros += took;
+        if (took > stats.maxMicros)
+        {
+            stats.maxMicros = took;
+        }
+        if (block == 0 || header + block >= length)
+        {
+            stats.stored++;
+            return 0;
+        }
+        stats.compressed++;
+        stats.bytesIn += length;
+        stats.bytesOut += header + block;
+        return header + block;
+    }
+
+    static size_t varint(uint8_t *at, size_t value)
+    {
+        size_t n = 0;
+        do
+        {
+            uint8_t b = value & 0x7F;
+            value >>= 7;
+            at[n++] = value ? (b | 0x80) : b;
+        } while (value);
+        return n;
+    }
+
+    // prefixes the STORED marker in a copy of the payload
+    bool sendStored(const uint8_t *payload, size_t length, Sender &send)
+    {
+        {
+            Lock lock(mutex);
+            stats.escaped++;
+        }
+        std::unique_ptr<uint8_t[]> copy(new (std::nothrow) uint8_t[length + 1]);
+        if (!copy)
+        {
+            return false;
+        }
+        copy[0] = STORED;
+        memcpy(copy.get() + 1, payload, length);
+        return send(copy.get(), length + 1);
+    }
+};
+
+#endif
@@ -0,0 +1,410 @@
+#ifndef __publish_batcher_h
+#define __publish_batcher_h
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <array>
+#include <utility>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#ifndef PUBLISH_BATCH_MAX_BYTES
+#define PUBLISH_BATCH_MAX_BYTES 1024 // envelope size that forces a flush
+#endif
+
+#ifndef PUBLISH_BATCH_WINDOW_MS
+#define PUBLISH_BATCH_WINDOW_MS 5000 // oldest message in a batch waits at most this long
+#endif
+
+#ifndef PUBLISH_BATCH_TOPICS
+#define PUBLISH_BATCH_TOPICS 4 // topics that can be batched at the same time
+#endif
+
+struct PublishBatchStats
+{
+    uint32_t messages = 0;     // messages accepted into a batch
+    uint32_t packets = 0;      // envelopes published
+    uint32_t passthrough = 0;  // messages too large to batch, sent on their own
+    uint32_t sizeFlushes = 0;
+    uint32_t windowFlushes = 0;
+    uint32_t explicitFlushes = 0;
+    uint32_t failed = 0;       // envelope publishes that failed (the batch is kept)
+    uint32_t lost = 0;         // messages of a failed envelope that could not be kept
+};
+
+/**
+ * @brief coalesces many small publishes into one MQTT packet.
+ *
+ * Messages for the same topic are gathered into a JSON array envelope
+ * `[p1,p2,...]`. With a batch topic set, messages for every topic share one
+ * envelope of `{"topic":"...","payload":p}` entries published to that topic.
+ * JSON object/array payloads are embedded as-is; anything else is embedded as
+ * a JSON string. A batch is flushed when the next message would push it past
+ * the size limit, when its oldest message is older than the window, or on an
+ * explicit flush().
+ */
+class PublishBatcher
+{
+public:
+    typedef std::function<bool(const char *, const uint8_t *, size_t)> Sender;
+
+    PublishBatcher() : mutex(xSemaphoreCreateMutex()) {}
+
+    void configure(size_t maxBytes, unsigned long windowMs, const char *batchTopic = nullptr)
+    {
+        Lock lock(mutex);
+        this->maxBytes = maxBytes;
+        this->windowMs = windowMs;
+        this->batchTopic = batchTopic ? batchTopic : "";
+    }
+
+    /**
+     * @brief adds a message, flushing its batch first if it would overflow.
+     * Envelopes are sent after the lock is released, so other publishers are
+     * never held up behind the radio.
+     *
+     * @return false - the message could not be batched or sent
+     */
+    bool add(const char *topic, const uint8_t *payload, size_t length, Sender send)
+    {
+        while (true)
+        {
+            Batch full;
+            {
+                Lock lock(mutex);
+                const char *target = batchTopic.empty() ? topic : batchTopic.c_str();
+                size_t entry = entrySize(topic, payload, length);
+                if (entry + 2 > maxBytes)
+                {
+                    // too large to batch; what its topic gathered goes first
+                    Batch *batch = find(target);
+                    if (batch)
+                    {
+                        stats.sizeFlushes++;
+                        take(*batch, full);
+                    }
+                    else
+                    {
+                        stats.passthrough++;
+                    }
+                }
+                else if (!makeRoom(target, entry, full))
+                {
+                    Batch *batch = find(target);
+                    if (!batch)
+                    {
+                        batch = freeSlot();
+                        batch->topic = target;
+                        batch->body.reserve(maxBytes);
+                    }
+                    batch->body += batch->count == 0 ? '[' : ',';
+                    appendEntry(batch->body, topic, payload, length);
+                    if (batch->count == 0)
+                    {
+                        batch->openedAt = millis();
+                    }
+                    batch->count++;
+                    stats.messages++;
+                    return true;
+                }
+            }
+            if (full.count == 0)
+            {
+                return send(topic, payload, length);
+            }
+            if (!sendBatch(full, send))
+            {
+                return false;
+            }
+        }
+    }
+
+    /**
+     * @brief flushes every batch whose window has elapsed
+     */
+    void poll(Sender send)
+    {
+        std::array<Batch, PUBLISH_BATCH_TOPICS> due;
+        {
+            Lock lock(mutex);
+            unsigned long now = millis();
+            for (size_t i = 0; i < batches.size(); i++)
+            {
+                if (batches[i].count > 0 && now - batches[i].openedAt >= windowMs)
+                {
+                    stats.windowFlushes++;
+                    take(batches[i], due[i]);
+                }
+            }
+        }
+        sendAll(due, send);
+    }
+
+    /**
+     * @brief flushes everything now
+     *
+     * @return true - every pending batch was published
+     */
+    bool flush(Sender send)
+    {
+        std::array<Batch, PUBLISH_BATCH_TOPICS> due;
+        {
+            Lock lock(mutex);
+            for (size_t i = 0; i < batches.size(); i++)
+            {
+                if (batches[i].count > 0)
+                {
+                    stats.explicitFlushes++;
+                    take(batches[i], due[i]);
+                }
+            }
+        }
+        return sendAll(due, send);
+    }
+
+    size_t pending()
+    {
+        Lock lock(mutex);
+        size_t total = 0;
+        for (auto &batch : batches)
+        {
+            total += batch.count;
+        }
+        return total;
+    }
+
+    PublishBatchStats getStats()
+    {
+        Lock lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Batch
+    {
+        std::string topic;
+        std::string body;
+        size_t count = 0;
+        unsigned long openedAt = 0;
+    };
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    SemaphoreHandle_t mutex;
+    std::array<Batch, PUBLISH_BATCH_TOPICS> batches;
+    size_t maxBytes = PUBLISH_BATCH_MAX_BYTES;
+    unsigned long windowMs = PUBLISH_BATCH_WINDOW_MS;
+    std::string batchTopic;
+    PublishBatchStats stats;
+
+    Batch *find(const std::string &topic)
+    {
+        for (auto &batch : batches)
+        {
+            if (batch.count > 0 && batch.topic == topic)
+            {
+                return &batch;
+            }
+        }
+        return nullptr;
+    }
+
+    Batch *freeSlot()
+    {
+        for (auto &batch : batches)
+        {
+            if (batch.count == 0)
+            {
+                return &batch;
+            }
+        }
+        return nullptr;
+    }
+
+    // moves a finished batch out to `out`, leaving its slot free
+    void take(Batch &batch, Batch &out)
+    {
+        std::swap(batch, out);
+        batch.body.clear();
+        batch.count = 0;
+    }
+
+    // takes out whatever must be sent before an `entry`-byte message for
+    // `target` fits: its own full batch, or the oldest batch when every slot
+    // is busy. False when it fits already.
+    bool makeRoom(const std::string &target, size_t entry, Batch &out)
+    {
+        Batch *batch = find(target);
+        if (batch)
+        {
+            if (batch->body.size() + 1 + entry + 1 <= maxBytes)
+            {
+                return false;
+            }
+        }
+        else if (freeSlot())
+        {
+            return false;
+        }
+        else
+        {
+            unsigned long now = millis();
+            for (auto &candidate : batches)
+            {
+                if (!batch || now - candidate.openedAt > now - batch->openedAt)
+                {
+                    batch = &candidate;
+                }
+            }
+        }
+        stats.sizeFlushes++;
+        take(*batch, out);
+        return true;
+    }
+
+    // publishes a batch taken out of its slot; called without the lock
+    bool sendBatch(Batch &batch, Sender send)
+    {
+        batch.body += ']';
+        if (send(batch.topic.c_str(), (const uint8_t *)batch.body.data(), batch.body.size()))
+        {
+            Lock lock(mutex);
+            stats.packets++;
+            return true;
+        }
+        batch.body.pop_back();
+        restore(batch);
+        return false;
+    }
+
+    bool sendAll(std::array<Batch, PUBLISH_BATCH_TOPICS> &due, Sender send)
+    {
+        bool ok = true;
+        for (auto &batch : due)
+        {
+            if (batch.count > 0)
+            {
+                ok = sendBatch(batch, send) && ok;
+            }
+        }
+        return ok;
+    }
+
+    // puts a batch that failed to send back, ahead of anything its topic
+    // gathered meanwhile, so its messages go out with the next flush. If that
+    // no longer fits an envelope, or no slot is left, its messages are lost.
+    void restore(Batch &failed)
+    {
+        Lock lock(mutex);
+        stats.failed++;
+        Batch *batch = find(failed.topic);
+        if (!batch)
+        {
+            batch = freeSlot();
+            if (batch)
+            {
+                std::swap(*batch, failed);
+                return;
+            }
+        }
+        else if (failed.body.size() + batch->body.size() + 1 <= maxBytes)
+        {
+            failed.body += ',';
+            failed.body.append(batch->body, 1, std::string::npos);
+            failed.count += batch->count;
+            std::swap(*batch, failed);
+            return;
+        }
+        stats.lost += failed.count;
+    }
+
+    static bool isJsonContainer(const uint8_t *payload, size_t length)
+    {
+        size_t i = 0;
+        while (i < length && (payload[i] == ' ' || payload[i] == '\t' || payload[i] == '\r' || payload[i] == '\n'))
+        {
+            i++;
+        }
+        return i < length && (payload[i] == '{' || payload[i] == '[');
+    }
+
+    static size_t quotedSize(const uint8_t *text, size_t length)
+    {
+        size_t size = 2;
+        for (size_t i = 0; i < length; i++)
+        {
+            uint8_t c = text[i];
+            size += (c == '"' || c == '\\') ? 2 : (c < 0x20 ? 6 : 1);
+        }
+        return size;
+    }
+
+    static void appendQuoted(std::string &out, const uint8_t *text, size_t length)
+    {
+        static const char hex[] = "0123456789abcdef";
+        out += '"';
+        for (size_t i = 0; i < length; i++)
+        {
+            uint8_t c = text[i];
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += (char)c;
+            }
+            else if (c < 0x20)
+            {
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+            }
+            else
+            {
+                out += (char)c;
+            }
+        }
+        out += '"';
+    }
+
+    size_t payloadSize(const uint8_t *payload, size_t length) const
+    {
+        return isJsonContainer(payload, length) ? length : quotedSize(payload, length);
+    }
+
+    size_t entrySize(const char *topic, const uint8_t *payload, size_t length) const
+    {
+        size_t size = payloadSize(payload, length);
+        if (!batchTopic.empty())
+        {
+            // {"topic":<t>,"payload":<p>}
+            size += 21 + quotedSize((const uint8_t *)topic, strlen(topic));
+        }
+        return size;
+    }
+
+    void appendEntry(std::string &out, const char *topic, const uint8_t *payload, size_t length) const
+    {
+        if (!batchTopic.empty())
+        {
+            out += "{\"topic\":";
+            appendQuoted(out, (const uint8_t *)topic, strlen(topic));
+            out += ",\"payload\":";
+        }
+        if (isJsonContainer(payload, length))
+        {
+            out.append((const char *)payload, length);
+        }
+        else
+        {
+            appendQuoted(out, payload, length);
+        }
+        if (!batchTopic.empty())
+        {
+            out += '}';
+        }
+    }
+};
+
+#endif
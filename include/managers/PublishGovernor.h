@@ -0,0 +1,455 @@
+#ifndef __publish_governor_h
+#define __publish_governor_h
+#include <Arduino.h>
+#include <functional>
+#include <array>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "managers/MessageRing.h"
+#include "processors/MqttPacket.h"
+
+#ifndef GOVERNOR_RULES_MAX
+#define GOVERNOR_RULES_MAX 8 // topic-prefix rate limits that can be configured
+#endif
+
+#ifndef GOVERNOR_DEFER_BYTES
+#define GOVERNOR_DEFER_BYTES 2048 // memory holding messages deferred by a limit
+#endif
+
+#ifndef GOVERNOR_DEFER_DEPTH
+#define GOVERNOR_DEFER_DEPTH 16 // max deferred messages
+#endif
+
+#ifndef DATA_BUDGET_PERIOD_DAYS
+#define DATA_BUDGET_PERIOD_DAYS 30 // length of one data-budget (billing) period
+#endif
+
+#ifndef DATA_BUDGET_NAMESPACE
+#define DATA_BUDGET_NAMESPACE "hy_budget" // NVS namespace holding the budget usage
+#endif
+
+#ifndef DATA_BUDGET_SYNC_BYTES
+#define DATA_BUDGET_SYNC_BYTES 4096 // budget usage accrued before it is worth persisting again
+#endif
+
+/**
+ * @brief what happens to a publish that is over its limit
+ */
+enum class ThrottlePolicy
+{
+    DEFER,       // hold it and send once the limit allows; refused if the hold is full
+    DROP_OLDEST, // hold it, discarding the oldest held messages to make room
+    REJECT       // refuse it
+};
+
+enum class GovernorVerdict
+{
+    SEND,     // within limits, publish now
+    DEFERRED, // held; sent later from the manager loop
+    REJECTED  // refused
+};
+
+struct GovernorStats
+{
+    uint32_t admitted = 0;
+    uint32_t deferred = 0;
+    uint32_t dropped = 0; // held messages discarded by DROP_OLDEST
+    uint32_t rejected = 0;
+    uint32_t budgetBytes = 0; // 0 = no budget
+    uint32_t budgetUsed = 0;
+    uint32_t budgetRemaining() const { return budgetUsed >= budgetBytes ? 0 : budgetBytes - budgetUsed; }
+};
+
+/**
+ * @brief rate and volume limits for application publishes on metered links.
+ *
+ * Each rule is a token bucket for topics starting with a prefix (the longest
+ * matching prefix applies); topics that match no rule are not rate limited.
+ * The data budget caps the bytes published per period and survives reboots
+ * through restoreBudget()/takeBudgetSync(). Nothing is limited while the link
+ * is unmetered (WiFi).
+ */
+class PublishGovernor
+{
+public:
+    PublishGovernor() : mutex(xSemaphoreCreateMutex()) {}
+
+    /**
+     * @brief limits topics starting with `prefix` to `perSecond` messages on
+     * average, with bursts of up to `burst`
+     *
+     * @return false - the rule table is full
+     */
+    bool limitTopic(const char *prefix, float perSecond, uint16_t burst, ThrottlePolicy policy)
+    {
+        Lock lock(mutex);
+        Rule *rule = findRule(prefix, true);
+        if (!rule)
+        {
+            for (auto &r : rules)
+            {
+                if (!r.used)
+                {
+                    rule = &r;
+                    break;
+                }
+            }
+        }
+        if (!rule)
+        {
+            return false;
+        }
+        rule->used = true;
+        rule->prefix = prefix;
+        rule->perSecond = perSecond;
+        rule->burst = burst > 0 ? burst : 1;
+        rule->tokens = rule->burst;
+        rule->refilledAt = millis();
+        rule->policy = policy;
+        return true;
+    }
+
+    void setBudget(uint32_t bytesPerPeriod, ThrottlePolicy policy)
+    {
+        Lock lock(mutex);
+        stats.budgetBytes = bytesPerPeriod;
+        budgetPolicy = policy;
+    }
+
+    void setMetered(bool metered)
+    {
+        Lock lock(mutex);
+        this->metered = metered;
+    }
+
+    bool isMetered() { return metered; }
+
+    /**
+     * @brief decides whether a publish may go out now, charging its tokens and
+     * bytes if so. Deferred messages are copied into the hold.
+     *
+     * @param bool canDefer - false for payloads that cannot be held (streams)
+     */
+    GovernorVerdict admit(const char *topic, const uint8_t *payload, size_t length, uint32_t epoch,
+                          bool canDefer = true)
+    {
+        Lock lock(mutex);
+        if (!metered)
+        {
+            stats.admitted++;
+            return GovernorVerdict::SEND;
+        }
+        rollPeriod(epoch);
+        // keep order: while messages of the same topic or rule are held, new
+        // ones queue behind them even when within their own limits
+        ThrottlePolicy policy = ThrottlePolicy::DEFER;
+        if (allowed(topic, length, policy) && !heldAhead(topic, ring.size()))
+        {
+            charge(topic, length);
+            stats.admitted++;
+            return GovernorVerdict::SEND;
+        }
+        if (!canDefer || policy == ThrottlePolicy::REJECT)
+        {
+            stats.rejected++;
+            return GovernorVerdict::REJECTED;
+        }
+        while (!ring.push(topic, payload, length, Held()))
+        {
+            if (policy != ThrottlePolicy::DROP_OLDEST || ring.empty())
+            {
+                stats.rejected++;
+                return GovernorVerdict::REJECTED;
+            }
+            ring.pop();
+            stats.dropped++;
+        }
+        stats.deferred++;
+        return GovernorVerdict::DEFERRED;
+    }
+
+    /**
+     * @brief admit() for a message that waits in the caller's own queue: on
+     * DEFERRED nothing is copied and the caller asks again later, keeping the
+     * message where it is. DROP_OLDEST waits like DEFER, since the caller's
+     * queue applies its own bound.
+     */
+    GovernorVerdict admitQueued(const char *topic, size_t length, uint32_t epoch)
+    {
+        Lock lock(mutex);
+        if (!metered)
+        {
+            stats.admitted++;
+            return GovernorVerdict::SEND;
+        }
+        rollPeriod(epoch);
+        ThrottlePolicy policy = ThrottlePolicy::DEFER;
+        if (allowed(topic, length, policy) && !heldAhead(topic, ring.size()))
+        {
+            charge(topic, length);
+            stats.admitted++;
+            return GovernorVerdict::SEND;
+        }
+        if (policy == ThrottlePolicy::REJECT)
+        {
+            stats.rejected++;
+            return GovernorVerdict::REJECTED;
+        }
+        return GovernorVerdict::DEFERRED;
+    }
+
+    /**
+     * @brief sends held messages, oldest first, for as long as the limits
+     * allow. A message still over its limit stays held, and so does everything
+     * behind it on the same topic or rule, but the others go on.
+     *
+     * @return size_t - messages sent
+     */
+    size_t release(size_t limit, uint32_t epoch, std::function<bool(const char *, const uint8_t *, size_t)> send)
+    {
+        size_t sent = 0;
+        size_t i = 0; // the messages before this one stay held
+        while (sent < limit)
+        {
+            MessageRing<GOVERNOR_DEFER_BYTES, GOVERNOR_DEFER_DEPTH, Held>::View view;
+            uint32_t dropped;
+            {
+                Lock lock(mutex);
+                rollPeriod(epoch);
+                for (; i < ring.size(); i++)
+                {
+                    view = ring.at(i);
+                    ThrottlePolicy policy;
+                    if (!heldAhead(view.topic, i) && (!metered || allowed(view.topic, view.length, policy)))
+                    {
+                        break;
+                    }
+                }
+                if (i == ring.size())
+                {
+                    break;
+                }
+                dropped = stats.dropped;
+            }
+            if (!send(view.topic, view.payload, view.length))
+            {
+                break;
+            }
+            Lock lock(mutex);
+            if (metered)
+            {
+                charge(view.topic, view.length);
+            }
+            // DROP_OLDEST may have popped messages ahead of it meanwhile
+            size_t popped = stats.dropped - dropped;
+            if (popped <= i)
+            {
+                i -= popped;
+                ring.erase(i);
+            }
+            else
+            {
+                i = 0;
+            }
+            stats.admitted++;
+            sent++;
+        }
+        return sent;
+    }
+
+    size_t held()
+    {
+        Lock lock(mutex);
+        return ring.size();
+    }
+
+    /**
+     * @brief seeds the budget from persisted state
+     */
+    void restoreBudget(uint32_t used, uint32_t periodStart)
+    {
+        Lock lock(mutex);
+        stats.budgetUsed = used;
+        this->periodStart = periodStart;
+        synced = used;
+    }
+
+    /**
+     * @brief starts a new budget period now (e.g. on the billing day)
+     */
+    void resetBudget(uint32_t epoch)
+    {
+        Lock lock(mutex);
+        stats.budgetUsed = 0;
+        periodStart = epoch;
+        dirty = true;
+    }
+
+    /**
+     * @brief true (once) when usage moved far enough, or the period rolled,
+     * to be worth persisting; fills in what to store
+     */
+    bool takeBudgetSync(uint32_t &used, uint32_t &start)
+    {
+        Lock lock(mutex);
+        if (!dirty && stats.budgetUsed - synced < DATA_BUDGET_SYNC_BYTES)
+        {
+            return false;
+        }
+        dirty = false;
+        synced = stats.budgetUsed;
+        used = stats.budgetUsed;
+        start = periodStart;
+        return true;
+    }
+
+    GovernorStats getStats()
+    {
+        Lock lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Rule
+    {
+        bool used = false;
+        String prefix;
+        float perSecond = 0;
+        uint16_t burst = 1;
+        float tokens = 0;
+        unsigned long refilledAt = 0;
+        ThrottlePolicy policy = ThrottlePolicy::DEFER;
+    };
+    struct Held
+    {
+    };
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    static const uint32_t PERIOD_SECONDS = (uint32_t)DATA_BUDGET_PERIOD_DAYS * 86400UL;
+
+    SemaphoreHandle_t mutex;
+    std::array<Rule, GOVERNOR_RULES_MAX> rules;
+    MessageRing<GOVERNOR_DEFER_BYTES, GOVERNOR_DEFER_DEPTH, Held> ring;
+    ThrottlePolicy budgetPolicy = ThrottlePolicy::REJECT;
+    GovernorStats stats;
+    bool metered = false;
+    bool dirty = false;
+    uint32_t periodStart = 0;
+    uint32_t synced = 0;
+
+    // exact match when `exact`, otherwise the longest rule prefix of `topic`
+    Rule *findRule(const char *topic, bool exact)
+    {
+        Rule *best = nullptr;
+        for (auto &rule : rules)
+        {
+            if (!rule.used)
+            {
+                continue;
+            }
+            size_t n = rule.prefix.length();
+            bool match = exact ? strcmp(topic, rule.prefix.c_str()) == 0
+                               : strncmp(topic, rule.prefix.c_str(), n) == 0;
+            if (match && (!best || n > best->prefix.length()))
+            {
+                best = &rule;
+            }
+        }
+        return best;
+    }
+
+    // whether one of the `count` oldest held messages is for the same topic or
+    // under the same rule as `topic`
+    bool heldAhead(const char *topic, size_t count)
+    {
+        Rule *rule = findRule(topic, false);
+        for (size_t i = 0; i < count; i++)
+        {
+            const char *held = ring.at(i).topic;
+            if (strcmp(held, topic) == 0 || (rule && findRule(held, false) == rule))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static uint32_t wireBytes(const char *topic, size_t length)
+    {
+        return hyphen::mqtt::publishSize(strlen(topic), length, 0);
+    }
+
+    void refill(Rule &rule)
+    {
+        unsigned long now = millis();
+        rule.tokens += (now - rule.refilledAt) * rule.perSecond / 1000.0f;
+        if (rule.tokens > rule.burst)
+        {
+            rule.tokens = rule.burst;
+        }
+        rule.refilledAt = now;
+    }
+
+    // whether both the topic's bucket and the budget allow it; if not, which
+    // policy applies
+    bool allowed(const char *topic, size_t length, ThrottlePolicy &policy)
+    {
+        if (stats.budgetBytes > 0 && stats.budgetUsed + wireBytes(topic, length) > stats.budgetBytes)
+        {
+            policy = budgetPolicy;
+            return false;
+        }
+        Rule *rule = findRule(topic, false);
+        if (rule)
+        {
+            refill(*rule);
+            if (rule->tokens < 1.0f)
+            {
+                policy = rule->policy;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void charge(const char *topic, size_t length)
+    {
+        Rule *rule = findRule(topic, false);
+        if (rule)
+        {
+            rule->tokens -= 1.0f;
+        }
+        if (stats.budgetBytes > 0)
+        {
+            stats.budgetUsed += wireBytes(topic, length);
+        }
+    }
+
+    // without a synced clock (epoch 0) the current period simply continues
+    void rollPeriod(uint32_t epoch)
+    {
+        if (epoch == 0)
+        {
+            return;
+        }
+        if (periodStart == 0 || epoch < periodStart)
+        {
+            // first synced clock (keeps usage so far) or a clock that jumped back
+            periodStart = epoch;
+            dirty = true;
+        }
+        else if (epoch - periodStart >= PERIOD_SECONDS)
+        {
+            // stay aligned to the original period boundary (the billing day)
+            periodStart += (epoch - periodStart) / PERIOD_SECONDS * PERIOD_SECONDS;
+            stats.budgetUsed = 0;
+            dirty = true;
+        }
+    }
+};
+
+#endif
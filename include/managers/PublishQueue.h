@@ -0,0 +1,341 @@
+#ifndef __publish_queue_h
+#define __publish_queue_h
+#include <Arduino.h>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "managers/MessageRing.h"
+#include "managers/PublishGovernor.h"
+
+#ifndef PUBLISH_QUEUE_BYTES
+#define PUBLISH_QUEUE_BYTES 2048 // arena for the async publishes of one priority lane
+#endif
+
+#ifndef PUBLISH_QUEUE_DEPTH
+#define PUBLISH_QUEUE_DEPTH 8 // max queued async publishes per priority lane
+#endif
+
+#ifndef PUBLISH_LANE_MAX_WAIT_MS
+#define PUBLISH_LANE_MAX_WAIT_MS 5000 // a lower-priority message waiting longer than this is sent ahead of higher lanes
+#endif
+
+#ifndef PUBLISH_ASYNC_TIMEOUT_MS
+#define PUBLISH_ASYNC_TIMEOUT_MS 30000 // a queued publish not sent within this is completed as TIMEOUT
+#endif
+
+#ifndef PUBLISH_QUEUE_DRAIN_PER_LOOP
+#define PUBLISH_QUEUE_DRAIN_PER_LOOP 4 // publishes sent per manager loop
+#endif
+
+/**
+ * @brief outbound priority classes, drained strictly in this order
+ */
+enum class PublishPriority : uint8_t
+{
+    CONTROL,   // function and variable results, other RPC replies
+    ALARM,
+    TELEMETRY, // the default
+    BULK,
+    COUNT
+};
+
+enum class PublishResult
+{
+    SENT,
+    FAILED,
+    TIMEOUT,
+    REFUSED // over a rate or data limit whose policy is REJECT
+};
+
+/**
+ * @brief what happened to an async publish, with the millis() stamps of each
+ * stage so callers can measure queueing and radio latency.
+ */
+struct PublishReceipt
+{
+    PublishResult result = PublishResult::FAILED;
+    unsigned long enqueuedAt = 0;
+    unsigned long startedAt = 0;
+    unsigned long completedAt = 0;
+    unsigned long queuedMs() const { return startedAt - enqueuedAt; }
+    unsigned long latencyMs() const { return completedAt - enqueuedAt; }
+};
+
+typedef std::function<void(const PublishReceipt &)> PublishCallback;
+
+struct PublishLaneStats
+{
+    uint32_t depth = 0; // messages queued now
+    uint32_t highWater = 0;
+    uint32_t sent = 0;
+    uint32_t rejected = 0;
+    uint32_t promoted = 0; // sent ahead of higher lanes after waiting PUBLISH_LANE_MAX_WAIT_MS
+    unsigned long lastWaitMs = 0; // queueing time of the last message taken from the lane
+    unsigned long maxWaitMs = 0;
+};
+
+struct PublishQueueStats
+{
+    uint32_t enqueued = 0;
+    uint32_t sent = 0;
+    uint32_t failed = 0;
+    uint32_t timedOut = 0;
+    uint32_t refused = 0;  // refused by a rate or data limit when their turn came
+    uint32_t rejected = 0; // refused because the queue was full
+    uint32_t highWater = 0;
+    unsigned long lastLatencyMs = 0;
+    unsigned long maxLatencyMs = 0;
+    PublishLaneStats lanes[(size_t)PublishPriority::COUNT];
+};
+
+/**
+ * @brief bounded queues behind publishAsync(), one per PublishPriority. Any
+ * task may push; the manager loop is the single consumer and performs the
+ * blocking publish outside the lock, so producers never wait on the radio.
+ * Lanes drain strictly by priority, except that the oldest message of a lower
+ * lane that has waited PUBLISH_LANE_MAX_WAIT_MS goes first, so a steady
+ * stream of control traffic cannot starve telemetry forever.
+ */
+class PublishQueue
+{
+public:
+    PublishQueue() : mutex(xSemaphoreCreateMutex()) {}
+
+    /**
+     * @brief copies a message in; a `governed` one is subject to the `admit`
+     * passed to drain() when its turn comes
+     */
+    bool push(const char *topic, const uint8_t *payload, size_t length, PublishCallback onDone,
+              PublishPriority priority = PublishPriority::TELEMETRY, bool governed = false)
+    {
+        Lock lock(mutex);
+        size_t lane = (size_t)priority < LANES ? (size_t)priority : (size_t)PublishPriority::TELEMETRY;
+        Entry entry;
+        entry.enqueuedAt = millis();
+        entry.onDone = onDone;
+        entry.governed = governed;
+        if (!lanes[lane].push(topic, payload, length, entry))
+        {
+            stats.rejected++;
+            stats.lanes[lane].rejected++;
+            return false;
+        }
+        stats.enqueued++;
+        PublishLaneStats &laneStats = stats.lanes[lane];
+        laneStats.depth = lanes[lane].size();
+        if (laneStats.depth > laneStats.highWater)
+        {
+            laneStats.highWater = laneStats.depth;
+        }
+        size_t total = queued();
+        if (total > stats.highWater)
+        {
+            stats.highWater = total;
+        }
+        return true;
+    }
+
+    /**
+     * @brief sends up to `limit` queued messages through `send`, completing each
+     * with its receipt. Entries older than PUBLISH_ASYNC_TIMEOUT_MS complete as
+     * TIMEOUT; while `online` is false nothing else is attempted. A governed
+     * entry is sent only once `admit` returns SEND: DEFERRED leaves it (and
+     * the rest of its lane) queued until a later drain while the other lanes
+     * go on, REJECTED completes it as REFUSED.
+     *
+     * @return size_t - the number of messages completed
+     */
+    size_t drain(size_t limit, std::function<bool()> online,
+                 std::function<bool(const char *, const uint8_t *, size_t)> send,
+                 std::function<GovernorVerdict(const char *, size_t)> admit = nullptr)
+    {
+        size_t done = 0;
+        uint32_t held = 0; // lanes whose head a limit deferred this pass
+        while (done < limit)
+        {
+            Ring::View view;
+            size_t lane;
+            bool promoted;
+            {
+                Lock lock(mutex);
+                if (!next(lane, promoted, held))
+                {
+                    break;
+                }
+                view = lanes[lane].front();
+            }
+            PublishReceipt receipt;
+            receipt.enqueuedAt = view.meta->enqueuedAt;
+            receipt.startedAt = millis();
+            if (receipt.startedAt - receipt.enqueuedAt > PUBLISH_ASYNC_TIMEOUT_MS)
+            {
+                receipt.result = PublishResult::TIMEOUT;
+            }
+            else if (!online())
+            {
+                break;
+            }
+            else
+            {
+                GovernorVerdict verdict = view.meta->governed && admit ? admit(view.topic, view.length)
+                                                                       : GovernorVerdict::SEND;
+                if (verdict == GovernorVerdict::DEFERRED)
+                {
+                    held |= 1u << lane;
+                    continue;
+                }
+                if (verdict == GovernorVerdict::REJECTED)
+                {
+                    receipt.result = PublishResult::REFUSED;
+                }
+                else
+                {
+                    bool sent = send(view.topic, view.payload, view.length);
+                    receipt.result = sent ? PublishResult::SENT : PublishResult::FAILED;
+                }
+            }
+            receipt.completedAt = millis();
+            PublishCallback onDone = view.meta->onDone;
+            complete(lane, promoted, receipt);
+            if (onDone)
+            {
+                onDone(receipt);
+            }
+            done++;
+        }
+        return done;
+    }
+
+    size_t size()
+    {
+        Lock lock(mutex);
+        return queued();
+    }
+
+    size_t size(PublishPriority priority)
+    {
+        Lock lock(mutex);
+        return lanes[(size_t)priority].size();
+    }
+
+    bool full(PublishPriority priority = PublishPriority::TELEMETRY)
+    {
+        Lock lock(mutex);
+        return lanes[(size_t)priority].full();
+    }
+
+    PublishQueueStats getStats()
+    {
+        Lock lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        unsigned long enqueuedAt = 0;
+        PublishCallback onDone;
+        bool governed = false;
+    };
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    typedef MessageRing<PUBLISH_QUEUE_BYTES, PUBLISH_QUEUE_DEPTH, Entry> Ring;
+    static const size_t LANES = (size_t)PublishPriority::COUNT;
+
+    SemaphoreHandle_t mutex;
+    Ring lanes[LANES];
+    PublishQueueStats stats;
+
+    size_t queued()
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < LANES; i++)
+        {
+            total += lanes[i].size();
+        }
+        return total;
+    }
+
+    // the lane to send from: the longest-waiting lower lane past
+    // PUBLISH_LANE_MAX_WAIT_MS, otherwise the highest non-empty one; lanes in
+    // the `held` mask are passed over
+    bool next(size_t &lane, bool &promoted, uint32_t held = 0)
+    {
+        size_t first = LANES;
+        for (size_t i = 0; i < LANES; i++)
+        {
+            if (!lanes[i].empty() && !(held & (1u << i)))
+            {
+                first = i;
+                break;
+            }
+        }
+        if (first == LANES)
+        {
+            return false;
+        }
+        lane = first;
+        promoted = false;
+        unsigned long now = millis();
+        unsigned long longest = PUBLISH_LANE_MAX_WAIT_MS;
+        for (size_t i = first + 1; i < LANES; i++)
+        {
+            if (lanes[i].empty() || (held & (1u << i)))
+            {
+                continue;
+            }
+            unsigned long waited = now - lanes[i].front().meta->enqueuedAt;
+            if (waited >= longest)
+            {
+                longest = waited;
+                lane = i;
+                promoted = true;
+            }
+        }
+        return true;
+    }
+
+    void complete(size_t lane, bool promoted, const PublishReceipt &receipt)
+    {
+        Lock lock(mutex);
+        lanes[lane].pop();
+        PublishLaneStats &laneStats = stats.lanes[lane];
+        laneStats.depth = lanes[lane].size();
+        laneStats.lastWaitMs = receipt.queuedMs();
+        if (laneStats.lastWaitMs > laneStats.maxWaitMs)
+        {
+            laneStats.maxWaitMs = laneStats.lastWaitMs;
+        }
+        switch (receipt.result)
+        {
+        case PublishResult::SENT:
+            stats.sent++;
+            laneStats.sent++;
+            if (promoted)
+            {
+                laneStats.promoted++;
+            }
+            break;
+        case PublishResult::FAILED:
+            stats.failed++;
+            break;
+        case PublishResult::TIMEOUT:
+            stats.timedOut++;
+            break;
+        case PublishResult::REFUSED:
+            stats.refused++;
+            break;
+        }
+        stats.lastLatencyMs = receipt.latencyMs();
+        if (stats.lastLatencyMs > stats.maxLatencyMs)
+        {
+            stats.maxLatencyMs = stats.lastLatencyMs;
+        }
+    }
+};
+
+#endif
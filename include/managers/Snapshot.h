@@ -0,0 +1,135 @@
+// Snapshot.h — read-copy-update holder for a rarely written, often read value.
+//
+// Readers take the current version without locking: a Reader claims one of a
+// fixed number of hazard slots, publishes the version it is about to use and
+// re-checks that it is still current. The writer (serialized by the caller)
+// fills a version no reader can see and swaps it in with one atomic store.
+// Versions come from a fixed pool of Readers + 2: each reader pins at most
+// one, so besides the current version one is always free. A reader therefore
+// never waits for a writer, nothing is allocated after construction, and a
+// version is never reused while a reader can see it.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+template <typename T, size_t Readers>
+class Snapshot {
+ public:
+  static const size_t kVersions = Readers + 2;
+
+  Snapshot() : current_(&versions_[0]) {
+    for (size_t i = 0; i < Readers; i++) {
+      claimed_[i].store(false);
+      hazards_[i].store(nullptr);
+    }
+  }
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  // Pins the current version for as long as it lives. Readers nest freely
+  // (each takes its own slot); with every slot busy the next one yields until
+  // a slot frees up.
+  class Reader {
+   public:
+    explicit Reader(Snapshot& owner) : owner_(owner), slot_(owner.claim()) {
+      const T* seen;
+      do {
+        seen = owner_.current_.load();
+        owner_.hazards_[slot_].store(seen);
+      } while (seen != owner_.current_.load());
+      value_ = seen;
+    }
+    ~Reader() {
+      owner_.hazards_[slot_].store(nullptr);
+      owner_.claimed_[slot_].store(false);
+    }
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    const T& operator*() const { return *value_; }
+    const T* operator->() const { return value_; }
+
+   private:
+    Snapshot& owner_;
+    size_t slot_;
+    const T* value_ = nullptr;
+  };
+
+  // The current version, for the writer to copy from. Only the writer
+  // publishes, so it stays valid until the caller's own publish().
+  const T& latest() const { return *current_.load(); }
+
+  // A version neither current nor held by a reader, for the writer to fill.
+  // It is not visible to anyone until publish().
+  T* acquire() {
+    const T* now = current_.load();
+    for (T& version : versions_) {
+      if (&version != now && !held(&version)) {
+        return &version;
+      }
+    }
+    return nullptr;  // unreachable: at most Readers versions are held
+  }
+
+  // Makes `next` (from acquire()) the current version.
+  void publish(T* next) {
+    current_.store(next);
+    version_++;
+  }
+
+  // Calls `visit(const T&)` for the current version and each one a reader
+  // still holds. A reader that starts later can only pin the current one.
+  template <typename Visit>
+  void eachHeld(Visit visit) const {
+    const T* now = current_.load();
+    visit(*now);
+    for (const T& version : versions_) {
+      if (&version != now && held(&version)) {
+        visit(version);
+      }
+    }
+  }
+
+  uint32_t version() const { return version_; }
+  // replaced versions still held by a reader
+  size_t pending() const {
+    size_t count = 0;
+    eachHeld([&](const T&) { count++; });
+    return count - 1;
+  }
+
+ private:
+  T versions_[kVersions];
+  std::atomic<const T*> current_;
+  std::atomic<bool> claimed_[Readers];
+  std::atomic<const T*> hazards_[Readers];
+  uint32_t version_ = 0;
+
+  bool held(const T* version) const {
+    for (size_t i = 0; i < Readers; i++) {
+      if (hazards_[i].load() == version) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t claim() {
+    while (true) {
+      for (size_t i = 0; i < Readers; i++) {
+        bool expected = false;
+        if (claimed_[i].compare_exchange_strong(expected, true)) {
+          return i;
+        }
+      }
+      vTaskDelay(1);
+    }
+  }
+};
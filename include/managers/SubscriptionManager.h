@@ -3,10 +3,22 @@
 #include <ArduinoLog.h>
 #include "processors/Processor.h"
 #include <ArduinoJson.h>
-#include <unordered_map>
 #include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include "Ticker.h"
 #include "managers/CoreDelay.h"
+#include "managers/PublishQueue.h"
+#include "managers/PublishBatcher.h"
+#include "managers/PublishGovernor.h"
+#include "managers/CallCache.h"
+#include "managers/TopicAliases.h"
+#include "managers/PayloadCompressor.h"
+#include "managers/JsonWriter.h"
+#include "EpochClock.h"
 #ifndef REGISTRATION_WAIT_TIME_IN_SECONDS
 #define REGISTRATION_WAIT_TIME_IN_SECONDS 20
 #endif
@@ -15,6 +27,26 @@
 #define FUNCTION_COUNT_MAX 20 // maximum number of functions that can be registered
 #endif
 
+#ifndef VARIABLE_COUNT_MAX
+#define VARIABLE_COUNT_MAX 20 // maximum number of variables that can be registered; variable() returns false beyond it
+#endif
+
+#ifndef RESULT_TOPIC_BYTES
+#define RESULT_TOPIC_BYTES 128 // buffer a function/variable result topic is written into
+#endif
+
+#ifndef RESULT_PAYLOAD_BYTES
+#define RESULT_PAYLOAD_BYTES 256 // buffer a function/variable result is written into; larger ones use the heap
+#endif
+
+#ifndef VARIABLE_BULK_BYTES
+#define VARIABLE_BULK_BYTES 1024 // buffer a bulk variable read is written into, allocated on the first one
+#endif
+
+#ifndef VARIABLE_REPORT_SAMPLE_MS
+#define VARIABLE_REPORT_SAMPLE_MS 100 // how often loop() samples the variables marked for reporting
+#endif
+
 #ifndef FUNCTION_REGISTRATION_SECONDS
 #define FUNCTION_REGISTRATION_SECONDS 10
 #endif
@@ -22,49 +54,152 @@
 #ifndef KEEP_ALIVE_INTERVAL
 #define KEEP_ALIVE_INTERVAL 20 // 20 seconds
 #endif
-// Define custom hash and equal functions for Arduino String
-struct StringHash
+
+#ifndef TOPIC_ALIAS_RESULTS
+#define TOPIC_ALIAS_RESULTS 0 // 1 aliases the function/variable result topics to <base>f/<id> and <base>v/<id>
+#endif
+
+#ifndef MQTT_STREAM_CHUNK_BYTES
+#define MQTT_STREAM_CHUNK_BYTES 512 // stack buffer used by publishStream(); the only RAM a stream needs
+#endif
+
+// Fills up to `capacity` bytes of the next chunk and returns how many it wrote (0 = no more data).
+typedef std::function<size_t(uint8_t *, size_t)> StreamReader;
+
+// A view of part of a topic: points into the topic, not NUL-terminated.
+struct TopicToken
+{
+    const char *at = "";
+    size_t length = 0;
+
+    bool equals(const char *text, size_t n) const { return n == length && memcmp(at, text, n) == 0; }
+    bool equals(const char *text) const { return equals(text, strlen(text)); }
+};
+
+// A text value as a sample: its FNV-1a hash, so any change is seen.
+inline double variableTextSample(const char *text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Writes a variable's value as JSON and samples it for change reporting:
+// anything JsonWriter has a value() overload for (bool, integers up to 64
+// bits, float, double) as is and as a number, text types through their length
+// and as a hash.
+template <typename T>
+struct VariableValue
 {
-    std::size_t operator()(const String &s) const
+    static void write(const T &value, JsonWriter &out) { out.value(value); }
+    static double sample(const T &value, bool &numeric)
     {
-        return std::hash<std::string>()(s.c_str());
+        numeric = true;
+        return (double)value;
     }
 };
 
-struct StringEqual
+template <>
+struct VariableValue<String>
 {
-    bool operator()(const String &lhs, const String &rhs) const
+    static void write(const String &value, JsonWriter &out) { out.value(value.c_str(), value.length()); }
+    static double sample(const String &value, bool &numeric)
     {
-        return lhs == rhs;
+        numeric = false;
+        return variableTextSample(value.c_str(), value.length());
     }
 };
 
-enum class VariableType
+template <>
+struct VariableValue<std::string>
 {
-    INT,
-    LONG,
-    STRING,
-    DOUBLE
+    static void write(const std::string &value, JsonWriter &out) { out.value(value.data(), value.size()); }
+    static double sample(const std::string &value, bool &numeric)
+    {
+        numeric = false;
+        return variableTextSample(value.data(), value.size());
+    }
+};
+
+template <>
+struct VariableValue<const char *>
+{
+    static void write(const char *value, JsonWriter &out) { out.value(value); }
+    static double sample(const char *value, bool &numeric)
+    {
+        numeric = false;
+        return value ? variableTextSample(value, strlen(value)) : 0;
+    }
 };
 
+/**
+ * @brief a registered variable, erased to thunks that write and sample its
+ * current value: `write` and `sample` read it through `source` (`size` bytes
+ * for a char array), or `getter` and `sampleGetter` compute it through the
+ * one callable they share
+ */
 struct VariableEntry
 {
-    VariableType type;
-    union Data
+    void (*write)(const void *source, size_t size, JsonWriter &out) = nullptr;
+    double (*sample)(const void *source, size_t size, bool &numeric) = nullptr;
+    const void *source = nullptr;
+    size_t size = 0;
+    std::function<void(JsonWriter &)> getter;
+    std::function<double(bool &)> sampleGetter;
+
+    void writeValue(JsonWriter &out) const
     {
-        int *intPtr;
-        long *longPtr;
-        String *stringPtr;
-        double *doublePtr;
+        if (getter)
+        {
+            getter(out);
+        }
+        else if (write)
+        {
+            write(source, size, out);
+        }
+        else
+        {
+            out.null();
+        }
+    }
 
-        Data() : intPtr(nullptr) {} // Default initialize to nullptr
-    } data;
+    // the value as a number, or a hash of it when `numeric` comes back false
+    double sampleValue(bool &numeric) const
+    {
+        if (sampleGetter)
+        {
+            return sampleGetter(numeric);
+        }
+        numeric = false;
+        return sample ? sample(source, size, numeric) : 0;
+    }
+};
 
-    // Default constructor (required by std::unordered_map)
-    VariableEntry() : type(VariableType::INT), data() {}
+/**
+ * @brief when a variable marked with report() is pushed to the cloud. A
+ * number is reported once it moves `deadband` or `deadbandPercent` of the
+ * last reported value away from it (any change when both are 0); text on any
+ * change. Reports are at least `minIntervalMs` apart, and `maxIntervalMs`
+ * (0 = never) reports an unchanged value as a heartbeat.
+ */
+struct ReportPolicy
+{
+    double deadband = 0;
+    float deadbandPercent = 0;
+    unsigned long minIntervalMs = 1000;
+    unsigned long maxIntervalMs = 0;
+};
 
-    // Constructor that accepts a VariableType
-    VariableEntry(VariableType t) : type(t), data() {}
+struct ReportStats
+{
+    uint32_t samples = 0;
+    uint32_t reports = 0;    // changes pushed
+    uint32_t heartbeats = 0; // unchanged values pushed on maxIntervalMs
+    uint32_t held = 0;       // samples past the deadband held back by minIntervalMs
+    uint32_t rejected = 0;   // reports the async publish queue had no room for; retried
 };
 
 class SubscriptionManager
@@ -73,6 +208,7 @@ class SubscriptionManager
 public:
     SubscriptionManager(Processor &);
     bool subscribe(const char *topic, std::function<void(const char *, const char *)> callback);
+    bool subscribe(const char *topic, std::function<void(const char *, const uint8_t *, size_t)> callback);
     bool unsubscribe(const char *topic);
     void function(const char *topic, std::function<int(const char *)> callback);
     bool loop();
@@ -80,15 +216,124 @@ public:
     bool maintain();
     bool publishTopic(String topic, String payload);
     bool publishTopic(const char *topic, uint8_t *buf, size_t length);
+    // Publishes `length` bytes read in fixed chunks, e.g. a SPIFFS File, without
+    // holding the payload in RAM or being limited by the MQTT packet buffer.
+    bool publishStream(const char *topic, Stream &source, size_t length);
+    bool publishStream(const char *topic, size_t length, StreamReader reader);
+    // Non-blocking: copies the message into the async queue and returns at once.
+    // false means the queue is full (backpressure); onDone is then not called.
+    bool publishAsync(const char *topic, const char *payload, PublishCallback onDone = nullptr,
+                      PublishPriority priority = PublishPriority::TELEMETRY);
+    bool publishAsync(const char *topic, const uint8_t *buf, size_t length, PublishCallback onDone = nullptr,
+                      PublishPriority priority = PublishPriority::TELEMETRY);
+    PublishQueueStats getPublishQueueStats() { return publishQueue.getStats(); }
+    // Optional coalescing: publishBatched() gathers messages into one JSON array
+    // envelope per topic (or per batchTopic), sent on size, window, or flush().
+    void enableBatching(size_t maxBytes = PUBLISH_BATCH_MAX_BYTES,
+                        unsigned long windowMs = PUBLISH_BATCH_WINDOW_MS,
+                        const char *batchTopic = nullptr);
+    bool disableBatching();
+    bool isBatching() { return batching; }
+    bool publishBatched(const char *topic, const char *payload);
+    bool publishBatched(const char *topic, const uint8_t *buf, size_t length);
+    bool flush();
+    PublishBatchStats getBatchStats() { return batcher.getStats(); }
+    // Rate and data-budget limits for application publishes on metered links.
+    // govern() decides a publish; deferred ones are released from loop().
+    bool limitTopic(const char *prefix, float perSecond, uint16_t burst,
+                    ThrottlePolicy policy = ThrottlePolicy::DEFER);
+    void setDataBudget(uint32_t bytesPerPeriod, ThrottlePolicy policy = ThrottlePolicy::REJECT);
+    void setMetered(bool metered) { governor.setMetered(metered); }
+    GovernorVerdict govern(const char *topic, const uint8_t *buf, size_t length, bool canDefer = true);
+    GovernorStats getGovernorStats() { return governor.getStats(); }
+    // Opt-in short aliases for long topic prefixes, announced in the
+    // registration manifest and used on the wire once it has been sent.
+    bool topicAlias(const char *prefix, const char *alias);
+    TopicAliasStats getTopicAliasStats() { return aliases.getStats(); }
+    // Opt-in LZ4 compression of payloads of at least `threshold` bytes, sent
+    // in a one-byte envelope (see PayloadCompressor). Streams are not compressed.
+    bool enableCompression(size_t threshold = PAYLOAD_COMPRESS_MIN_BYTES) { return compressor.enable(threshold); }
+    void disableCompression() { compressor.disable(); }
+    CompressionStats getCompressionStats() { return compressor.getStats(); }
+    PublishGovernor &getGovernor() { return governor; }
     bool isConnected();
     void setLastAlive() { lastAlive = millis(); }
-    void variable(const char *name, int *var);
-    void variable(const char *name, long *var);
-    void variable(const char *name, String *var);
-    void variable(const char *name, double *var);
+    // Registers a variable read through a pointer: bool, integers up to 64
+    // bits, float, double, String or std::string. Like every variable(), false
+    // once VARIABLE_COUNT_MAX variables are registered.
+    template <typename T, typename = typename std::enable_if<
+                              !std::is_function<T>::value &&
+                              !std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+    bool variable(const char *name, T *var)
+    {
+        VariableEntry entry;
+        typedef VariableValue<typename std::remove_cv<T>::type> Value;
+        entry.write = [](const void *source, size_t, JsonWriter &out)
+        { Value::write(*static_cast<const T *>(source), out); };
+        entry.sample = [](const void *source, size_t, bool &numeric)
+        { return Value::sample(*static_cast<const T *>(source), numeric); };
+        entry.source = var;
+        return addVariable(name, entry);
+    }
+    // A fixed char array, read up to its first NUL.
+    template <size_t N>
+    bool variable(const char *name, char (&var)[N])
+    {
+        VariableEntry entry;
+        entry.write = [](const void *source, size_t size, JsonWriter &out)
+        { out.value(static_cast<const char *>(source), strnlen(static_cast<const char *>(source), size)); };
+        entry.sample = [](const void *source, size_t size, bool &numeric)
+        {
+            numeric = false;
+            return variableTextSample(static_cast<const char *>(source), strnlen(static_cast<const char *>(source), size));
+        };
+        entry.source = var;
+        entry.size = N;
+        return addVariable(name, entry);
+    }
+    // A computed value: `getter` runs only when the variable is requested, and
+    // may return any type a pointer variable can have.
+    template <typename Getter, typename = decltype(std::declval<Getter &>()())>
+    bool variable(const char *name, Getter getter)
+    {
+        VariableEntry entry;
+        // one callable behind both thunks, so a stateful getter sees every call
+        auto shared = std::make_shared<Getter>(std::move(getter));
+        entry.getter = [shared](JsonWriter &out)
+        {
+            auto value = (*shared)();
+            VariableValue<decltype(value)>::write(value, out);
+        };
+        entry.sampleGetter = [shared](bool &numeric)
+        {
+            auto value = (*shared)();
+            return VariableValue<decltype(value)>::sample(value, numeric);
+        };
+        return addVariable(name, entry);
+    }
+    // Pushes a registered variable to the cloud when it changes instead of
+    // waiting to be polled; sampled from loop() every VARIABLE_REPORT_SAMPLE_MS.
+    // A getter variable is called on every sample.
+    bool report(const char *name, const ReportPolicy &policy = ReportPolicy());
+    bool stopReporting(const char *name);
+    ReportStats getReportStats() { return reportStats; }
     bool ready();
     String runFunction(const char *, const char *);
+    // Write the result JSON into `out` instead of a String. Return its length,
+    // which is >= capacity when it did not fit, or 0 when the key is unknown.
+    size_t runFunction(const char *topic, const char *payload, char *out, size_t capacity);
+    size_t runVariable(const char *topic, const char *payload, char *out, size_t capacity);
+    // A variable request for the key BULK_KEY reads several variables at once:
+    // the payload lists their names separated by commas, or is empty or "*"
+    // for all of them. The answer carries them in one "values" object.
+    static constexpr const char *BULK_KEY = "*";
+    // Redelivered function requests (same function and call id) are answered
+    // from the last CALL_CACHE_SIZE results instead of running again.
+    CallCacheStats getCallCacheStats() { return calls.getStats(); }
     String runVariable(const char *, const char *);
+    // Splits a request topic ".../<key>/<callId>" in place; callId runs to the
+    // end of the topic. false when the topic has no '/'.
+    static bool parseRequestTopic(const char *topic, TopicToken &key, TopicToken &callId);
     // Pure: builds the function/variable registration manifest JSON published to
     // the cloud (cataloging only). Extracted so it can be asserted without I/O.
     String buildRegistryPayload();
@@ -121,23 +366,79 @@ private:
     bool keepAliveReady();
     unsigned long lastAlive = 0;
     const unsigned long KEEP_ALIVE_INTERVAL_MS = KEEP_ALIVE_INTERVAL * 1000; // Keep-alive interval in seconds
-    String getCallId(const char *);
-    String getTopicKey(const char *);
+    struct VariableReport
+    {
+        bool enabled = false;
+        bool sent = false; // `last` holds the value last reported
+        bool numeric = false;
+        double last = 0;
+        unsigned long lastMs = 0;
+        ReportPolicy policy;
+    };
+    struct VariableSlot
+    {
+        String name;
+        VariableEntry entry;
+        VariableReport report;
+    };
     std::array<std::string, FUNCTION_COUNT_MAX> functionTopics;
+    std::array<std::function<int(const char *)>, FUNCTION_COUNT_MAX> functionCallbacks;
     u_int8_t functionCount = 0;
     u_int8_t variableCount = 0;
-    std::unordered_map<String, VariableEntry, StringHash, StringEqual> variableRegistry;
-    std::unordered_map<std::string, std::function<int(const char *)>> functionCallbacks;
+    std::array<VariableSlot, VARIABLE_COUNT_MAX> variableRegistry;
+    bool addVariable(const char *name, const VariableEntry &entry);
+    int findFunction(const TopicToken &key);
+    VariableSlot *findVariable(const TopicToken &key);
+    int callFunction(const TopicToken &key, const TopicToken &callId, const char *payload, int &result);
+    void writeFunctionResult(int index, const TopicToken &callId, int result, JsonWriter &out);
+    void writeVariable(const VariableSlot *slot, const TopicToken &callId, JsonWriter &out);
+    void writeVariables(const char *names, const TopicToken &callId, JsonWriter &out);
+    bool writeVariableResult(const TopicToken &key, const TopicToken &callId, const char *payload, JsonWriter &out);
+    static bool bulkSelects(const char *names, const String &name);
+    std::unique_ptr<char[]> bulkPayload;
+    ReportStats reportStats;
+    uint8_t reportCount = 0;
+    unsigned long lastReportSample = 0;
+    void reportVariables();
+    bool reportDue(VariableSlot &slot, double value, bool numeric, unsigned long now, bool &heartbeat);
+    bool sendReport(const VariableSlot &slot);
+    template <typename Write, typename Use>
+    static void writeResult(char *buf, size_t capacity, Write write, Use use);
+    char resultPayload[RESULT_PAYLOAD_BYTES];
+    CallCache calls;
+    // "<results topic>/<key>/<callId>"; the prefix is copied in once
+    struct ResultTopic
+    {
+        char text[RESULT_TOPIC_BYTES];
+        size_t prefix = 0;
+    };
+    ResultTopic functionResult;
+    ResultTopic variableResult;
+    static void setResultPrefix(ResultTopic &result, const String &prefix);
+    static const char *resultTopic(ResultTopic &result, const TopicToken &key, const TopicToken &callId);
     void functionalCallback(const char *, const char *);
     void variableCallback(const char *, const char *);
     static void registrationCallback(SubscriptionManager *instance);
     Processor &processor;
+    PublishQueue publishQueue;
+    void drainPublishQueue();
+    void publishResult(const char *topic, const char *payload, size_t length);
+    PublishBatcher batcher;
+    bool batching = false;
+    bool sendBatch(const char *topic, const uint8_t *buf, size_t length);
+    PublishGovernor governor;
+    void releaseGoverned();
+    TopicAliases aliases;
+    const char *wireTopic(const char *topic, String &scratch);
+    PayloadCompressor compressor;
+    bool transmit(const char *topic, const uint8_t *buf, size_t length, bool text = false);
 
     String registrationTopic = String(MQTT_TOPIC_BASE) + "Post/Register/" + deviceId;
     String functionTopic = String(MQTT_TOPIC_BASE) + "Post/Function/" + deviceId + "/#";
     String functionResultsTopic = String(MQTT_TOPIC_BASE) + "Post/Function/Result/" + deviceId;
     String variableTopic = String(MQTT_TOPIC_BASE) + "Post/Variable/" + deviceId + "/#";
     String variableResultsTopic = String(MQTT_TOPIC_BASE) + "Post/Variable/Result/" + deviceId;
+    String variableReportTopic = String(MQTT_TOPIC_BASE) + "Post/Variable/Report/" + deviceId;
 };
 
 #endif
@@ -0,0 +1,176 @@
+#ifndef __topic_aliases_h
+#define __topic_aliases_h
+#include <Arduino.h>
+#include <array>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#ifndef TOPIC_ALIAS_MAX
+#define TOPIC_ALIAS_MAX 8 // topic prefixes that can be given a short alias
+#endif
+
+struct TopicAliasStats
+{
+    uint32_t aliased = 0;    // publishes sent under an alias
+    uint32_t bytesSaved = 0; // topic bytes not sent thanks to aliases
+};
+
+/**
+ * @brief short stand-ins for long topic prefixes. The table is announced to
+ * the cloud in the registration manifest; once it has been, a publish whose
+ * topic starts with a registered prefix goes out with the alias in its place
+ * (`Hy/Post/Function/Result/<id>/key/call` -> `Hy/f/<id>/key/call`). The
+ * longest matching prefix wins. MQTT 3.1.1 has no topic aliases of its own,
+ * so the cloud maps the alias back using the manifest.
+ */
+class TopicAliases
+{
+public:
+    TopicAliases() : mutex(xSemaphoreCreateMutex()) {}
+
+    /**
+     * @brief maps `prefix` to `alias`, replacing an earlier alias of the prefix
+     *
+     * @return false - the alias is not shorter, has wildcards, is taken by
+     * another prefix, or the table is full
+     */
+    bool add(const char *prefix, const char *alias)
+    {
+        Lock lock(mutex);
+        size_t aliasLength = strlen(alias);
+        if (aliasLength == 0 || aliasLength >= strlen(prefix) || strpbrk(alias, "+#"))
+        {
+            return false;
+        }
+        Entry *slot = nullptr;
+        for (auto &entry : entries)
+        {
+            if (entry.used && entry.alias == alias && entry.prefix != prefix)
+            {
+                return false;
+            }
+            if (entry.used && entry.prefix == prefix)
+            {
+                slot = &entry;
+            }
+        }
+        for (auto &entry : entries)
+        {
+            if (!slot && !entry.used)
+            {
+                slot = &entry;
+            }
+        }
+        if (!slot)
+        {
+            return false;
+        }
+        slot->used = true;
+        slot->prefix = prefix;
+        slot->alias = alias;
+        return true;
+    }
+
+    /**
+     * @brief aliases apply from now on; called once the manifest carrying
+     * them has been published
+     */
+    void announce()
+    {
+        Lock lock(mutex);
+        announced = true;
+    }
+
+    bool isAnnounced()
+    {
+        Lock lock(mutex);
+        return announced;
+    }
+
+    bool empty()
+    {
+        Lock lock(mutex);
+        for (auto &entry : entries)
+        {
+            if (entry.used)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief visits every (alias, prefix) pair, for the manifest
+     */
+    void each(std::function<void(const char *, const char *)> visit)
+    {
+        Lock lock(mutex);
+        for (auto &entry : entries)
+        {
+            if (entry.used)
+            {
+                visit(entry.alias.c_str(), entry.prefix.c_str());
+            }
+        }
+    }
+
+    /**
+     * @brief the topic to put on the wire: `topic` itself, or its aliased form
+     * built in `scratch`
+     */
+    const char *shorten(const char *topic, String &scratch)
+    {
+        Lock lock(mutex);
+        if (!announced)
+        {
+            return topic;
+        }
+        const Entry *best = nullptr;
+        for (const auto &entry : entries)
+        {
+            size_t n = entry.prefix.length();
+            if (entry.used && strncmp(topic, entry.prefix.c_str(), n) == 0 &&
+                (!best || n > best->prefix.length()))
+            {
+                best = &entry;
+            }
+        }
+        if (!best)
+        {
+            return topic;
+        }
+        scratch = best->alias;
+        scratch += topic + best->prefix.length();
+        stats.aliased++;
+        stats.bytesSaved += best->prefix.length() - best->alias.length();
+        return scratch.c_str();
+    }
+
+    TopicAliasStats getStats()
+    {
+        Lock lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        bool used = false;
+        String prefix;
+        String alias;
+    };
+    struct Lock
+    {
+        SemaphoreHandle_t m;
+        Lock(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGive(m); }
+    };
+    SemaphoreHandle_t mutex;
+    std::array<Entry, TOPIC_ALIAS_MAX> entries;
+    bool announced = false;
+    TopicAliasStats stats;
+};
+
+#endif
@@ -0,0 +1,133 @@
+// TopicFilter.h — an MQTT topic filter compiled once at registration.
+//
+// compile() validates the filter, copies its text to the heap once and
+// records where each of its levels starts, which is all TopicIndex needs to
+// place and find it. Matching never allocates.
+//
+// Matching follows MQTT 3.1.1 §4.7, the same rules as TopicIndex.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <new>
+
+#ifndef TOPIC_FILTER_MAX_LEVELS
+#define TOPIC_FILTER_MAX_LEVELS 16  // deepest topic filter that can be compiled
+#endif
+
+class TopicFilter {
+ public:
+  static const size_t kMaxLevels = TOPIC_FILTER_MAX_LEVELS;
+  // level offsets are 16-bit; MQTT caps a topic at 65535 bytes anyway
+  static const size_t kMaxBytes = 0xFFFF;
+
+  // A filter is valid when it is non-empty and every `+`/`#` occupies a whole
+  // level, with `#` only as the last one.
+  static bool valid(const char* filter) {
+    if (!filter || !*filter) {
+      return false;
+    }
+    for (const char* at = filter; *at; at++) {
+      bool levelStart = at == filter || at[-1] == '/';
+      bool levelEnd = at[1] == '\0' || at[1] == '/';
+      if (*at == '+' && !(levelStart && levelEnd)) {
+        return false;
+      }
+      if (*at == '#' && !(levelStart && at[1] == '\0')) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  TopicFilter() = default;
+  explicit TopicFilter(const char* filter) { compile(filter); }
+  TopicFilter(TopicFilter&&) = default;
+  TopicFilter& operator=(TopicFilter&&) = default;
+
+  // False (and the filter matches nothing) when `filter` is invalid, deeper
+  // than TOPIC_FILTER_MAX_LEVELS, longer than MQTT allows or out of memory.
+  bool compile(const char* filter) {
+    clear();
+    if (!valid(filter)) {
+      return false;
+    }
+    size_t bytes = strlen(filter);
+    if (bytes >= kMaxBytes) {
+      return false;
+    }
+    text_.reset(new (std::nothrow) char[bytes + 1]);
+    if (!text_) {
+      return false;
+    }
+    memcpy(text_.get(), filter, bytes + 1);
+    const char* at = text_.get();
+    while (true) {
+      if (levels_ == kMaxLevels) {
+        clear();
+        return false;
+      }
+      const char* slash = strchr(at, '/');
+      starts_[levels_++] = (uint16_t)(at - text_.get());
+      if (!slash) {
+        break;
+      }
+      at = slash + 1;
+    }
+    starts_[levels_] = (uint16_t)(bytes + 1);
+    return true;
+  }
+
+  // Whether `topic` matches, level by level. Dispatch goes through
+  // TopicIndex; this serves one-off checks.
+  bool matches(const char* topic) const {
+    if (levels_ == 0 || !topic || !*topic) {
+      return false;
+    }
+    if (topic[0] == '$' && (text_[0] == '+' || text_[0] == '#')) {
+      return false;
+    }
+    const char* at = topic;
+    for (size_t i = 0; i < levels_; i++) {
+      const char* own = level(i);
+      size_t ownLength = length(i);
+      if (ownLength == 1 && *own == '#') {
+        return true;  // also matches the parent level
+      }
+      if (!at) {
+        return false;
+      }
+      const char* slash = strchr(at, '/');
+      size_t topicLength = slash ? (size_t)(slash - at) : strlen(at);
+      bool plus = ownLength == 1 && *own == '+';
+      if (!plus && (topicLength != ownLength || memcmp(at, own, ownLength) != 0)) {
+        return false;
+      }
+      at = slash ? slash + 1 : nullptr;
+    }
+    return at == nullptr;
+  }
+
+  // Whether this is exactly `filter` (no wildcard expansion).
+  bool is(const char* filter) const { return filter && strcmp(c_str(), filter) == 0; }
+
+  bool empty() const { return levels_ == 0; }
+  const char* c_str() const { return text_ ? text_.get() : ""; }
+  size_t levels() const { return levels_; }
+  // level i (i < levels()): its first byte and length
+  const char* level(size_t i) const { return text_.get() + starts_[i]; }
+  size_t length(size_t i) const { return starts_[i + 1] - starts_[i] - 1; }
+
+ private:
+  std::unique_ptr<char[]> text_;
+  uint16_t starts_[kMaxLevels + 1] = {};
+  uint8_t levels_ = 0;
+
+  void clear() {
+    text_.reset();
+    levels_ = 0;
+  }
+};
@@ -0,0 +1,313 @@
+// TopicIndex.h — fixed-capacity MQTT topic-filter trie over compiled filters.
+//
+// Matches per MQTT 3.1.1 §4.7 and lives in a fixed pool of nodes, so it never
+// allocates. One writer (serialized by the caller) changes it in place while
+// any number of readers match against it without locking:
+//
+//   - a new branch is built off to the side and linked in with one atomic
+//     store, so a reader sees all of it or none of it;
+//   - the literal children of a node form a sorted sibling list, and a node is
+//     unlinked with one store to its predecessor, leaving its own links intact
+//     for a reader still standing on it;
+//   - an unlinked node is only retired, stamped with the caller's `retireAt`,
+//     and insert() reuses it once the caller's `oldest` reader has moved past
+//     that stamp (see CommunicationRegistry);
+//   - a node stores no text. It names one filter passing through it (its
+//     witness) and reads its level from that filter.
+//
+// Filters are referred to by their slot in a caller-owned TopicFilter array,
+// which every call receives and which must keep the inserted filters, and any
+// erased one until its nodes are reused, intact.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "managers/TopicFilter.h"
+
+template <size_t Nodes>
+class TopicIndex {
+ public:
+  static_assert(Nodes >= 1 && Nodes < 0xFFFF, "node indices are 16-bit");
+  static const uint16_t kNoFilter = 0xFFFF;
+
+  TopicIndex() { nodes_[0].used = true; }
+
+  TopicIndex(const TopicIndex&) = delete;
+  TopicIndex& operator=(const TopicIndex&) = delete;
+
+  // Adds the filter in `slot`, reusing only nodes retired at or before
+  // `oldest`; false when too few are free, in which case nothing changes.
+  bool insert(const TopicFilter* filters, uint16_t slot, uint32_t oldest = UINT32_MAX) {
+    const TopicFilter& filter = filters[slot];
+    if (filter.empty()) {
+      return false;
+    }
+    // follow the existing path as far as it goes
+    uint16_t node = 0;
+    size_t i = 0;
+    for (; i < filter.levels(); i++) {
+      uint16_t next = step(filters, node, filter.level(i), filter.length(i));
+      if (next == kNone) {
+        break;
+      }
+      node = next;
+    }
+    if (i == filter.levels()) {
+      if (nodes_[node].filter.load() == kNoFilter) {
+        filters_++;
+      }
+      nodes_[node].filter.store(slot);
+      return true;
+    }
+    if (available(oldest) < filter.levels() - i) {
+      return false;
+    }
+    // build the missing levels unlinked, then attach them in one store
+    uint16_t top = kNone, last = kNone;
+    for (size_t k = i; k < filter.levels(); k++) {
+      uint16_t added = allocate(slot, k, oldest);
+      if (last != kNone) {
+        link(filters, last, filter.level(k), filter.length(k), added);
+      } else {
+        top = added;
+      }
+      last = added;
+    }
+    nodes_[last].filter.store(slot);
+    filters_++;
+    link(filters, node, filter.level(i), filter.length(i), top);
+    return true;
+  }
+
+  // Removes the filter in `slot`, unlinking the nodes it no longer needs and
+  // retiring them at `retireAt`. The filter must still be intact in `filters`.
+  bool erase(const TopicFilter* filters, uint16_t slot, uint32_t retireAt = 0) {
+    if (filters[slot].empty()) {
+      return false;
+    }
+    bool erased = false;
+    remove(filters, 0, filters[slot], 0, slot, retireAt, erased);
+    if (erased) {
+      filters_--;
+    }
+    return erased;
+  }
+
+  // Calls `visit(uint16_t slot)` for every filter matching `topic` and
+  // returns how many matched. Each matching filter is visited once. Safe
+  // against a concurrent insert() or erase().
+  template <typename Visit>
+  size_t match(const TopicFilter* filters, const char* topic, Visit visit) const {
+    if (!topic || !*topic) {
+      return 0;
+    }
+    size_t hits = 0;
+    walk(filters, 0, topic, true, visit, hits);
+    return hits;
+  }
+
+  size_t size() const { return filters_; }
+  // pool nodes in use, the root included
+  size_t nodes() const { return used_; }
+
+ private:
+  static const uint16_t kNone = 0xFFFF;
+
+  struct Node {
+    std::atomic<uint16_t> filter{kNoFilter};   // slot of the filter ending here
+    std::atomic<uint16_t> witness{kNoFilter};  // slot of a filter passing through here
+    std::atomic<uint16_t> first{kNone};        // first literal child, in text order
+    std::atomic<uint16_t> next{kNone};         // next sibling
+    std::atomic<uint16_t> plus{kNone};
+    std::atomic<uint16_t> hash{kNone};
+    uint8_t level = 0;  // level of the witness this node stands for
+    bool used = false;
+    uint32_t retiredAt = 0;
+  };
+
+  Node nodes_[Nodes];
+  size_t used_ = 1;
+  size_t filters_ = 0;
+
+  static bool wildcard(const char* at, size_t length) { return length == 1 && (*at == '+' || *at == '#'); }
+
+  int compare(const TopicFilter* filters, uint16_t node, const char* at, size_t length) const {
+    const Node& n = nodes_[node];
+    const TopicFilter& witness = filters[n.witness.load()];
+    size_t own = witness.length(n.level);
+    int order = memcmp(witness.level(n.level), at, own < length ? own : length);
+    if (order != 0) {
+      return order;
+    }
+    return own < length ? -1 : own > length ? 1 : 0;
+  }
+
+  // The literal child of `node` for the level, or kNone.
+  uint16_t child(const TopicFilter* filters, uint16_t node, const char* at, size_t length) const {
+    for (uint16_t kid = nodes_[node].first.load(); kid != kNone; kid = nodes_[kid].next.load()) {
+      int order = compare(filters, kid, at, length);
+      if (order == 0) {
+        return kid;
+      }
+      if (order > 0) {
+        break;
+      }
+    }
+    return kNone;
+  }
+
+  // The child of `node` a filter level leads to, wildcard or literal.
+  uint16_t step(const TopicFilter* filters, uint16_t node, const char* at, size_t length) const {
+    if (wildcard(at, length)) {
+      return (*at == '+' ? nodes_[node].plus : nodes_[node].hash).load();
+    }
+    return child(filters, node, at, length);
+  }
+
+  // Makes the unlinked `added` the child of `node` for the level.
+  void link(const TopicFilter* filters, uint16_t node, const char* at, size_t length, uint16_t added) {
+    if (wildcard(at, length)) {
+      (*at == '+' ? nodes_[node].plus : nodes_[node].hash).store(added);
+      return;
+    }
+    std::atomic<uint16_t>* before = &nodes_[node].first;
+    uint16_t kid = before->load();
+    while (kid != kNone && compare(filters, kid, at, length) < 0) {
+      before = &nodes_[kid].next;
+      kid = before->load();
+    }
+    nodes_[added].next.store(kid);
+    before->store(added);
+  }
+
+  // Unlinks the literal child `kid` of `node`; its own links stay as they are.
+  void unlink(uint16_t node, uint16_t kid) {
+    std::atomic<uint16_t>* before = &nodes_[node].first;
+    while (before->load() != kid) {
+      before = &nodes_[before->load()].next;
+    }
+    before->store(nodes_[kid].next.load());
+  }
+
+  bool reusable(const Node& node, uint32_t oldest) const { return !node.used && node.retiredAt <= oldest; }
+
+  size_t available(uint32_t oldest) const {
+    size_t count = 0;
+    for (size_t i = 1; i < Nodes; i++) {
+      count += reusable(nodes_[i], oldest);
+    }
+    return count;
+  }
+
+  uint16_t allocate(uint16_t witness, size_t level, uint32_t oldest) {
+    for (size_t i = 1; i < Nodes; i++) {
+      Node& n = nodes_[i];
+      if (reusable(n, oldest)) {
+        n.filter.store(kNoFilter);
+        n.witness.store(witness);
+        n.first.store(kNone);
+        n.next.store(kNone);
+        n.plus.store(kNone);
+        n.hash.store(kNone);
+        n.level = (uint8_t)level;
+        n.used = true;
+        used_++;
+        return (uint16_t)i;
+      }
+    }
+    return kNone;  // available() is checked first
+  }
+
+  void retire(uint16_t node, uint32_t retireAt) {
+    nodes_[node].used = false;
+    nodes_[node].retiredAt = retireAt;
+    used_--;
+  }
+
+  bool unused(const Node& node) const {
+    return node.filter.load() == kNoFilter && node.first.load() == kNone && node.plus.load() == kNone &&
+           node.hash.load() == kNone;
+  }
+
+  // Slot of some filter ending at or below `node`.
+  uint16_t anyFilter(uint16_t node) const {
+    while (nodes_[node].filter.load() == kNoFilter) {
+      const Node& n = nodes_[node];
+      uint16_t first = n.first.load();
+      node = first != kNone ? first : n.plus.load() != kNone ? n.plus.load() : n.hash.load();
+    }
+    return nodes_[node].filter.load();
+  }
+
+  // Removes `slot` below `node`; true when `node` itself became unused.
+  bool remove(const TopicFilter* filters, uint16_t node, const TopicFilter& filter, size_t level, uint16_t slot,
+              uint32_t retireAt, bool& erased) {
+    if (level == filter.levels()) {
+      if (nodes_[node].filter.load() == slot) {
+        nodes_[node].filter.store(kNoFilter);
+        erased = true;
+      }
+    } else {
+      const char* at = filter.level(level);
+      size_t length = filter.length(level);
+      uint16_t next = step(filters, node, at, length);
+      if (next != kNone && remove(filters, next, filter, level + 1, slot, retireAt, erased)) {
+        if (wildcard(at, length)) {
+          (*at == '+' ? nodes_[node].plus : nodes_[node].hash).store(kNone);
+        } else {
+          unlink(node, next);
+        }
+        retire(next, retireAt);
+      }
+    }
+    if (node == 0) {
+      return false;
+    }
+    if (unused(nodes_[node])) {
+      return true;
+    }
+    if (nodes_[node].witness.load() == slot) {
+      nodes_[node].witness.store(anyFilter(node));
+    }
+    return false;
+  }
+
+  // `at` is the start of the next topic level, or nullptr once every level
+  // has been consumed.
+  template <typename Visit>
+  void walk(const TopicFilter* filters, uint16_t node, const char* at, bool root, Visit& visit, size_t& hits) const {
+    const Node& n = nodes_[node];
+    bool system = root && at && *at == '$';
+    uint16_t hash = n.hash.load();
+    if (hash != kNone && !system) {
+      uint16_t slot = nodes_[hash].filter.load();
+      if (slot != kNoFilter) {
+        hits++;
+        visit(slot);
+      }
+    }
+    if (!at) {
+      uint16_t slot = n.filter.load();
+      if (slot != kNoFilter) {
+        hits++;
+        visit(slot);
+      }
+      return;
+    }
+    const char* slash = strchr(at, '/');
+    size_t length = slash ? (size_t)(slash - at) : strlen(at);
+    const char* next = slash ? slash + 1 : nullptr;
+    uint16_t literal = child(filters, node, at, length);
+    if (literal != kNone) {
+      walk(filters, literal, next, false, visit, hits);
+    }
+    uint16_t plus = n.plus.load();
+    if (plus != kNone && !system) {
+      walk(filters, plus, next, false, visit, hits);
+    }
+  }
+};
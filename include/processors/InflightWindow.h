@@ -0,0 +1,177 @@
+// InflightWindow.h — QoS 1 publishes awaiting their PUBACK.
+//
+// Each publish is encoded once, straight into a MessageRing arena, and kept
+// there until the broker acknowledges its packet id, so a retransmission is a
+// single write of the stored bytes with the DUP flag set. Up to Depth publishes
+// may be outstanding at once (pipelined rather than stop-and-wait). Acks are
+// normally in order (MQTT 3.1.1 §4.6); an out-of-order ack just marks its slot
+// and the ring is trimmed once the oldest entries are settled.
+//
+// Not synchronized: the processor serializes access with its own lock.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "managers/MessageRing.h"
+#include "processors/MqttPacket.h"
+
+struct InflightStats {
+  uint32_t published = 0;    // QoS 1 publishes written
+  uint32_t acked = 0;
+  uint32_t retransmits = 0;  // DUP resends after a timeout or reconnect
+  uint32_t expired = 0;      // given up after the retransmit limit
+  uint32_t rejected = 0;     // refused because the window was full
+  uint32_t highWater = 0;
+  unsigned long lastAckMs = 0;  // first send -> PUBACK
+  unsigned long maxAckMs = 0;
+  uint64_t totalAckMs = 0;
+  unsigned long averageAckMs() const {
+    return acked ? (unsigned long)(totalAckMs / acked) : 0;
+  }
+};
+
+template <size_t Bytes, size_t Depth>
+class InflightWindow {
+ public:
+  // Ids come from the upper half of the 16-bit space; PubSubClient numbers its
+  // own SUBSCRIBE/UNSUBSCRIBE packets upward from 1, so the two never meet.
+  static constexpr uint16_t kFirstPacketId = 0x8000;
+
+  struct Packet {
+    uint16_t id;
+    const uint8_t* data;
+    size_t length;
+  };
+
+  // Encodes a QoS 1 PUBLISH into the window. `packet` stays valid until the
+  // entry is acked, cancelled or expired. false when the window is full.
+  bool add(const char* topic, const uint8_t* payload, size_t length,
+           unsigned long now, Packet& packet) {
+    size_t size = hyphen::mqtt::publishSize(strlen(topic), length, 1);
+    Entry entry;
+    entry.id = nextId();
+    entry.firstSentAt = now;
+    entry.sentAt = now;
+    uint8_t* at = ring_.emplace(size, entry);
+    if (!at) {
+      stats_.rejected++;
+      return false;
+    }
+    hyphen::mqtt::encodePublish(at, size, topic, payload, length, 1, entry.id);
+    packet = Packet{entry.id, at, size};
+    stats_.published++;
+    if (ring_.size() > stats_.highWater) {
+      stats_.highWater = ring_.size();
+    }
+    return true;
+  }
+
+  // PUBACK for `id`. Returns false for ids not in the window (late duplicates).
+  bool ack(uint16_t id, unsigned long now) {
+    Entry* entry = find(id);
+    if (!entry) {
+      return false;
+    }
+    entry->done = true;
+    unsigned long latency = now - entry->firstSentAt;
+    stats_.acked++;
+    stats_.lastAckMs = latency;
+    stats_.totalAckMs += latency;
+    if (latency > stats_.maxAckMs) {
+      stats_.maxAckMs = latency;
+    }
+    trim();
+    return true;
+  }
+
+  // Forgets an entry whose first write failed (nothing reached the broker).
+  void cancel(uint16_t id) {
+    Entry* entry = find(id);
+    if (entry) {
+      entry->done = true;
+      stats_.published--;
+      trim();
+    }
+  }
+
+  // Resends (with DUP) every entry unacknowledged for `timeoutMs`, and gives up
+  // on those already resent `maxRetries` times. `write(data, length)` returns
+  // false when the socket is gone, which stops the pass.
+  template <typename Write>
+  size_t service(unsigned long now, unsigned long timeoutMs, uint8_t maxRetries,
+                 Write write) {
+    size_t resent = 0;
+    for (size_t i = 0; i < ring_.size(); i++) {
+      auto view = ring_.at(i);
+      Entry* entry = view.meta;
+      if (entry->done || now - entry->sentAt < timeoutMs) {
+        continue;
+      }
+      if (entry->retries >= maxRetries) {
+        entry->done = true;
+        stats_.expired++;
+        continue;
+      }
+      // the packet bytes live in our own arena; only the flag byte changes
+      const_cast<uint8_t*>(view.payload)[0] |= hyphen::mqtt::kDupFlag;
+      if (!write(view.payload, view.length)) {
+        break;
+      }
+      entry->retries++;
+      entry->sentAt = now;
+      stats_.retransmits++;
+      resent++;
+    }
+    trim();
+    return resent;
+  }
+
+  // Makes every outstanding entry due now, e.g. after a reconnect where the
+  // protocol requires unacknowledged publishes to be resent.
+  void expedite(unsigned long now, unsigned long timeoutMs) {
+    for (size_t i = 0; i < ring_.size(); i++) {
+      ring_.at(i).meta->sentAt = now - timeoutMs;
+    }
+  }
+
+  size_t size() const { return ring_.size(); }
+  bool full() const { return ring_.full(); }
+  bool empty() const { return ring_.empty(); }
+  const InflightStats& stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    uint16_t id = 0;
+    uint8_t retries = 0;
+    bool done = false;
+    unsigned long firstSentAt = 0;
+    unsigned long sentAt = 0;
+  };
+
+  uint16_t nextId() {
+    uint16_t id = next_;
+    next_ = next_ == 0xFFFF ? kFirstPacketId : next_ + 1;
+    return id;
+  }
+
+  Entry* find(uint16_t id) {
+    for (size_t i = 0; i < ring_.size(); i++) {
+      Entry* entry = ring_.at(i).meta;
+      if (!entry->done && entry->id == id) {
+        return entry;
+      }
+    }
+    return nullptr;
+  }
+
+  void trim() {
+    while (!ring_.empty() && ring_.front().meta->done) {
+      ring_.pop();
+    }
+  }
+
+  MessageRing<Bytes, Depth, Entry> ring_;
+  InflightStats stats_;
+  uint16_t next_ = kFirstPacketId;
+};
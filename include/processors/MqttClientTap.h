@@ -0,0 +1,121 @@
+#ifndef __mqtt_client_tap_h
+#define __mqtt_client_tap_h
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "processors/MqttPacket.h"
+
+/**
+ * @brief a pass-through Client placed between PubSubClient and the transport.
+ * Every byte PubSubClient reads is also fed to a PacketSniffer, so control
+ * packets the library discards (PUBACK, SUBACK, CONNACK flags) still reach the
+ * processor. Writes go straight through, which also lets the processor put its
+ * own packets on the same socket. It also times each transport connect (for
+ * a secure client that is the TCP plus TLS handshake).
+ *
+ * Writes can be guarded by a recursive mutex, so the bytes PubSubClient sends
+ * on its own from loop() (keep-alives, acks) wait for whoever holds it to
+ * finish a packet, while reads and the callbacks they trigger run unlocked.
+ */
+class MqttClientTap : public Client
+{
+public:
+    void attach(Client &client)
+    {
+        inner = &client;
+        sniffer.reset();
+    }
+    void onPacket(hyphen::mqtt::PacketSniffer::Handler handler) { sniffer.onPacket(handler); }
+    void reset() { sniffer.reset(); }
+    void lockWritesWith(SemaphoreHandle_t mutex) { writeMutex = mutex; }
+
+    uint32_t getConnects() { return connects; }
+    unsigned long getConnectMs() { return connectMs; }
+
+    int connect(IPAddress ip, uint16_t port) override
+    {
+        return timed([&]()
+                     { return inner->connect(ip, port); });
+    }
+    int connect(const char *host, uint16_t port) override
+    {
+        return timed([&]()
+                     { return inner->connect(host, port); });
+    }
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        if (!inner)
+        {
+            return 0;
+        }
+        if (!writeMutex)
+        {
+            return inner->write(buf, size);
+        }
+        xSemaphoreTakeRecursive(writeMutex, portMAX_DELAY);
+        size_t written = inner->write(buf, size);
+        xSemaphoreGiveRecursive(writeMutex);
+        return written;
+    }
+    int available() override { return inner ? inner->available() : 0; }
+    int read() override
+    {
+        int b = inner ? inner->read() : -1;
+        if (b >= 0)
+        {
+            sniffer.feed((uint8_t)b);
+        }
+        return b;
+    }
+    int read(uint8_t *buf, size_t size) override
+    {
+        int n = inner ? inner->read(buf, size) : -1;
+        if (n > 0)
+        {
+            sniffer.feed(buf, (size_t)n);
+        }
+        return n;
+    }
+    int peek() override { return inner ? inner->peek() : -1; }
+    void flush() override
+    {
+        if (inner)
+        {
+            inner->flush();
+        }
+    }
+    void stop() override
+    {
+        if (inner)
+        {
+            inner->stop();
+        }
+    }
+    uint8_t connected() override { return inner ? inner->connected() : 0; }
+    operator bool() override { return inner && (bool)*inner; }
+
+private:
+    Client *inner = nullptr;
+    SemaphoreHandle_t writeMutex = nullptr;
+    hyphen::mqtt::PacketSniffer sniffer;
+    uint32_t connects = 0;
+    unsigned long connectMs = 0;
+
+    template <typename Connect>
+    int timed(Connect connect)
+    {
+        sniffer.reset();
+        if (!inner)
+        {
+            return 0;
+        }
+        unsigned long started = millis();
+        int rc = connect();
+        connectMs = millis() - started;
+        connects++;
+        return rc;
+    }
+};
+
+#endif
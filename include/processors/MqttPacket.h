@@ -0,0 +1,196 @@
+// MqttPacket.h — the MQTT 3.1.1 framing the processor handles itself.
+//
+// PubSubClient only publishes at QoS 0 and silently discards acknowledgements,
+// so QoS 1 PUBLISH packets are encoded here and the inbound byte stream is
+// watched by a PacketSniffer to pick up PUBACK/SUBACK/CONNACK. Multi-filter
+// SUBSCRIBE packets are framed here too (see SubscribeBatch). Dependency-free
+// (no Arduino) so it unit-tests on the host.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+
+namespace hyphen {
+namespace mqtt {
+
+enum PacketType : uint8_t {
+  CONNACK = 2,
+  PUBLISH = 3,
+  PUBACK = 4,
+  SUBSCRIBE = 8,
+  SUBACK = 9,
+  UNSUBACK = 11,
+};
+
+constexpr uint8_t kDupFlag = 0x08;
+// SUBACK return code for a refused filter.
+constexpr uint8_t kSubscribeFailure = 0x80;
+// Fixed header of a packet: type byte plus up to four length bytes.
+constexpr size_t kMaxFixedHeader = 5;
+
+// Bytes taken by the variable-length "remaining length" field.
+inline size_t lengthFieldSize(size_t remaining) {
+  size_t n = 1;
+  while (remaining >= 128) {
+    remaining /= 128;
+    n++;
+  }
+  return n;
+}
+
+inline size_t encodeLength(uint8_t* out, size_t remaining) {
+  size_t n = 0;
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) {
+      digit |= 0x80;
+    }
+    out[n++] = digit;
+  } while (remaining > 0);
+  return n;
+}
+
+// Full size of a PUBLISH packet; QoS > 0 adds the two packet-id bytes.
+inline size_t publishSize(size_t topicLength, size_t payloadLength,
+                          uint8_t qos) {
+  size_t remaining = 2 + topicLength + (qos ? 2 : 0) + payloadLength;
+  return 1 + lengthFieldSize(remaining) + remaining;
+}
+
+// Encodes a PUBLISH into `out`. Returns the packet size, or 0 if it does not
+// fit in `capacity` (or exceeds the protocol's 256 MB limit).
+inline size_t encodePublish(uint8_t* out, size_t capacity, const char* topic,
+                            const uint8_t* payload, size_t length, uint8_t qos,
+                            uint16_t packetId, bool retain = false) {
+  size_t topicLength = strlen(topic);
+  size_t remaining = 2 + topicLength + (qos ? 2 : 0) + length;
+  if (topicLength > 0xFFFF || remaining > 268435455 ||
+      publishSize(topicLength, length, qos) > capacity) {
+    return 0;
+  }
+  size_t n = 0;
+  out[n++] = (uint8_t)((PUBLISH << 4) | ((qos & 0x03) << 1) | (retain ? 1 : 0));
+  n += encodeLength(out + n, remaining);
+  out[n++] = (uint8_t)(topicLength >> 8);
+  out[n++] = (uint8_t)(topicLength & 0xFF);
+  memcpy(out + n, topic, topicLength);
+  n += topicLength;
+  if (qos) {
+    out[n++] = (uint8_t)(packetId >> 8);
+    out[n++] = (uint8_t)(packetId & 0xFF);
+  }
+  if (length) {
+    memcpy(out + n, payload, length);
+  }
+  return n + length;
+}
+
+// Bytes one filter adds to a SUBSCRIBE payload: length, text, requested QoS.
+inline size_t subscribeEntrySize(size_t filterLength) {
+  return 2 + filterLength + 1;
+}
+
+inline size_t encodeSubscribeEntry(uint8_t* out, const char* filter,
+                                   size_t filterLength, uint8_t qos) {
+  out[0] = (uint8_t)(filterLength >> 8);
+  out[1] = (uint8_t)(filterLength & 0xFF);
+  memcpy(out + 2, filter, filterLength);
+  out[2 + filterLength] = qos & 0x03;
+  return subscribeEntrySize(filterLength);
+}
+
+// Writes the fixed header of a SUBSCRIBE whose variable header and payload
+// (`remaining` bytes) start at `body`, immediately before it, leaving room
+// for at most kMaxFixedHeader bytes. Returns where the packet starts.
+inline uint8_t* prefixSubscribeHeader(uint8_t* body, size_t remaining) {
+  uint8_t* start = body - 1 - lengthFieldSize(remaining);
+  start[0] = (uint8_t)((SUBSCRIBE << 4) | 0x02);  // reserved bits 0010
+  encodeLength(start + 1, remaining);
+  return start;
+}
+
+// Incremental parser over the inbound byte stream. It never buffers bodies:
+// only the first kHeadBytes of each packet's variable header are kept, which
+// is enough for packet ids, CONNACK flags and the return codes of a SUBACK for
+// up to kHeadBytes - 2 filters.
+class PacketSniffer {
+ public:
+  static constexpr size_t kHeadBytes = 16;
+  // (type, flags, head, headLength, remainingLength)
+  typedef std::function<void(uint8_t, uint8_t, const uint8_t*, size_t, size_t)>
+      Handler;
+
+  void onPacket(Handler handler) { handler_ = handler; }
+
+  // Call whenever the stream restarts (new connection).
+  void reset() { state_ = State::TYPE; }
+
+  void feed(const uint8_t* bytes, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      feed(bytes[i]);
+    }
+  }
+
+  void feed(uint8_t b) {
+    switch (state_) {
+      case State::TYPE:
+        type_ = b >> 4;
+        flags_ = b & 0x0F;
+        remaining_ = 0;
+        multiplier_ = 1;
+        state_ = State::LENGTH;
+        break;
+      case State::LENGTH:
+        remaining_ += (size_t)(b & 0x7F) * multiplier_;
+        multiplier_ *= 128;
+        if (b & 0x80) {
+          if (multiplier_ >= 128UL * 128 * 128 * 128) {
+            state_ = State::TYPE;  // malformed; resync on the next byte
+          }
+          break;
+        }
+        got_ = 0;
+        if (remaining_ == 0) {
+          emit();
+        } else {
+          state_ = State::BODY;
+        }
+        break;
+      case State::BODY:
+        if (got_ < kHeadBytes) {
+          head_[got_] = b;
+        }
+        if (++got_ == remaining_) {
+          emit();
+        }
+        break;
+    }
+  }
+
+ private:
+  enum class State : uint8_t { TYPE, LENGTH, BODY };
+
+  void emit() {
+    state_ = State::TYPE;
+    if (handler_) {
+      handler_(type_, flags_, head_, got_ < kHeadBytes ? got_ : kHeadBytes,
+               remaining_);
+    }
+  }
+
+  State state_ = State::TYPE;
+  uint8_t type_ = 0;
+  uint8_t flags_ = 0;
+  size_t remaining_ = 0;
+  size_t multiplier_ = 1;
+  size_t got_ = 0;
+  uint8_t head_[kHeadBytes] = {};
+  Handler handler_;
+};
+
+}  // namespace mqtt
+}  // namespace hyphen
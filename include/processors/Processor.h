@@ -16,7 +16,14 @@ public:
     virtual bool maintain() = 0;
     virtual bool publish(const char *topic, const char *payload) = 0;
     virtual bool publish(const char *topic, uint8_t *buf, size_t) = 0;
+    // Streaming publish: declare the payload length, write it in any number of
+    // pieces, then endPublish(). Nothing is buffered, so RAM use is independent
+    // of the payload size.
+    virtual bool beginPublish(const char *topic, size_t length) = 0;
+    virtual size_t write(const uint8_t *buf, size_t length) = 0;
+    virtual bool endPublish() = 0;
     virtual bool subscribe(const char *topic, std::function<void(const char *, const char *)> callback) = 0;
+    virtual bool subscribe(const char *topic, std::function<void(const char *, const uint8_t *, size_t)> callback) = 0;
     virtual bool unsubscribe(const char *topic) = 0;
 };
 
@@ -6,10 +6,17 @@
 #include "managers/HealthCheck.h"
 #include "Managers.h"
 #include "Processor.h"
+#include "processors/MqttClientTap.h"
+#include "processors/InflightWindow.h"
+#include "processors/SubscribeBatch.h"
+#include "managers/InboundQueue.h"
 #include <freertos/semphr.h>
 // #define free esp_mbedtls_mem_free
 
 #include "mbedtls/platform.h"
+#include "mbedtls/version.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
 
 #include <ArduinoJson.h>
 
@@ -43,7 +50,59 @@ extern const uint8_t _binary_src_certs_private_key_pem_end[] asm("_binary_src_ce
 #endif
 
 #ifndef QOS_MQTT
-#define QOS_MQTT 0
+#define QOS_MQTT 0 // default publish QoS (0 or 1), changeable with setPublishQos()
+#endif
+
+#ifndef MQTT_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW 4 // QoS 1 publishes that may await a PUBACK at once
+#endif
+
+#ifndef MQTT_INFLIGHT_BYTES
+#define MQTT_INFLIGHT_BYTES 4096 // arena holding the encoded in-flight packets
+#endif
+
+#ifndef MQTT_RETRANSMIT_MS
+#define MQTT_RETRANSMIT_MS 10000 // an unacknowledged QoS 1 publish is resent with DUP after this
+#endif
+
+#ifndef MQTT_MAX_RETRANSMITS
+#define MQTT_MAX_RETRANSMITS 3 // resends before an in-flight publish is given up
+#endif
+
+#ifndef MQTT_SUBSCRIBE_BATCH_BYTES
+#define MQTT_SUBSCRIBE_BATCH_BYTES 512 // largest SUBSCRIBE packet written when resubscribing after a connect
+#endif
+
+#ifndef MQTT_SUBSCRIBE_BATCH_FILTERS
+#define MQTT_SUBSCRIBE_BATCH_FILTERS 8 // filters per SUBSCRIBE packet (AWS IoT Core accepts at most 8)
+#endif
+
+#ifndef MQTT_SUBSCRIBE_BATCH_PACKETS
+#define MQTT_SUBSCRIBE_BATCH_PACKETS 8 // SUBSCRIBE packets awaiting their SUBACK at once; further filters go singly
+#endif
+
+#ifndef MQTT_SKIP_RESUBSCRIBE
+#define MQTT_SKIP_RESUBSCRIBE 1 // skip resubscribing when the broker kept the session and the subscriptions are unchanged
+#endif
+
+#ifndef MQTT_VALIDATE_CERTIFICATES
+#define MQTT_VALIDATE_CERTIFICATES 1 // check the credentials parse at load so a bad PEM fails early
+#endif
+
+#ifndef INBOUND_WORKER
+#define INBOUND_WORKER 0 // set to 1 to run subscription callbacks on their own task instead of inside the MQTT receive loop
+#endif
+
+#ifndef INBOUND_TASK_CORE
+#define INBOUND_TASK_CORE 1 // core the inbound dispatch task is pinned to
+#endif
+
+#ifndef INBOUND_TASK_PRIORITY
+#define INBOUND_TASK_PRIORITY (tskIDLE_PRIORITY + 1) // priority of the inbound dispatch task
+#endif
+
+#ifndef INBOUND_TASK_STACK
+#define INBOUND_TASK_STACK 6144 // stack of the inbound dispatch task, which runs every subscription callback
 #endif
 
 #define CERT_LENGTH 3 // should not be changed
@@ -57,12 +116,25 @@ public:
     bool isConnected();
     bool publish(const char *, const char *);
     bool publish(const char *topic, uint8_t *, size_t);
+    bool beginPublish(const char *topic, size_t length);
+    size_t write(const uint8_t *buf, size_t length);
+    bool endPublish();
     bool subscribe(const char *, std::function<void(const char *, const char *)>);
+    bool subscribe(const char *, std::function<void(const char *, const uint8_t *, size_t)>);
     bool unsubscribe(const char *);
     bool init();
     bool maintain();
     void loop();
     bool ready();
+    void setPublishQos(uint8_t qos);
+    uint8_t getPublishQos() { return publishQos; }
+    InflightStats getInflightStats();
+    TlsStats getTlsStats() { return tlsStats; }
+    SubscribeStats getSubscribeStats();
+    // Received messages wait in a bounded queue for the dispatch task; the
+    // policy of the longest matching prefix decides what a full queue does.
+    bool setInboundPolicy(const char *prefix, InboundPolicy policy) { return inbound.setPolicy(prefix, policy); }
+    InboundStats getInboundStats() { return inbound.getStats(); }
 
 private:
     volatile bool processing = false;
@@ -88,7 +160,7 @@ private:
     // String certificates[CERT_LENGTH];
     const char *certificates[CERT_LENGTH];  // pointers to PEM data
     size_t certificateLengths[CERT_LENGTH]; // lengths of each PEM
-    String certStorage[CERT_LENGTH];        // owns file-loaded PEM data so certificates[] never dangles
+    std::unique_ptr<char[]> certStorage[CERT_LENGTH]; // owns file-loaded PEM data so certificates[] never dangles
     bool certsCached = false;
     enum cachedCertificates
     {
@@ -112,6 +184,27 @@ private:
     const uint8_t MAX_CONNECTION_ATTEMPTS = 5;
     Connection &connection;
     PubSubClient mqttClient;
+    MqttClientTap tap;
+    uint8_t publishQos = QOS_MQTT > 0 ? 1 : 0;
+    InflightWindow<MQTT_INFLIGHT_BYTES, MQTT_INFLIGHT_WINDOW> inflight;
+    bool publishAcknowledged(const char *topic, const uint8_t *buf, size_t length);
+    void onControlPacket(uint8_t type, const uint8_t *head, size_t headLength);
+    void serviceInflight();
+    typedef SubscribeBatch<MQTT_SUBSCRIBE_BATCH_BYTES, MQTT_SUBSCRIBE_BATCH_FILTERS, MQTT_SUBSCRIBE_BATCH_PACKETS> Resubscribe;
+    Resubscribe resubscribe;
+    bool sessionPresent = false;                  // from the last CONNACK
+    SubscriptionFingerprint brokerSubscriptions;  // the set the broker last granted in full
+    bool brokerSubscriptionsKnown = false;
+    bool sessionHoldsSubscriptions();
+    bool streaming = false;
+    size_t streamRemaining = 0;
+#ifdef HYPHEN_TLS_RESUMPTION
+    TlsSessionStore tlsSessions;
+#endif
+    TlsStats tlsStats;
+    bool sessionOffered = false;
+    void offerTlsSession();
+    void recordHandshake(bool connected);
 #ifndef INSECURE_MQTT
     SecureClient *secureClient = nullptr;
 #else
@@ -121,8 +214,14 @@ private:
     bool cleanupDisconnect();
     void restartSSL();
     void mqttCallback(char *topic, byte *payload, unsigned int length);
+    InboundQueue inbound;
+    TaskHandle_t inboundHandle = nullptr;
+    void startInboundWorker();
+    static void runInbound(void *param);
     bool setupSecureConnection();
     bool loadCertificates();
+    bool loadCertificate(uint8_t index, const char *literal, const char *fileName);
+    bool validateCertificates();
     bool connectServer();
     int hasSubscription();
     void subscribeToTopics();
@@ -0,0 +1,212 @@
+// SubscribeBatch.h — resubscribing every registered filter in few packets.
+//
+// After a reconnect the filters are packed into multi-filter SUBSCRIBE packets
+// of at most Filters filters and Bytes bytes each. A packet is written as soon
+// as it is full, without waiting for the SUBACK of the one before, so the
+// whole set is on the wire after one pass. SUBACKs are matched to their
+// packet ids as the sniffer sees them; the batch is ready once every packet
+// has been acknowledged, which takes about one round trip however many
+// filters there are.
+//
+// Each batch also fingerprints the filters it carried. Once every one of them
+// is granted, the broker is known to hold exactly that set, so a reconnect
+// into a persistent session (CONNACK session-present) with an unchanged set
+// can skip the resubscription altogether.
+//
+// Not synchronized: the processor serializes access with its own lock.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+
+#include "processors/MqttPacket.h"
+
+struct SubscribeStats {
+  uint32_t batches = 0;  // resubscriptions started
+  uint32_t packets = 0;  // SUBSCRIBE packets written
+  uint32_t filters = 0;  // filters carried in them
+  uint32_t granted = 0;
+  uint32_t refused = 0;  // SUBACK return code 0x80
+  uint32_t single = 0;   // did not fit a batch, left to a single SUBSCRIBE
+  uint32_t skipped = 0;  // connects where the broker's session still held the set
+  unsigned long lastReadyMs = 0;  // first SUBSCRIBE -> last SUBACK
+  unsigned long maxReadyMs = 0;
+};
+
+// Identifies a set of filters whatever their order: the XOR of each filter's
+// FNV-1a hash, plus the count.
+struct SubscriptionFingerprint {
+  uint32_t hash = 0;
+  uint32_t count = 0;
+
+  void add(const char* filter) {
+    uint32_t h = 2166136261u;
+    for (const char* c = filter; *c; c++) {
+      h = (h ^ (uint8_t)*c) * 16777619u;
+    }
+    hash ^= h;
+    count++;
+  }
+
+  bool operator==(const SubscriptionFingerprint& other) const {
+    return hash == other.hash && count == other.count;
+  }
+  bool operator!=(const SubscriptionFingerprint& other) const { return !(*this == other); }
+};
+
+template <size_t Bytes, size_t Filters, size_t Packets>
+class SubscribeBatch {
+ public:
+  static_assert(Filters >= 1 && Filters <= hyphen::mqtt::PacketSniffer::kHeadBytes - 2,
+                "every SUBACK return code must fit in the sniffed head");
+  static_assert(Bytes > hyphen::mqtt::kMaxFixedHeader + 2, "no room for a filter");
+  static_assert(Packets >= 1, "at least one packet per batch");
+
+  // Ids from a range of their own: PubSubClient numbers its packets upward
+  // from 1 and the in-flight window uses the upper half.
+  static constexpr uint16_t kFirstPacketId = 0x4000;
+  static constexpr uint16_t kPacketIds = 0x1000;
+
+  typedef std::function<bool(const uint8_t*, size_t)> Writer;
+
+  enum class Result : uint8_t {
+    QUEUED,       // in the packet being built, or written with it
+    SINGLE,       // too long for a packet or the batch is out of packets
+    WRITE_FAILED  // the connection dropped; stop
+  };
+
+  // Starts a resubscription at `now`. SUBACKs still owed by an earlier batch
+  // are forgotten; their connection is gone.
+  void begin(unsigned long now) {
+    startedAt_ = now;
+    sent_ = 0;
+    acked_ = 0;
+    count_ = 0;
+    used_ = 0;
+    fingerprint_ = SubscriptionFingerprint();
+    incomplete_ = false;
+    stats_.batches++;
+  }
+
+  // Adds `filter` to the packet being built, first writing that packet when
+  // the filter would not fit in it.
+  Result add(const char* filter, uint8_t qos, const Writer& write) {
+    size_t length = strlen(filter);
+    size_t entry = hyphen::mqtt::subscribeEntrySize(length);
+    fingerprint_.add(filter);
+    if (length > 0xFFFF || kBodyStart + 2 + entry > Bytes) {
+      return single();
+    }
+    if (count_ == Filters || (count_ > 0 && used_ + entry > Bytes)) {
+      if (!flush(write)) {
+        return Result::WRITE_FAILED;
+      }
+    }
+    if (count_ == 0) {
+      if (sent_ == Packets) {
+        return single();
+      }
+      used_ = kBodyStart + 2;  // packet id goes first
+    }
+    used_ += hyphen::mqtt::encodeSubscribeEntry(buffer_ + used_, filter, length, qos);
+    count_++;
+    return Result::QUEUED;
+  }
+
+  // Writes the packet being built, if any. false when the write failed, in
+  // which case its filters are dropped with it.
+  bool flush(const Writer& write) {
+    if (count_ == 0) {
+      return true;
+    }
+    uint16_t id = nextId();
+    uint8_t* body = buffer_ + kBodyStart;
+    body[0] = (uint8_t)(id >> 8);
+    body[1] = (uint8_t)(id & 0xFF);
+    uint8_t* start = hyphen::mqtt::prefixSubscribeHeader(body, used_ - kBodyStart);
+    size_t filters = count_;
+    count_ = 0;
+    if (!write(start, buffer_ + used_ - start)) {
+      incomplete_ = true;
+      return false;
+    }
+    ids_[sent_] = id;
+    done_[sent_] = false;
+    sent_++;
+    stats_.packets++;
+    stats_.filters += filters;
+    return true;
+  }
+
+  // SUBACK for `id` carrying `count` return codes. Returns false for ids not
+  // in this batch (another subscriber's, or a late duplicate).
+  bool ack(uint16_t id, const uint8_t* codes, size_t count, unsigned long now) {
+    for (size_t i = 0; i < sent_; i++) {
+      if (ids_[i] != id || done_[i]) {
+        continue;
+      }
+      done_[i] = true;
+      acked_++;
+      for (size_t c = 0; c < count; c++) {
+        if (codes[c] == hyphen::mqtt::kSubscribeFailure) {
+          stats_.refused++;
+          incomplete_ = true;
+        } else {
+          stats_.granted++;
+        }
+      }
+      if (ready()) {
+        stats_.lastReadyMs = now - startedAt_;
+        if (stats_.lastReadyMs > stats_.maxReadyMs) {
+          stats_.maxReadyMs = stats_.lastReadyMs;
+        }
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // every written packet has been acknowledged
+  bool ready() const { return count_ == 0 && acked_ == sent_; }
+  // ready, and every filter of the batch was granted in it
+  bool complete() const { return ready() && !incomplete_; }
+  // the filters passed to add() since begin()
+  const SubscriptionFingerprint& fingerprint() const { return fingerprint_; }
+  // counts a connect whose session already held the subscriptions
+  void skip() { stats_.skipped++; }
+  size_t pending() const { return sent_ - acked_; }
+  size_t packets() const { return sent_; }
+  const SubscribeStats& stats() const { return stats_; }
+
+ private:
+  // The fixed header is prefixed once the packet's length is known.
+  static constexpr size_t kBodyStart = hyphen::mqtt::kMaxFixedHeader;
+
+  Result single() {
+    stats_.single++;
+    incomplete_ = true;  // its SUBACK is not tracked here
+    return Result::SINGLE;
+  }
+
+  uint16_t nextId() {
+    uint16_t id = kFirstPacketId + next_;
+    next_ = (uint16_t)((next_ + 1) % kPacketIds);
+    return id;
+  }
+
+  uint8_t buffer_[Bytes];
+  size_t used_ = 0;   // bytes of buffer_ in use, fixed header room included
+  size_t count_ = 0;  // filters in the packet being built
+  uint16_t ids_[Packets] = {};
+  bool done_[Packets] = {};
+  size_t sent_ = 0;
+  size_t acked_ = 0;
+  uint16_t next_ = 0;
+  unsigned long startedAt_ = 0;
+  SubscriptionFingerprint fingerprint_;
+  bool incomplete_ = false;  // a filter was refused, sent alone or lost
+  SubscribeStats stats_;
+};
@@ -1,4 +1,5 @@
 #include "HyphenConnect.h"
+#include <Preferences.h>
 
 #ifdef HYPHEN_THREADED
 #include "HyphenRunner.h"
@@ -76,6 +77,15 @@ bool HyphenConnect::setup(int logLevel)
     if (!initialSetup)
     {
         logger.start(logLevel);
+#ifdef HYPHEN_OUTBOX
+        outbox.begin();
+#endif
+        Preferences prefs;
+        if (prefs.begin(DATA_BUDGET_NAMESPACE, true))
+        {
+            manager.getGovernor().restoreBudget(prefs.getUInt("used", 0), prefs.getUInt("start", 0));
+            prefs.end();
+        }
         initialSetup = true;
     }
 
@@ -101,13 +111,16 @@ void HyphenConnect::loop()
     {
         return;
     }
+    // queued async publishes are governed from the loop below
+    manager.setMetered(connection.getClass() == ConnectionClass::CELLULAR);
+    syncBudget();
 #ifdef HYPHEN_THREADED
     runner.loop();
 #else
     // if our loop even returns true, we are done for this cycle
     if (manager.loop())
     {
-        return;
+        return drainOutbox();
     }
     // otherwise we attempt to restart the services
     disconnect();
@@ -122,13 +135,18 @@ bool HyphenConnect::subscribe(const char *topic,
     return manager.subscribe(topic, cb);
 }
 
+bool HyphenConnect::subscribe(const char *topic,
+                              std::function<void(const char *, const uint8_t *, size_t)> cb)
+{
+    return manager.subscribe(topic, cb);
+}
+
 bool HyphenConnect::unsubscribe(const char *topic)
 {
     return manager.unsubscribe(topic);
 }
 
-bool HyphenConnect::publishTopic(const String &topic,
-                                 const String &payload)
+bool HyphenConnect::publishReady()
 {
 #ifdef HYPHEN_THREADED
     if (!runner.ready())
@@ -136,26 +154,172 @@ bool HyphenConnect::publishTopic(const String &topic,
         return false;
     }
 #endif
-    if (!connectedOn)
+    return connectedOn;
+}
+
+/**
+ * @brief a publish could not be sent now. With HYPHEN_OUTBOX it is kept on
+ * flash and replayed once the session is back; otherwise it is lost.
+ *
+ * @return true - the message was accepted for later delivery
+ */
+bool HyphenConnect::deferPublish(const char *topic, const uint8_t *buf, size_t length)
+{
+#ifdef HYPHEN_OUTBOX
+    return outbox.enqueue(topic, buf, length);
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief true while the outbox still holds undelivered publishes, which a
+ * new publish must not overtake
+ */
+bool HyphenConnect::backlogged()
+{
+#ifdef HYPHEN_OUTBOX
+    return !outbox.empty();
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief replays the outbox at its bounded rate while the session is up
+ */
+void HyphenConnect::drainOutbox()
+{
+#ifdef HYPHEN_OUTBOX
+    if (outbox.empty() || !manager.isConnected())
     {
-        return false;
+        return;
     }
-    return manager.publishTopic(topic, payload);
+    outbox.drain([this](const char *topic, const uint8_t *buf, size_t length)
+                 { return manager.publishTopic(topic, (uint8_t *)buf, length); });
+#endif
+}
+
+/**
+ * @brief applies the rate and data-budget limits to an application publish.
+ * Limits only bite on cellular; anything other than SEND has been handled.
+ */
+GovernorVerdict HyphenConnect::govern(const char *topic, const uint8_t *buf, size_t length, bool canDefer)
+{
+    manager.setMetered(connection.getClass() == ConnectionClass::CELLULAR);
+    GovernorVerdict verdict = manager.govern(topic, buf, length, canDefer);
+    syncBudget();
+    return verdict;
+}
+
+/**
+ * @brief persists the budget usage every DATA_BUDGET_SYNC_BYTES so a reboot
+ * cannot hand the device a fresh allowance, without writing NVS per publish
+ */
+void HyphenConnect::syncBudget()
+{
+    uint32_t used, start;
+    if (!manager.getGovernor().takeBudgetSync(used, start))
+    {
+        return;
+    }
+    Preferences prefs;
+    if (prefs.begin(DATA_BUDGET_NAMESPACE, false))
+    {
+        prefs.putUInt("used", used);
+        prefs.putUInt("start", start);
+        prefs.end();
+    }
+}
+
+bool HyphenConnect::limitTopic(const char *prefix, float perSecond, uint16_t burst, ThrottlePolicy policy)
+{
+    return manager.limitTopic(prefix, perSecond, burst, policy);
+}
+
+void HyphenConnect::setDataBudget(uint32_t bytesPerPeriod, ThrottlePolicy policy)
+{
+    manager.setDataBudget(bytesPerPeriod, policy);
+}
+
+void HyphenConnect::resetDataBudget()
+{
+    manager.getGovernor().resetBudget(hyphen::wallclock::epochNow());
+    syncBudget();
+}
+
+bool HyphenConnect::publishTopic(const String &topic,
+                                 const String &payload)
+{
+    GovernorVerdict verdict = govern(topic.c_str(), (const uint8_t *)payload.c_str(), payload.length());
+    if (verdict != GovernorVerdict::SEND)
+    {
+        return verdict == GovernorVerdict::DEFERRED;
+    }
+    if (!backlogged() && publishReady())
+    {
+        bool sent = manager.isBatching() ? manager.publishBatched(topic.c_str(), payload.c_str())
+                                         : manager.publishTopic(topic, payload);
+        if (sent)
+        {
+            return true;
+        }
+    }
+    return deferPublish(topic.c_str(), (const uint8_t *)payload.c_str(), payload.length());
 }
 
 bool HyphenConnect::publishTopic(const char *topic, uint8_t *buf, size_t length)
 {
-#ifdef HYPHEN_THREADED
-    if (!runner.ready())
+    GovernorVerdict verdict = govern(topic, buf, length);
+    if (verdict != GovernorVerdict::SEND)
     {
-        return false;
+        return verdict == GovernorVerdict::DEFERRED;
     }
-#endif
-    if (!connectedOn)
+    // binary payloads are never batched: the envelope is JSON text
+    if (!backlogged() && publishReady() && manager.publishTopic(topic, buf, length))
     {
-        return false;
+        return true;
     }
-    return manager.publishTopic(topic, buf, length);
+    return deferPublish(topic, buf, length);
+}
+
+bool HyphenConnect::publishStream(const char *topic, Stream &source, size_t length)
+{
+    return publishReady() && govern(topic, nullptr, length, false) == GovernorVerdict::SEND &&
+           manager.publishStream(topic, source, length);
+}
+
+bool HyphenConnect::publishStream(const char *topic, size_t length, StreamReader reader)
+{
+    return publishReady() && govern(topic, nullptr, length, false) == GovernorVerdict::SEND &&
+           manager.publishStream(topic, length, reader);
+}
+
+bool HyphenConnect::publishAsync(const char *topic, const char *payload, PublishCallback onDone,
+                                 PublishPriority priority)
+{
+    return manager.publishAsync(topic, payload, onDone, priority);
+}
+
+bool HyphenConnect::publishAsync(const char *topic, const uint8_t *buf, size_t length, PublishCallback onDone,
+                                 PublishPriority priority)
+{
+    return manager.publishAsync(topic, buf, length, onDone, priority);
+}
+
+void HyphenConnect::enableBatching(size_t maxBytes, unsigned long windowMs, const char *batchTopic)
+{
+    manager.enableBatching(maxBytes, windowMs, batchTopic);
+}
+
+bool HyphenConnect::disableBatching()
+{
+    return manager.disableBatching();
+}
+
+bool HyphenConnect::flush()
+{
+    return manager.flush();
 }
 
 void HyphenConnect::function(const char *name,
@@ -169,11 +333,6 @@ bool HyphenConnect::ready()
     return processor.ready() && manager.ready();
 }
 
-void HyphenConnect::variable(const char *name, int *v) { manager.variable(name, v); }
-void HyphenConnect::variable(const char *name, long *v) { manager.variable(name, v); }
-void HyphenConnect::variable(const char *name, String *v) { manager.variable(name, v); }
-void HyphenConnect::variable(const char *name, double *v) { manager.variable(name, v); }
-
 bool HyphenConnect::isConnected()
 {
     return manager.isConnected();
@@ -93,14 +93,69 @@ public:
     bool ready();
     // These just forward directly to manager
     bool subscribe(const char *topic, std::function<void(const char *, const char *)> cb);
+    // Binary-safe: payload is neither copied nor NUL-terminated, valid only during the call.
+    bool subscribe(const char *topic, std::function<void(const char *, const uint8_t *, size_t)> cb);
     bool unsubscribe(const char *topic);
     bool publishTopic(const String &topic, const String &payload);
     bool publishTopic(const char *, uint8_t *, size_t);
+    bool publishStream(const char *topic, Stream &source, size_t length);
+    bool publishStream(const char *topic, size_t length, StreamReader reader);
+    // Queued publishes drain by priority: CONTROL, ALARM, TELEMETRY, then BULK.
+    bool publishAsync(const char *topic, const char *payload, PublishCallback onDone = nullptr,
+                      PublishPriority priority = PublishPriority::TELEMETRY);
+    bool publishAsync(const char *topic, const uint8_t *buf, size_t length, PublishCallback onDone = nullptr,
+                      PublishPriority priority = PublishPriority::TELEMETRY);
+    PublishQueueStats getPublishQueueStats() { return manager.getPublishQueueStats(); }
+    // Once enabled, publishTopic() coalesces messages into batched envelopes.
+    void enableBatching(size_t maxBytes = PUBLISH_BATCH_MAX_BYTES,
+                        unsigned long windowMs = PUBLISH_BATCH_WINDOW_MS,
+                        const char *batchTopic = nullptr);
+    bool disableBatching();
+    bool flush();
+    // Rate limits per topic prefix and a data budget per period; both apply on
+    // cellular only. The budget's usage is kept in NVS across reboots.
+    bool limitTopic(const char *prefix, float perSecond, uint16_t burst,
+                    ThrottlePolicy policy = ThrottlePolicy::DEFER);
+    void setDataBudget(uint32_t bytesPerPeriod, ThrottlePolicy policy = ThrottlePolicy::REJECT);
+    void resetDataBudget();
+    uint32_t getRemainingBudget() { return manager.getGovernorStats().budgetRemaining(); }
+    GovernorStats getGovernorStats() { return manager.getGovernorStats(); }
+    // Short aliases for long topic prefixes; listed in the registration
+    // manifest and used for publishes once it has been sent.
+    bool topicAlias(const char *prefix, const char *alias) { return manager.topicAlias(prefix, alias); }
+    TopicAliasStats getTopicAliasStats() { return manager.getTopicAliasStats(); }
+    // LZ4-compresses payloads of at least `threshold` bytes into a one-byte envelope.
+    bool enableCompression(size_t threshold = PAYLOAD_COMPRESS_MIN_BYTES) { return manager.enableCompression(threshold); }
+    void disableCompression() { manager.disableCompression(); }
+    CompressionStats getCompressionStats() { return manager.getCompressionStats(); }
+    // QoS 1 publishes are tracked until their PUBACK and resent with DUP on timeout.
+    void setPublishQos(uint8_t qos) { processor.setPublishQos(qos); }
+    InflightStats getInflightStats() { return processor.getInflightStats(); }
+    // Transport handshake timings and how many were resumed sessions.
+    TlsStats getTlsStats() { return processor.getTlsStats(); }
+    // Resubscription after a connect: packets, refused filters, time until every SUBACK arrived.
+    SubscribeStats getSubscribeStats() { return processor.getSubscribeStats(); }
+    // Subscription pool usage against REGISTRY_MAX_FILTERS / _CALLBACKS / _NODES.
+    RegistryStats getRegistryStats() { return CommunicationRegistry::getInstance().getStats(); }
+    // Subscription callbacks run on their own task, fed by a bounded queue; the
+    // policy of the longest matching topic prefix decides what a full queue does.
+    bool setInboundPolicy(const char *prefix, InboundPolicy policy) { return processor.setInboundPolicy(prefix, policy); }
+    InboundStats getInboundStats() { return processor.getInboundStats(); }
+#ifdef HYPHEN_OUTBOX
+    Outbox &getOutbox() { return outbox; }
+#endif
     void function(const char *name, std::function<int(const char *)> fn);
-    void variable(const char *name, int *v);
-    void variable(const char *name, long *v);
-    void variable(const char *name, String *v);
-    void variable(const char *name, double *v);
+    // Redelivered calls (same function and call id) are answered from cache, not run again.
+    CallCacheStats getCallCacheStats() { return manager.getCallCacheStats(); }
+    // A variable the cloud can read: a pointer to a bool, integer, float,
+    // double or String, a char array, or a getter that computes the value.
+    // False once VARIABLE_COUNT_MAX variables are registered.
+    template <typename T>
+    bool variable(const char *name, T &&v) { return manager.variable(name, std::forward<T>(v)); }
+    // Push a variable when it moves past a deadband instead of waiting to be polled.
+    bool report(const char *name, const ReportPolicy &policy = ReportPolicy()) { return manager.report(name, policy); }
+    bool stopReporting(const char *name) { return manager.stopReporting(name); }
+    ReportStats getReportStats() { return manager.getReportStats(); }
     bool isConnected();
     void disconnect();
     bool connectionOn();
@@ -130,6 +185,15 @@ private:
     SecureMQTTProcessor processor;
     SubscriptionManager manager;
     LoggingManager logger;
+#ifdef HYPHEN_OUTBOX
+    Outbox outbox;
+#endif
+    bool publishReady();
+    bool deferPublish(const char *topic, const uint8_t *buf, size_t length);
+    bool backlogged();
+    GovernorVerdict govern(const char *topic, const uint8_t *buf, size_t length, bool canDefer = true);
+    void syncBudget();
+    void drainOutbox();
     bool connectedOn = false;
     bool initialSetup = false;
     bool pauseProcessor = false;
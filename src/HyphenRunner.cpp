@@ -55,7 +55,7 @@ void HyphenRunner::processorLoops()
     }
     if (hyphen->manager.loop())
     {
-        return;
+        return hyphen->drainOutbox();
     }
     Log.infoln(F("[Runner] processorLoops detected connection issue, rebuilding..."));
     rebuildConnection();
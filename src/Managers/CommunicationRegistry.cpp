@@ -1,198 +1,277 @@
 #include "managers/CommunicationRegistry.h"
+#include <algorithm>
 
-CommunicationRegistry::CommunicationRegistry()
+CommunicationRegistry::CommunicationRegistry() : writeMutex(xSemaphoreCreateMutex())
 {
 }
 
-const std::array<std::string, CommunicationRegistry::CALLBACK_SIZE> &CommunicationRegistry::getCallbacks()
+/**
+ * @brief position of exactly this filter in the snapshot, or -1
+ */
+int CommunicationRegistry::find(const Table &current, const std::string &filter)
 {
-    return callbacks;
-}
-
-void CommunicationRegistry::iterateCallbacks(std::function<void(const char *)> callback)
-{
-    for (size_t i = 0; i < callbackCount; i++)
+    for (size_t i = 0; i < current.count; i++)
     {
-        const char *topic = callbacks[i].c_str();
-        if (!topic)
+        if (filters[current.order[i]].is(filter.c_str()))
         {
-            continue;
+            return i;
         }
-        callback(topic);
     }
+    return -1;
 }
 
-u_int8_t CommunicationRegistry::hasWildCard(String topic)
+/**
+ * @brief serial of the oldest snapshot still current or held by a reader
+ */
+uint32_t CommunicationRegistry::oldestHeld()
 {
-    bool wild = topic.indexOf("#") != -1 || topic.indexOf("+") != -1;
-    if (!wild)
-    {
-        return 0;
-    }
-    if (topic.indexOf("+") != -1)
-    {
-        return 1;
-    }
-    return 2;
+    uint32_t oldest = UINT32_MAX;
+    table.eachHeld([&](const Table &held)
+                   {
+        if (held.serial < oldest)
+        {
+            oldest = held.serial;
+        } });
+    return oldest;
 }
 
-String CommunicationRegistry::callbackName(String cbName)
+int CommunicationRegistry::allocateFilter(uint32_t oldest)
 {
-    bool isWild = hasWildCard(cbName);
-    if (isWild == 0)
+    for (size_t i = 0; i < REGISTRY_MAX_FILTERS; i++)
     {
-        return cbName;
+        if (!filterSlots[i].live && filterSlots[i].retiredAt <= oldest)
+        {
+            return i;
+        }
     }
-
-    int lastSlash = cbName.lastIndexOf("/");
-    return cbName.substring(0, lastSlash);
+    return -1;
 }
 
-bool CommunicationRegistry::matchCallback(String callback, String topic)
+int CommunicationRegistry::allocateCallback(uint32_t oldest)
 {
-    if (callback == topic)
+    for (size_t i = 0; i < REGISTRY_MAX_CALLBACKS; i++)
     {
-        return true;
+        if (!callbacks[i].live && callbacks[i].retiredAt <= oldest)
+        {
+            return i;
+        }
     }
+    return -1;
+}
 
-    if (hasWildCard(callback) == 0)
+std::vector<std::string> CommunicationRegistry::getCallbacks()
+{
+    Snapshot<Table, REGISTRY_READER_SLOTS>::Reader current(table);
+    std::vector<std::string> registered;
+    for (size_t i = 0; i < current->count; i++)
     {
-        return false;
+        registered.push_back(filters[current->order[i]].c_str());
     }
-
-    String cbName = callbackName(callback);
-    return topic.startsWith(cbName);
+    return registered;
 }
 
-int CommunicationRegistry::callbackIndex(const std::string &topic)
+void CommunicationRegistry::iterateCallbacks(std::function<void(const char *)> callback)
 {
-    int index = -1;
-    for (size_t i = 0; i < callbackCount; i++)
+    Snapshot<Table, REGISTRY_READER_SLOTS>::Reader current(table);
+    for (size_t i = 0; i < current->count; i++)
     {
-        if (matchCallback(String(callbacks[i].c_str()), String(topic.c_str())))
-        {
-            index = i;
-            break;
-        }
+        callback(filters[current->order[i]].c_str());
     }
-    return index;
 }
+
 bool CommunicationRegistry::hasCallback(const std::string &topic)
 {
-    int index = callbackIndex(topic);
-    return index != -1;
+    Snapshot<Table, REGISTRY_READER_SLOTS>::Reader current(table);
+    return index.match(filters, topic.c_str(), [](uint16_t) {}) > 0;
+}
+
+bool CommunicationRegistry::hasFilter(const std::string &filter)
+{
+    Snapshot<Table, REGISTRY_READER_SLOTS>::Reader current(table);
+    return find(*current, filter) != -1;
 }
 
 size_t CommunicationRegistry::getCallbackCount()
 {
-    return callbackCount;
+    Snapshot<Table, REGISTRY_READER_SLOTS>::Reader current(table);
+    return current->count;
 }
 
-CommunicationRegistry &CommunicationRegistry::getInstance()
+uint32_t CommunicationRegistry::getVersion()
 {
-    static CommunicationRegistry instance; // Guaranteed to be lazy-initialized and destroyed correctly
-    return instance;
+    Lock lock(writeMutex);
+    return table.version();
 }
 
-void CommunicationRegistry::addCallback(const std::string &topic)
+size_t CommunicationRegistry::getPendingReclaim()
 {
-    if (hasCallback(topic))
-    {
-        return;
-    }
+    Lock lock(writeMutex);
+    return table.pending();
+}
 
-    callbacks[callbackCount] = topic;
-    callbackCount++;
+RegistryStats CommunicationRegistry::getStats()
+{
+    Lock lock(writeMutex);
+    return stats;
+}
+
+CommunicationRegistry &CommunicationRegistry::getInstance()
+{
+    static CommunicationRegistry instance; // Guaranteed to be lazy-initialized and destroyed correctly
+    return instance;
 }
 
 bool CommunicationRegistry::registerCallback(const std::string &topic, std::function<void(const char *, const char *)> callback)
 {
-    addCallback(topic);
-    auto &callbacksArray = topicCallbacks[topic]; // Get or create the array for this topic
-    // Find the first empty slot in the array
-    for (auto &cb : callbacksArray)
-    {
-        if (!cb)
-        { // If this slot is empty
-            cb = callback;
-            return true;
+    return registerCallback(topic, [callback](const char *name, const uint8_t *payload, size_t length)
+                            {
+        // Legacy text callbacks need a terminated string. Small payloads are
+        // copied to the stack; only large ones pay for a heap copy.
+        if (length < TEXT_CALLBACK_STACK_BYTES)
+        {
+            char text[TEXT_CALLBACK_STACK_BYTES];
+            memcpy(text, payload, length);
+            text[length] = '\0';
+            return callback(name, text);
         }
-    }
-
-    Log.notice(F("No space to register more callbacks for topic: %s" CR), topic.c_str());
-    return false; // No empty slots available
+        std::string text((const char *)payload, length);
+        callback(name, text.c_str()); });
 }
 
-bool CommunicationRegistry::unregisterCallback(const std::string &topic)
+bool CommunicationRegistry::registerCallback(const std::string &topic, Callback callback)
 {
-    // 1) Find the topic in our flat callbacks[] list
-    // if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE)
-    // {
-    //     return false;
-    // }
-    int idx = callbackIndex(topic);
-    Serial.printf("Unregistering callback for topic: %s, index: %d\n", topic.c_str(), idx);
-    if (idx < 0 || static_cast<size_t>(idx) >= callbackCount)
+    Lock lock(writeMutex);
+    const Table &latest = table.latest();
+    uint32_t oldest = oldestHeld();
+    int position = find(latest, topic);
+    int added = allocateCallback(oldest);
+    if (added == -1)
     {
-        // xSemaphoreGive(_mutex);
-        // nothing to remove
+        stats.rejected++;
+        Log.notice(F("No space to register more callbacks for topic: %s" CR), topic.c_str());
         return false;
     }
 
-    // 2) Erase from the map of topic → callback‐array
-    size_t erased = topicCallbacks.erase(topic);
-    if (erased == 0)
+    int slot = position == -1 ? -1 : latest.order[position];
+    if (slot == -1)
     {
-        // map didn’t contain it
-        return false;
+        if (latest.count >= REGISTRY_MAX_FILTERS || (slot = allocateFilter(oldest)) == -1)
+        {
+            stats.rejected++;
+            Log.notice(F("No space to register more topics: %s" CR), topic.c_str());
+            return false;
+        }
+        if (!filters[slot].compile(topic.c_str()))
+        {
+            stats.rejected++;
+            Log.notice(F("Invalid or too deep topic filter: %s" CR), topic.c_str());
+            return false;
+        }
     }
 
-    size_t i = idx;
-    // 3) Shift all later entries in the callbacks[] array left by one
-    for (; i + 1 < callbackCount; i++)
+    CallbackSlot &entry = callbacks[added];
+    entry.callback = callback;
+    entry.next.store(NONE);
+    entry.live = true;
+    FilterSlot &owner = filterSlots[slot];
+    if (position != -1)
     {
-        if (callbacks[i + 1].empty())
+        // appended in place: a dispatch already running may or may not see it
+        callbacks[owner.tail].next.store(added);
+        owner.tail = added;
+    }
+    else
+    {
+        // the callbacks are in place before a dispatch can find the filter
+        owner.head.store(added);
+        owner.tail = added;
+        if (!index.insert(filters, slot, oldest))
         {
-            // no more entries to shift
-            break;
+            entry.live = false;
+            entry.callback = nullptr;
+            owner.head.store(NONE);
+            stats.rejected++;
+            Log.notice(F("No space in the topic index for: %s" CR), topic.c_str());
+            return false;
         }
-        callbacks[i] = std::move(callbacks[i + 1]);
+        owner.live = true;
+        Table *next = table.acquire();
+        *next = latest;
+        next->serial = latest.serial + 1;
+        next->order[next->count++] = slot;
+        table.publish(next);
+        stats.filters = next->count;
+        stats.nodes = index.nodes();
+        stats.filtersHighWater = std::max(stats.filtersHighWater, stats.filters);
+        stats.nodesHighWater = std::max(stats.nodesHighWater, stats.nodes);
+    }
+    stats.callbacks++;
+    stats.callbacksHighWater = std::max(stats.callbacksHighWater, stats.callbacks);
+    return true;
+}
+
+bool CommunicationRegistry::unregisterCallback(const std::string &topic)
+{
+    Lock lock(writeMutex);
+    const Table &latest = table.latest();
+    int idx = find(latest, topic);
+    Log.verbose(F("Unregistering callback for topic: %s, index: %d" CR), topic.c_str(), idx);
+    if (idx < 0)
+    {
+        // nothing to remove
+        return false;
     }
 
-    if (i + 1 < callbackCount && !callbacks[i + 1].empty())
+    // Build the next version without the filter, keeping the others in order
+    uint16_t slot = latest.order[idx];
+    Table *next = table.acquire();
+    *next = latest;
+    next->serial = latest.serial + 1;
+    // a reader may still be walking the nodes this unlinks; they are reused
+    // only once every held snapshot is at least next->serial
+    index.erase(filters, slot, next->serial);
+    for (size_t i = idx; i + 1 < next->count; i++)
     {
-        callbacks[i + 1].clear();
+        next->order[i] = next->order[i + 1];
     }
+    next->count--;
+    table.publish(next);
 
-    --callbackCount;
-    // xSemaphoreGive(_mutex);
+    // Readers of older snapshots may still be walking these; they are only
+    // marked for reuse, never cleared here.
+    FilterSlot &owner = filterSlots[slot];
+    owner.live = false;
+    owner.retiredAt = next->serial;
+    for (uint16_t n = owner.head.load(); n != NONE; n = callbacks[n].next.load())
+    {
+        callbacks[n].live = false;
+        callbacks[n].retiredAt = next->serial;
+        stats.callbacks--;
+    }
+    stats.filters = next->count;
+    stats.nodes = index.nodes();
     return true;
 }
 
-// Triggers all registered callbacks for a specific topic
-void CommunicationRegistry::triggerCallbacks(const std::string &topic, const char *payload)
+void CommunicationRegistry::triggerCallbacks(const char *topic, const char *payload)
 {
-    int index = callbackIndex(topic);
-    if (index < 0 || static_cast<size_t>(index) >= callbackCount)
-    {
-        Log.notice(F("No callbacks match topic: %s" CR), topic.c_str());
-        return;
-    }
-    const std::string searchTopic = callbacks[index];
-    auto it = topicCallbacks.find(searchTopic);
-    // If there are registered callbacks for this topic, execute them
-    if (it != topicCallbacks.end())
-    {
-        for (const auto &cb : it->second)
+    triggerCallbacks(topic, (const uint8_t *)payload, strlen(payload));
+}
+
+// Triggers the callbacks of every registered filter matching the topic. The
+// snapshot keeps everything the dispatch can reach intact, even if a callback
+// (or another core) changes the registry meanwhile.
+void CommunicationRegistry::triggerCallbacks(const char *topic, const uint8_t *payload, size_t length)
+{
+    Snapshot<Table, REGISTRY_READER_SLOTS>::Reader current(table);
+    size_t matched = index.match(filters, topic, [&](uint16_t slot)
+                                 {
+        for (uint16_t n = filterSlots[slot].head.load(); n != NONE; n = callbacks[n].next.load())
         {
-            if (cb)
-            { // If callback is set
-                cb(topic.c_str(), payload);
-            }
-        }
-    }
-    else
+            callbacks[n].callback(topic, payload, length);
+        } });
+    if (matched == 0)
     {
-        Log.notice(F("No callbacks registered for topic: %s" CR), topic.c_str());
+        Log.notice(F("No callbacks match topic: %s" CR), topic);
     }
-}
\ No newline at end of file
+}
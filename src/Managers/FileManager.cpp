@@ -1,5 +1,7 @@
 #include "managers/FileManager.h"
 
+uint8_t FileManager::mounts = 0;
+
 FileManager::FileManager()
 {
 }
@@ -18,6 +20,38 @@ String FileManager::loadFileContents(const char *name)
     return contents;
 }
 
+/**
+ * @brief reads a whole file into one exact-size, NUL-terminated buffer. Unlike
+ * loadFileContents() it never grows a String a byte at a time, so there is a
+ * single allocation and no intermediate copy.
+ *
+ * @return size_t - the file length, 0 if it is missing, empty or unreadable
+ */
+size_t FileManager::loadFileBuffer(const char *name, std::unique_ptr<char[]> &out)
+{
+    out.reset();
+    File file = SPIFFS.open(name, "r");
+    if (!file)
+    {
+        Log.errorln("Failed to open file for reading");
+        return 0;
+    }
+    size_t length = file.size();
+    if (length > 0)
+    {
+        out.reset(new (std::nothrow) char[length + 1]);
+    }
+    if (!out || file.read((uint8_t *)out.get(), length) != length)
+    {
+        file.close();
+        out.reset();
+        return 0;
+    }
+    file.close();
+    out[length] = '\0';
+    return length;
+}
+
 String FileManager::fileContentsOpen(const char *name)
 {
     start();
@@ -38,15 +72,21 @@ bool FileManager::start()
         return true;
     }
 
-    if (!SPIFFS.begin(true))
+    if (mounts == 0 && !SPIFFS.begin(true))
     {
         Log.errorln("Failed to initialize SPIFFS");
         return false;
     }
+    mounts++;
     isRunning = true;
     return true;
 }
 
+fs::FS &FileManager::fs()
+{
+    return SPIFFS;
+}
+
 void FileManager::end()
 {
     if (!isRunning)
@@ -54,5 +94,8 @@ void FileManager::end()
         return;
     }
     isRunning = false;
-    SPIFFS.end();
+    if (mounts > 0 && --mounts == 0)
+    {
+        SPIFFS.end();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,521 @@
+#include "managers/Outbox.h"
+#include <memory>
+#include <new>
+
+Outbox::Outbox()
+{
+}
+
+void Outbox::segmentPath(uint32_t segment, char *path, size_t size)
+{
+    snprintf(path, size, OUTBOX_PATH_PREFIX "%08lx", (unsigned long)segment);
+}
+
+bool Outbox::readHeader(File &file, RecordHeader &header)
+{
+    if (file.read((uint8_t *)&header, sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+    return header.magic == RECORD_MAGIC;
+}
+
+/**
+ * @brief counts the intact records in a segment starting at an offset. A torn
+ * write (power lost mid-append) ends the count at the damaged record.
+ */
+uint32_t Outbox::countRecords(uint32_t segment, uint32_t from, uint32_t *firstStamp)
+{
+    char path[24];
+    segmentPath(segment, path, sizeof(path));
+    File file = fm.fs().open(path, FILE_READ);
+    if (!file)
+    {
+        return 0;
+    }
+    uint32_t count = 0;
+    uint32_t offset = from;
+    size_t size = file.size();
+    RecordHeader header;
+    while (offset < size && file.seek(offset) && readHeader(file, header))
+    {
+        uint32_t next = offset + sizeof(header) + header.topicLength + header.payloadLength;
+        if (next > size)
+        {
+            break;
+        }
+        if (count == 0 && firstStamp)
+        {
+            *firstStamp = header.stamp;
+        }
+        count++;
+        offset = next;
+    }
+    file.close();
+    return count;
+}
+
+void Outbox::loadCursor()
+{
+    File file = fm.fs().open(OUTBOX_CURSOR_PATH, FILE_READ);
+    if (!file)
+    {
+        return;
+    }
+    uint32_t cursor[2] = {0, 0};
+    bool ok = file.read((uint8_t *)cursor, sizeof(cursor)) == sizeof(cursor);
+    file.close();
+    if (!ok || cursor[0] < headSegment || cursor[0] > tailSegment)
+    {
+        return;
+    }
+    // segments before the cursor were drained but not yet deleted
+    while (headSegment < cursor[0])
+    {
+        char path[24];
+        segmentPath(headSegment, path, sizeof(path));
+        File old = fm.fs().open(path, FILE_READ);
+        if (old)
+        {
+            totalBytes -= old.size();
+            old.close();
+            fm.fs().remove(path);
+        }
+        headSegment++;
+    }
+    readOffset = cursor[1];
+}
+
+void Outbox::saveCursor()
+{
+    unsyncedDrains = 0;
+    File file = fm.fs().open(OUTBOX_CURSOR_PATH, FILE_WRITE);
+    if (!file)
+    {
+        Log.errorln("[outbox] failed to write cursor");
+        return;
+    }
+    uint32_t cursor[2] = {headSegment, readOffset};
+    file.write((const uint8_t *)cursor, sizeof(cursor));
+    file.close();
+}
+
+/**
+ * @brief mounts the filesystem and recovers any segments left by a previous
+ * boot, resuming from the persisted read cursor.
+ *
+ * @return true - the outbox is ready to accept records
+ */
+bool Outbox::begin()
+{
+    Lock lock;
+    if (started)
+    {
+        return true;
+    }
+    if (!fm.start())
+    {
+        Log.errorln("[outbox] filesystem unavailable");
+        return false;
+    }
+
+    bool found = false;
+    totalBytes = 0;
+    File root = fm.fs().open("/");
+    for (File file = root.openNextFile(); file; file = root.openNextFile())
+    {
+        const char *name = file.name();
+        if (name[0] == '/')
+        {
+            name++;
+        }
+        char *end = nullptr;
+        uint32_t segment = 0;
+        bool isSegment = strncmp(name, OUTBOX_PATH_PREFIX + 1, 3) == 0 && isxdigit((unsigned char)name[3]);
+        if (isSegment)
+        {
+            segment = strtoul(name + 3, &end, 16);
+            isSegment = end && *end == '\0';
+        }
+        if (isSegment)
+        {
+            totalBytes += file.size();
+            if (!found || segment < headSegment)
+            {
+                headSegment = segment;
+            }
+            if (!found || segment >= tailSegment)
+            {
+                tailSegment = segment;
+                tailSize = file.size();
+            }
+            found = true;
+        }
+        file.close();
+    }
+    root.close();
+
+    readOffset = 0;
+    depth = 0;
+    if (found)
+    {
+        loadCursor();
+        for (uint32_t segment = headSegment; segment <= tailSegment; segment++)
+        {
+            uint32_t stamp = 0;
+            depth += countRecords(segment, segment == headSegment ? readOffset : 0,
+                                  depth == 0 ? &oldestStamp : &stamp);
+        }
+        // never append after a torn record; start a fresh segment instead
+        tailSegment++;
+        tailSize = 0;
+        if (depth == 0)
+        {
+            // everything was delivered before the reboot; clear the leftovers
+            while (headSegment < tailSegment)
+            {
+                char path[24];
+                segmentPath(headSegment++, path, sizeof(path));
+                fm.fs().remove(path);
+            }
+            totalBytes = 0;
+            readOffset = 0;
+            saveCursor();
+        }
+    }
+    oldestSeenMs = millis();
+    lastDrainMs = millis();
+    rateWindowStart = millis();
+    started = true;
+    Log.noticeln("[outbox] recovered %u records (%u bytes)", (unsigned)depth, (unsigned)totalBytes);
+    return true;
+}
+
+/**
+ * @brief appends a publish to the outbox. Drops the oldest segment when the
+ * outbox would exceed OUTBOX_MAX_BYTES.
+ *
+ * @return true - the record is on flash and will be replayed
+ */
+bool Outbox::enqueue(const char *topic, const uint8_t *payload, size_t length)
+{
+    Lock lock;
+    if (!started && !begin())
+    {
+        return false;
+    }
+    size_t topicLength = strlen(topic);
+    size_t recordSize = sizeof(RecordHeader) + topicLength + length;
+    if (topicLength > UINT16_MAX || recordSize > OUTBOX_SEGMENT_BYTES)
+    {
+        Log.warningln("[outbox] %u byte record exceeds a segment, dropped", (unsigned)recordSize);
+        dropped++;
+        return false;
+    }
+
+    if (tailSize > 0 && tailSize + recordSize > OUTBOX_SEGMENT_BYTES)
+    {
+        tailSegment++;
+        tailSize = 0;
+    }
+    while (totalBytes + recordSize > OUTBOX_MAX_BYTES && headSegment != tailSegment)
+    {
+        dropHeadSegment();
+    }
+
+    char path[24];
+    segmentPath(tailSegment, path, sizeof(path));
+    File file = fm.fs().open(path, FILE_APPEND);
+    if (!file)
+    {
+        Log.errorln("[outbox] failed to open %s", path);
+        return false;
+    }
+    RecordHeader header = {RECORD_MAGIC, 0, (uint16_t)topicLength, (uint32_t)length, hyphen::wallclock::epochNow()};
+    bool written = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                   file.write((const uint8_t *)topic, topicLength) == topicLength &&
+                   (length == 0 || file.write(payload, length) == length);
+    size_t size = file.size();
+    file.close();
+    totalBytes += size - tailSize;
+    tailSize = size;
+    if (!written)
+    {
+        // the segment now ends in a torn record; later records go to a new one
+        Log.errorln("[outbox] short write to %s", path);
+        tailSegment++;
+        tailSize = 0;
+        return false;
+    }
+
+    if (depth == 0)
+    {
+        oldestStamp = header.stamp;
+        oldestSeenMs = millis();
+    }
+    depth++;
+    return true;
+}
+
+/**
+ * @brief disk cap reached: discard whatever is left of the oldest segment
+ */
+void Outbox::dropHeadSegment()
+{
+    uint32_t lost = countRecords(headSegment, readOffset, nullptr);
+    char path[24];
+    segmentPath(headSegment, path, sizeof(path));
+    File file = fm.fs().open(path, FILE_READ);
+    uint32_t size = file ? file.size() : 0;
+    if (file)
+    {
+        file.close();
+    }
+    Log.warningln("[outbox] full, dropping %u records from %s", (unsigned)lost, path);
+    dropped += lost;
+    depth -= lost > depth ? depth : lost;
+    retireHeadSegment(size);
+}
+
+void Outbox::retireHeadSegment(uint32_t segmentSize)
+{
+    char path[24];
+    segmentPath(headSegment, path, sizeof(path));
+    fm.fs().remove(path);
+    totalBytes -= segmentSize > totalBytes ? totalBytes : segmentSize;
+    if (headSegment == tailSegment)
+    {
+        tailSegment++;
+        tailSize = 0;
+    }
+    headSegment++;
+    readOffset = 0;
+    saveCursor();
+    refreshOldest();
+}
+
+/**
+ * @brief the head segment has nothing more to read (drained, missing or ending
+ * in a torn record). Torn records are never counted in depth, so only the last
+ * segment can leave the count stale.
+ */
+void Outbox::skipHeadSegment(const char *path, uint32_t segmentSize)
+{
+    if (readOffset < segmentSize)
+    {
+        Log.warningln("[outbox] damaged record in %s, skipping", path);
+    }
+    if (headSegment == tailSegment)
+    {
+        depth = 0;
+    }
+    retireHeadSegment(segmentSize);
+}
+
+/**
+ * @brief reads the stamp of the next record to drain from its header alone
+ */
+void Outbox::refreshOldest()
+{
+    oldestStamp = 0;
+    if (depth == 0)
+    {
+        return;
+    }
+    char path[24];
+    segmentPath(headSegment, path, sizeof(path));
+    File file = fm.fs().open(path, FILE_READ);
+    if (!file)
+    {
+        return;
+    }
+    RecordHeader header;
+    if (readOffset < file.size() && file.seek(readOffset) && readHeader(file, header))
+    {
+        oldestStamp = header.stamp;
+    }
+    file.close();
+}
+
+/**
+ * @brief replays buffered publishes in order, at most OUTBOX_DRAIN_PER_SECOND.
+ * Stops at the first record the publisher rejects so ordering is preserved.
+ * Each record is read under the lock, but published without it, so enqueue()
+ * is never held up behind the network.
+ *
+ * @param publisher - sends one record, returns false if it could not
+ * @return size_t - the number of records delivered
+ */
+size_t Outbox::drain(std::function<bool(const char *, const uint8_t *, size_t)> publisher)
+{
+    {
+        Lock lock;
+        unsigned long now = millis();
+        drainTokens += (now - lastDrainMs) * OUTBOX_DRAIN_PER_SECOND / 1000.0f;
+        lastDrainMs = now;
+        if (drainTokens > OUTBOX_DRAIN_PER_SECOND)
+        {
+            drainTokens = OUTBOX_DRAIN_PER_SECOND;
+        }
+        if (!started || depth == 0 || draining)
+        {
+            return 0;
+        }
+        draining = true;
+    }
+
+    size_t sent = 0;
+    while (true)
+    {
+        std::unique_ptr<uint8_t[]> record;
+        size_t topicLength, payloadLength;
+        uint32_t segment, offset, segmentSize;
+        bool wasTail;
+        {
+            Lock lock;
+            if (depth == 0 || drainTokens < 1)
+            {
+                break;
+            }
+            char path[24];
+            segmentPath(headSegment, path, sizeof(path));
+            File file = fm.fs().open(path, FILE_READ);
+            segmentSize = file ? file.size() : 0;
+            RecordHeader header;
+            if (!file || readOffset >= segmentSize || !file.seek(readOffset) || !readHeader(file, header))
+            {
+                // drained, missing or torn: move on to the next segment
+                if (file)
+                {
+                    file.close();
+                }
+                skipHeadSegment(path, segmentSize);
+                continue;
+            }
+
+            topicLength = header.topicLength;
+            payloadLength = header.payloadLength;
+            if (header.payloadLength > segmentSize || readOffset + sizeof(header) + topicLength + payloadLength > segmentSize)
+            {
+                // a header damaged past its magic; never size a buffer from it
+                file.close();
+                skipHeadSegment(path, segmentSize);
+                continue;
+            }
+            record.reset(new (std::nothrow) uint8_t[topicLength + 1 + payloadLength]);
+            if (!record)
+            {
+                file.close();
+                Log.warningln("[outbox] no memory for a %u byte record, dropped", (unsigned)payloadLength);
+                dropped++;
+                advanceHead(sizeof(header) + topicLength + payloadLength, segmentSize, false);
+                continue;
+            }
+            bool complete = file.read(record.get(), topicLength) == topicLength &&
+                            file.read(record.get() + topicLength + 1, payloadLength) == payloadLength;
+            file.close();
+            if (!complete)
+            {
+                skipHeadSegment(path, segmentSize);
+                continue;
+            }
+            record[topicLength] = '\0';
+            segment = headSegment;
+            offset = readOffset;
+            wasTail = headSegment == tailSegment;
+        }
+
+        bool delivered = publisher((const char *)record.get(), record.get() + topicLength + 1, payloadLength);
+
+        Lock lock;
+        if (!delivered)
+        {
+            break;
+        }
+        drainTokens -= 1;
+        sent++;
+        if (headSegment != segment || readOffset != offset)
+        {
+            // the disk cap dropped this segment while it was being sent
+            continue;
+        }
+        drained++;
+        recordDrain();
+        // records appended meanwhile may have grown the segment, and if it is no
+        // longer the tail its final size is unknown here
+        advanceHead(sizeof(RecordHeader) + topicLength + payloadLength,
+                    headSegment == tailSegment ? tailSize : segmentSize, wasTail && headSegment != tailSegment);
+    }
+    Lock lock;
+    draining = false;
+    return sent;
+}
+
+/**
+ * @brief moves the read cursor past the head record, retiring its segment once
+ * the last record has been read, unless `sizeUnknown`; the next drain then
+ * finds the segment read through and skips it.
+ */
+void Outbox::advanceHead(uint32_t recordBytes, uint32_t segmentSize, bool sizeUnknown)
+{
+    depth--;
+    readOffset += recordBytes;
+    if (!sizeUnknown && readOffset >= segmentSize && (headSegment != tailSegment || depth == 0))
+    {
+        retireHeadSegment(segmentSize);
+        return;
+    }
+    if (++unsyncedDrains >= OUTBOX_CURSOR_SYNC)
+    {
+        saveCursor();
+    }
+    refreshOldest();
+}
+
+void Outbox::rollRateWindow(unsigned long now)
+{
+    const unsigned long window = 10000;
+    unsigned long elapsed = now - rateWindowStart;
+    if (elapsed < window)
+    {
+        return;
+    }
+    lastRate = rateWindowCount * 1000.0f / elapsed;
+    rateWindowStart = now;
+    rateWindowCount = 0;
+}
+
+void Outbox::recordDrain()
+{
+    rollRateWindow(millis());
+    rateWindowCount++;
+}
+
+/**
+ * @brief records replayed per second over the last ten second window
+ */
+float Outbox::drainRate()
+{
+    Lock lock;
+    rollRateWindow(millis());
+    return lastRate;
+}
+
+/**
+ * @brief age of the oldest buffered record. Uses the record's wall-clock stamp
+ * when the clock is set, otherwise the time since the outbox became non-empty.
+ */
+uint32_t Outbox::oldestAgeSeconds()
+{
+    Lock lock;
+    if (depth == 0)
+    {
+        return 0;
+    }
+    uint32_t now = hyphen::wallclock::epochNow();
+    if (now && oldestStamp && now >= oldestStamp)
+    {
+        return now - oldestStamp;
+    }
+    return (millis() - oldestSeenMs) / 1000;
+}
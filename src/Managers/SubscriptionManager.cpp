@@ -1,7 +1,16 @@
 #include "managers/SubscriptionManager.h"
+#include <math.h>
+#include <memory>
+#include <time.h>
 
 SubscriptionManager::SubscriptionManager(Processor &processor) : processor(processor)
 {
+    setResultPrefix(functionResult, functionResultsTopic);
+    setResultPrefix(variableResult, variableResultsTopic);
+#if TOPIC_ALIAS_RESULTS
+    aliases.add(functionResultsTopic.c_str(), (String(MQTT_TOPIC_BASE) + "f/" + deviceId).c_str());
+    aliases.add(variableResultsTopic.c_str(), (String(MQTT_TOPIC_BASE) + "v/" + deviceId).c_str());
+#endif
 }
 
 bool SubscriptionManager::init(bool sendRegistration)
@@ -68,6 +77,11 @@ bool SubscriptionManager::subscribe(const char *topic, std::function<void(const
     return processor.subscribe(topic, callback);
 }
 
+bool SubscriptionManager::subscribe(const char *topic, std::function<void(const char *, const uint8_t *, size_t)> callback)
+{
+    return processor.subscribe(topic, callback);
+}
+
 bool SubscriptionManager::unsubscribe(const char *topic)
 {
     return processor.unsubscribe(topic);
@@ -95,31 +109,95 @@ void SubscriptionManager::setReady()
 
 void SubscriptionManager::function(const char *topic, std::function<int(const char *)> callback)
 {
-
+    TopicToken name{topic, strlen(topic)};
+    int index = findFunction(name);
+    if (index >= 0)
+    {
+        functionCallbacks[index] = callback;
+        return;
+    }
     if (functionCount >= FUNCTION_COUNT_MAX)
     {
         Log.warningln("Function limit reached");
         return;
     }
     functionTopics[functionCount] = topic;
-    functionCallbacks[topic] = callback;
+    functionCallbacks[functionCount] = callback;
     functionCount++;
 }
 
-String SubscriptionManager::getCallId(const char *topic)
+bool SubscriptionManager::parseRequestTopic(const char *topic, TopicToken &key, TopicToken &callId)
+{
+    const char *last = strrchr(topic, '/');
+    if (!last)
+    {
+        return false;
+    }
+    const char *start = last;
+    while (start > topic && *(start - 1) != '/')
+    {
+        start--;
+    }
+    key.at = start;
+    key.length = last - start;
+    callId.at = last + 1;
+    callId.length = strlen(callId.at);
+    return true;
+}
+
+int SubscriptionManager::findFunction(const TopicToken &key)
+{
+    for (int i = 0; i < functionCount; i++)
+    {
+        if (key.equals(functionTopics[i].c_str(), functionTopics[i].length()))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+SubscriptionManager::VariableSlot *SubscriptionManager::findVariable(const TopicToken &key)
+{
+    for (int i = 0; i < variableCount; i++)
+    {
+        if (key.equals(variableRegistry[i].name.c_str(), variableRegistry[i].name.length()))
+        {
+            return &variableRegistry[i];
+        }
+    }
+    return nullptr;
+}
+
+void SubscriptionManager::setResultPrefix(ResultTopic &result, const String &prefix)
 {
-    String topicStr = String(topic);
-    int lastSlash = topicStr.lastIndexOf("/");
-    return topicStr.substring(lastSlash + 1);
+    result.prefix = prefix.length();
+    if (result.prefix < sizeof(result.text))
+    {
+        memcpy(result.text, prefix.c_str(), result.prefix + 1);
+    }
 }
 
-String SubscriptionManager::getTopicKey(const char *topic)
+/**
+ * @brief writes "/<key>/<callId>" after the result prefix
+ *
+ * @return the topic, or nullptr when it does not fit in RESULT_TOPIC_BYTES
+ */
+const char *SubscriptionManager::resultTopic(ResultTopic &result, const TopicToken &key, const TopicToken &callId)
 {
-    String topicStr = String(topic);
-    int lastSlash = topicStr.lastIndexOf("/");
-    String keyBase = topicStr.substring(0, lastSlash);
-    lastSlash = keyBase.lastIndexOf("/");
-    return keyBase.substring(lastSlash + 1);
+    if (result.prefix + 1 + key.length + 1 + callId.length + 1 > sizeof(result.text))
+    {
+        Log.errorln("Result topic longer than RESULT_TOPIC_BYTES (%d)", RESULT_TOPIC_BYTES);
+        return nullptr;
+    }
+    char *at = result.text + result.prefix;
+    *at++ = '/';
+    memcpy(at, key.at, key.length);
+    at += key.length;
+    *at++ = '/';
+    memcpy(at, callId.at, callId.length);
+    at[callId.length] = '\0';
+    return result.text;
 }
 
 bool SubscriptionManager::isConnected()
@@ -127,134 +205,719 @@ bool SubscriptionManager::isConnected()
     return processor.isConnected();
 }
 
-String SubscriptionManager::runVariable(const char *topic, const char *payload)
+/**
+ * @brief writes a result with `write` into `buf`, or into a heap buffer of the
+ * size it needs when it does not fit, and hands the JSON to `use`
+ */
+template <typename Write, typename Use>
+void SubscriptionManager::writeResult(char *buf, size_t capacity, Write write, Use use)
 {
-    String callId = getCallId(topic);
-    String key = getTopicKey(topic);
-    auto varIt = variableRegistry.find(key.c_str());
-    if (varIt == variableRegistry.end())
+    JsonWriter out(buf, capacity);
+    write(out);
+    if (!out.overflowed())
     {
-        Log.warningln("Variable or function not found.");
-        return "";
+        return use(out.c_str(), out.size());
     }
+    std::unique_ptr<char[]> large(new char[out.size() + 1]);
+    JsonWriter again(large.get(), out.size() + 1);
+    write(again);
+    use(again.c_str(), again.size());
+}
 
-    JsonDocument doc;
-    doc["key"] = key;
-    doc["id"] = deviceId;
-    doc["request"] = callId;
-
-    // Retrieve the variable value based on its type
-    switch (varIt->second.type)
-    {
-    case VariableType::INT:
-        doc["value"] = *(varIt->second.data.intPtr);
-        break;
-    case VariableType::LONG:
-        doc["value"] = *(varIt->second.data.longPtr);
-        break;
-    case VariableType::STRING:
-        doc["value"] = *(varIt->second.data.stringPtr);
-        break;
-    case VariableType::DOUBLE:
-        doc["value"] = *(varIt->second.data.doublePtr);
-        break;
-    }
-
-    // Serialize and publish the JSON document
+void SubscriptionManager::writeVariable(const VariableSlot *slot, const TopicToken &callId, JsonWriter &out)
+{
+    if (!slot)
+    {
+        return;
+    }
+    out.beginObject();
+    out.key("key").value(slot->name.c_str(), slot->name.length());
+    out.key("id").value(deviceId.c_str(), deviceId.length());
+    out.key("request").value(callId.at, callId.length);
+    out.key("value");
+    slot->entry.writeValue(out);
+    out.endObject();
+}
+
+/**
+ * @brief whether a bulk read asked for `name`: `names` lists them separated
+ * by commas; an empty list or "*" asks for every variable
+ */
+bool SubscriptionManager::bulkSelects(const char *names, const String &name)
+{
+    if (!names || !*names || strcmp(names, "*") == 0)
+    {
+        return true;
+    }
+    const char *at = names;
+    while (*at)
+    {
+        const char *end = strchr(at, ',');
+        if (!end)
+        {
+            end = at + strlen(at);
+        }
+        TopicToken token{at, (size_t)(end - at)};
+        while (token.length > 0 && isspace((unsigned char)*token.at))
+        {
+            token.at++;
+            token.length--;
+        }
+        while (token.length > 0 && isspace((unsigned char)token.at[token.length - 1]))
+        {
+            token.length--;
+        }
+        if (token.equals(name.c_str(), name.length()))
+        {
+            return true;
+        }
+        at = *end ? end + 1 : end;
+    }
+    return false;
+}
+
+/**
+ * @brief the answer to a bulk read: every selected variable in one object,
+ * written in a single pass over the registry, with one timestamp
+ */
+void SubscriptionManager::writeVariables(const char *names, const TopicToken &callId, JsonWriter &out)
+{
+    out.beginObject();
+    out.key("key").value(BULK_KEY);
+    out.key("id").value(deviceId.c_str(), deviceId.length());
+    out.key("request").value(callId.at, callId.length);
+    out.key("timestamp").value((unsigned long)hyphen::wallclock::epochNow());
+    out.key("values").beginObject();
+    for (int i = 0; i < variableCount; i++)
+    {
+        const VariableSlot &slot = variableRegistry[i];
+        if (bulkSelects(names, slot.name))
+        {
+            out.key(slot.name.c_str(), slot.name.length());
+            slot.entry.writeValue(out);
+        }
+    }
+    out.endObject();
+    out.endObject();
+}
+
+/**
+ * @brief writes the answer to a variable request: one variable, or several
+ * when the key is BULK_KEY
+ *
+ * @return false - no variable is registered under the key
+ */
+bool SubscriptionManager::writeVariableResult(const TopicToken &key, const TopicToken &callId, const char *payload,
+                                              JsonWriter &out)
+{
+    if (key.equals(BULK_KEY))
+    {
+        writeVariables(payload, callId, out);
+        return true;
+    }
+    const VariableSlot *slot = findVariable(key);
+    writeVariable(slot, callId, out);
+    return slot != nullptr;
+}
+
+String SubscriptionManager::runVariable(const char *topic, const char *payload)
+{
+    char buf[RESULT_PAYLOAD_BYTES];
     String resultStr;
-    serializeJson(doc, resultStr);
+    TopicToken key, callId;
+    parseRequestTopic(topic, key, callId);
+    if (!key.equals(BULK_KEY) && !findVariable(key))
+    {
+        Log.warningln("Variable or function not found.");
+        return resultStr;
+    }
+    writeResult(
+        buf, sizeof(buf), [&](JsonWriter &out)
+        { writeVariableResult(key, callId, payload, out); },
+        [&](const char *json, size_t)
+        { resultStr = json; });
     return resultStr;
 }
 
+size_t SubscriptionManager::runVariable(const char *topic, const char *payload, char *out, size_t capacity)
+{
+    TopicToken key, callId;
+    parseRequestTopic(topic, key, callId);
+    JsonWriter writer(out, capacity);
+    writeVariableResult(key, callId, payload, writer);
+    return writer.size();
+}
+
 void SubscriptionManager::variableCallback(const char *topic, const char *payload)
 {
-    String callId = getCallId(topic);
-    String key = getTopicKey(topic);
-    // Serialize and publish the JSON document
-    String resultStr = runVariable(topic, payload);
-    String sendTopic = variableResultsTopic + "/" + key + "/" + callId;
-    if (!publishTopic(sendTopic, resultStr))
+    TopicToken key, callId;
+    parseRequestTopic(topic, key, callId);
+    char *buf = resultPayload;
+    size_t capacity = sizeof(resultPayload);
+    if (key.equals(BULK_KEY))
     {
-        Log.errorln("Failed to publish variable result");
+        // allocated on the first bulk read and kept for the next ones
+        if (!bulkPayload)
+        {
+            bulkPayload.reset(new char[VARIABLE_BULK_BYTES]);
+        }
+        buf = bulkPayload.get();
+        capacity = VARIABLE_BULK_BYTES;
+    }
+    else if (!findVariable(key))
+    {
+        Log.warningln("Variable or function not found.");
     }
+    const char *sendTopic = resultTopic(variableResult, key, callId);
+    writeResult(
+        buf, capacity, [&](JsonWriter &out)
+        { writeVariableResult(key, callId, payload, out); },
+        [&](const char *json, size_t length)
+        { publishResult(sendTopic, json, length); });
 }
 
-String SubscriptionManager::runFunction(const char *topic, const char *payload)
+/**
+ * @brief runs a function, or answers a redelivered call from the cache
+ *
+ * @return the function's index, or -1 when none is registered under `key`
+ */
+int SubscriptionManager::callFunction(const TopicToken &key, const TopicToken &callId, const char *payload, int &result)
 {
-    String callId = getCallId(topic);
-    String key = getTopicKey(topic);
-    auto it = functionCallbacks.find(key.c_str());
-    if (it == functionCallbacks.end())
+    int index = findFunction(key);
+    if (index < 0)
     {
         Log.warningln("Function not found.");
-        return "";
+        return -1;
+    }
+    const std::string &name = functionTopics[index];
+    if (callId.length > 0 && calls.find(name.c_str(), callId.at, result))
+    {
+        // a redelivery: the function already ran, answer with its result again
+        Log.noticeln("Call %s to %s already handled", callId.at, name.c_str());
+        return index;
     }
-    JsonDocument doc;
     // Call the function if it was found
-    int result = it->second(payload);
-    doc["value"] = result;
-    doc["key"] = key;
-    doc["id"] = deviceId;
-    doc["request"] = callId;
+    result = functionCallbacks[index](payload);
+    if (callId.length > 0)
+    {
+        calls.remember(name.c_str(), callId.at, result);
+    }
+    return index;
+}
+
+void SubscriptionManager::writeFunctionResult(int index, const TopicToken &callId, int result, JsonWriter &out)
+{
+    if (index < 0)
+    {
+        return;
+    }
+    const std::string &name = functionTopics[index];
+    out.beginObject();
+    out.key("key").value(name.c_str(), name.length());
+    out.key("id").value(deviceId.c_str(), deviceId.length());
+    out.key("request").value(callId.at, callId.length);
+    out.key("value").value(result);
+    out.endObject();
+}
+
+String SubscriptionManager::runFunction(const char *topic, const char *payload)
+{
+    char buf[RESULT_PAYLOAD_BYTES];
     String resultStr;
-    serializeJson(doc, resultStr);
+    TopicToken key, callId;
+    parseRequestTopic(topic, key, callId);
+    int result = 0;
+    int index = callFunction(key, callId, payload, result);
+    if (index < 0)
+    {
+        return resultStr;
+    }
+    writeResult(
+        buf, sizeof(buf), [&](JsonWriter &out)
+        { writeFunctionResult(index, callId, result, out); },
+        [&](const char *json, size_t)
+        { resultStr = json; });
     return resultStr;
 }
 
+size_t SubscriptionManager::runFunction(const char *topic, const char *payload, char *out, size_t capacity)
+{
+    TopicToken key, callId;
+    parseRequestTopic(topic, key, callId);
+    int result = 0;
+    int index = callFunction(key, callId, payload, result);
+    JsonWriter writer(out, capacity);
+    writeFunctionResult(index, callId, result, writer);
+    return writer.size();
+}
+
 void SubscriptionManager::functionalCallback(const char *topic, const char *payload)
 {
-    String callId = getCallId(topic);
-    String key = getTopicKey(topic);
-    String resultStr = runFunction(topic, payload);
-    String sendTopic = functionResultsTopic + "/" + key + "/" + callId;
-    if (!publishTopic(sendTopic, resultStr))
+    TopicToken key, callId;
+    parseRequestTopic(topic, key, callId);
+    int result = 0;
+    int index = callFunction(key, callId, payload, result);
+    const char *sendTopic = resultTopic(functionResult, key, callId);
+    writeResult(
+        resultPayload, sizeof(resultPayload), [&](JsonWriter &out)
+        { writeFunctionResult(index, callId, result, out); },
+        [&](const char *json, size_t length)
+        { publishResult(sendTopic, json, length); });
+}
+
+/**
+ * @brief registers a variable, or repoints one already registered by name
+ *
+ * @return false - VARIABLE_COUNT_MAX variables are registered already
+ */
+bool SubscriptionManager::addVariable(const char *name, const VariableEntry &entry)
+{
+    TopicToken key{name, strlen(name)};
+    VariableSlot *existing = findVariable(key);
+    if (existing)
     {
-        Log.errorln("Failed to publish result");
+        existing->entry = entry;
+        existing->report.sent = false;
+        return true;
     }
+    if (variableCount >= VARIABLE_COUNT_MAX)
+    {
+        Log.warningln("Variable limit reached, %s not registered", name);
+        return false;
+    }
+    variableRegistry[variableCount].name = name;
+    variableRegistry[variableCount].entry = entry;
+    variableCount++;
+    return true;
 }
 
-void SubscriptionManager::variable(const char *name, int *var)
+bool SubscriptionManager::report(const char *name, const ReportPolicy &policy)
 {
-    VariableEntry entry(VariableType::INT);
-    entry.data.intPtr = var;
-    variableRegistry[name] = entry;
-    variableCount++;
+    VariableSlot *slot = findVariable(TopicToken{name, strlen(name)});
+    if (!slot)
+    {
+        Log.errorln("Cannot report %s: no such variable", name);
+        return false;
+    }
+    if (!slot->report.enabled)
+    {
+        reportCount++;
+    }
+    slot->report.enabled = true;
+    slot->report.sent = false;
+    slot->report.policy = policy;
+    // sample on the next loop
+    lastReportSample = millis() - VARIABLE_REPORT_SAMPLE_MS;
+    return true;
 }
 
-void SubscriptionManager::variable(const char *name, long *var)
+bool SubscriptionManager::stopReporting(const char *name)
 {
-    VariableEntry entry(VariableType::LONG);
-    entry.data.longPtr = var;
-    variableRegistry[name] = entry;
-    variableCount++;
+    VariableSlot *slot = findVariable(TopicToken{name, strlen(name)});
+    if (!slot || !slot->report.enabled)
+    {
+        return false;
+    }
+    slot->report.enabled = false;
+    reportCount--;
+    return true;
 }
 
-void SubscriptionManager::variable(const char *name, String *var)
+/**
+ * @brief samples the variables marked for reporting and pushes those that
+ * changed past their deadband, or are due a heartbeat
+ */
+void SubscriptionManager::reportVariables()
 {
-    VariableEntry entry(VariableType::STRING);
-    entry.data.stringPtr = var;
-    variableRegistry[name] = entry;
-    variableCount++;
+    unsigned long now = millis();
+    if (reportCount == 0 || now - lastReportSample < VARIABLE_REPORT_SAMPLE_MS)
+    {
+        return;
+    }
+    lastReportSample = now;
+    for (int i = 0; i < variableCount; i++)
+    {
+        VariableSlot &slot = variableRegistry[i];
+        if (!slot.report.enabled)
+        {
+            continue;
+        }
+        bool numeric = false;
+        double value = slot.entry.sampleValue(numeric);
+        reportStats.samples++;
+        bool heartbeat = false;
+        if (!reportDue(slot, value, numeric, now, heartbeat))
+        {
+            continue;
+        }
+        if (!sendReport(slot))
+        {
+            reportStats.rejected++;
+            continue;
+        }
+        if (heartbeat)
+        {
+            reportStats.heartbeats++;
+        }
+        else
+        {
+            reportStats.reports++;
+        }
+        slot.report.sent = true;
+        slot.report.numeric = numeric;
+        slot.report.last = value;
+        slot.report.lastMs = now;
+    }
 }
 
-void SubscriptionManager::variable(const char *name, double *var)
+/**
+ * @brief whether a sample is to be reported: it moved past the deadband of
+ * the last report, or the heartbeat is due, and minIntervalMs has passed
+ */
+bool SubscriptionManager::reportDue(VariableSlot &slot, double value, bool numeric, unsigned long now,
+                                    bool &heartbeat)
 {
-    VariableEntry entry(VariableType::DOUBLE);
-    entry.data.doublePtr = var;
-    variableRegistry[name] = entry;
-    variableCount++;
+    const VariableReport &report = slot.report;
+    const ReportPolicy &policy = report.policy;
+    if (!report.sent)
+    {
+        return true;
+    }
+    bool changed;
+    if (numeric && report.numeric)
+    {
+        double delta = fabs(value - report.last);
+        if (policy.deadband <= 0 && policy.deadbandPercent <= 0)
+        {
+            changed = delta > 0;
+        }
+        else
+        {
+            changed = (policy.deadband > 0 && delta >= policy.deadband) ||
+                      (policy.deadbandPercent > 0 && delta > 0 &&
+                       delta >= fabs(report.last) * policy.deadbandPercent / 100);
+        }
+    }
+    else
+    {
+        changed = numeric != report.numeric || value != report.last;
+    }
+    unsigned long elapsed = now - report.lastMs;
+    heartbeat = !changed && policy.maxIntervalMs > 0 && elapsed >= policy.maxIntervalMs;
+    if (!changed && !heartbeat)
+    {
+        return false;
+    }
+    if (elapsed < policy.minIntervalMs)
+    {
+        reportStats.held++;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief queues `{"key","id","timestamp","value"}` on
+ * "<base>Post/Variable/Report/<id>/<key>"
+ *
+ * @return false - the topic is too long or the queue is full
+ */
+bool SubscriptionManager::sendReport(const VariableSlot &slot)
+{
+    char topic[RESULT_TOPIC_BYTES];
+    size_t prefix = variableReportTopic.length();
+    if (prefix + 1 + slot.name.length() + 1 > sizeof(topic))
+    {
+        Log.errorln("Report topic longer than RESULT_TOPIC_BYTES (%d)", RESULT_TOPIC_BYTES);
+        return false;
+    }
+    memcpy(topic, variableReportTopic.c_str(), prefix);
+    topic[prefix] = '/';
+    memcpy(topic + prefix + 1, slot.name.c_str(), slot.name.length() + 1);
+
+    char buf[RESULT_PAYLOAD_BYTES];
+    bool queued = false;
+    writeResult(
+        buf, sizeof(buf), [&](JsonWriter &out)
+        {
+            out.beginObject();
+            out.key("key").value(slot.name.c_str(), slot.name.length());
+            out.key("id").value(deviceId.c_str(), deviceId.length());
+            out.key("timestamp").value((unsigned long)hyphen::wallclock::epochNow());
+            out.key("value");
+            slot.entry.writeValue(out);
+            out.endObject(); },
+        [&](const char *json, size_t length)
+        { queued = publishAsync(topic, (const uint8_t *)json, length); });
+    return queued;
 }
 
 bool SubscriptionManager::publishTopic(String topic, String payload)
 {
     Log.noticeln("Publishing to %s: %s", topic.c_str(), payload.c_str());
-    return processor.publish(topic.c_str(), payload.c_str());
+    return transmit(topic.c_str(), (const uint8_t *)payload.c_str(), payload.length(), true);
 }
 
 bool SubscriptionManager::publishTopic(const char *topic, uint8_t *buf, size_t length)
 {
     Log.noticeln("Publishing to %s with length %d", topic, length);
-    return processor.publish(topic, buf, length);
+    return transmit(topic, buf, length);
+}
+
+/**
+ * @brief hands a publish to the processor with its topic aliased and its
+ * payload compressed, as configured. `text` payloads are NUL-terminated and
+ * keep the text publish when sent unchanged.
+ */
+bool SubscriptionManager::transmit(const char *topic, const uint8_t *buf, size_t length, bool text)
+{
+    String scratch;
+    const char *wire = wireTopic(topic, scratch);
+    return compressor.send(buf, length, [&](const uint8_t *out, size_t n)
+                           {
+        if (text && out == buf)
+        {
+            return processor.publish(wire, (const char *)buf);
+        }
+        return processor.publish(wire, (uint8_t *)out, n); });
+}
+
+bool SubscriptionManager::topicAlias(const char *prefix, const char *alias)
+{
+    if (!aliases.add(prefix, alias))
+    {
+        Log.errorln("Cannot alias %s as %s (TOPIC_ALIAS_MAX, taken or not shorter)", prefix, alias);
+        return false;
+    }
+    if (aliases.isAnnounced())
+    {
+        Log.warningln("Alias %s applies from now on; the manifest already sent does not list it", alias);
+    }
+    return true;
+}
+
+/**
+ * @brief the topic as sent: aliased once the manifest announced the aliases.
+ * The registration topic itself always goes out in full.
+ */
+const char *SubscriptionManager::wireTopic(const char *topic, String &scratch)
+{
+    if (registrationTopic == topic)
+    {
+        return topic;
+    }
+    return aliases.shorten(topic, scratch);
+}
+
+bool SubscriptionManager::publishStream(const char *topic, Stream &source, size_t length)
+{
+    return publishStream(topic, length, [&source](uint8_t *buf, size_t capacity)
+                         { return source.readBytes((char *)buf, capacity); });
+}
+
+/**
+ * @brief streams `length` bytes from `reader` through the processor in
+ * MQTT_STREAM_CHUNK_BYTES pieces. The length is part of the MQTT header, so
+ * a reader that runs dry early fails the publish (and the processor drops the
+ * half-sent packet).
+ *
+ * @return true - all `length` bytes were published
+ */
+bool SubscriptionManager::publishStream(const char *topic, size_t length, StreamReader reader)
+{
+    String scratch;
+    topic = wireTopic(topic, scratch);
+    Log.noticeln("Streaming to %s with length %d", topic, length);
+    if (!processor.beginPublish(topic, length))
+    {
+        return false;
+    }
+    uint8_t chunk[MQTT_STREAM_CHUNK_BYTES];
+    size_t remaining = length;
+    while (remaining > 0)
+    {
+        size_t want = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+        size_t got = reader(chunk, want);
+        if (got == 0 || got > want)
+        {
+            Log.errorln("Stream source ended with %d bytes left", remaining);
+            break;
+        }
+        size_t sent = 0;
+        while (sent < got)
+        {
+            size_t n = processor.write(chunk + sent, got - sent);
+            if (n == 0)
+            {
+                break;
+            }
+            sent += n;
+        }
+        remaining -= sent;
+        if (sent < got)
+        {
+            Log.errorln("Stream write failed with %d bytes left", remaining);
+            break;
+        }
+    }
+    return processor.endPublish() && remaining == 0;
+}
+
+bool SubscriptionManager::publishAsync(const char *topic, const char *payload, PublishCallback onDone,
+                                       PublishPriority priority)
+{
+    return publishAsync(topic, (const uint8_t *)payload, strlen(payload), onDone, priority);
+}
+
+bool SubscriptionManager::publishAsync(const char *topic, const uint8_t *buf, size_t length, PublishCallback onDone,
+                                       PublishPriority priority)
+{
+    if (!publishQueue.push(topic, buf, length, onDone, priority, true))
+    {
+        Log.warningln("Async publish lane %d full, rejected %s", (int)priority, topic);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief queues a function or variable result on the control lane, ahead of
+ * any telemetry backlog; sent directly if the lane is full
+ */
+void SubscriptionManager::publishResult(const char *topic, const char *payload, size_t length)
+{
+    if (!topic)
+    {
+        return;
+    }
+    if (publishQueue.push(topic, (const uint8_t *)payload, length,
+                          [](const PublishReceipt &receipt)
+                          {
+                              if (receipt.result != PublishResult::SENT)
+                              {
+                                  Log.errorln("Failed to publish result");
+                              }
+                          },
+                          PublishPriority::CONTROL))
+    {
+        return;
+    }
+    if (!transmit(topic, (const uint8_t *)payload, length, true))
+    {
+        Log.errorln("Failed to publish result");
+    }
+}
+
+/**
+ * @brief sends queued async publishes from the manager loop, so the blocking
+ * radio I/O happens here rather than on the caller's task. Application
+ * publishes meet the rate and data limits here, when their turn comes; one
+ * over a deferring limit keeps its place in the queue.
+ */
+void SubscriptionManager::drainPublishQueue()
+{
+    if (publishQueue.size() == 0)
+    {
+        return;
+    }
+    publishQueue.drain(
+        PUBLISH_QUEUE_DRAIN_PER_LOOP,
+        [this]()
+        { return processor.isConnected(); },
+        [this](const char *topic, const uint8_t *buf, size_t length)
+        { return transmit(topic, buf, length); },
+        [this](const char *topic, size_t length)
+        {
+            GovernorVerdict verdict = governor.admitQueued(topic, length, hyphen::wallclock::epochNow());
+            if (verdict == GovernorVerdict::REJECTED)
+            {
+                Log.warningln("Async publish to %s refused by rate/data limits", topic);
+            }
+            return verdict;
+        });
+}
+
+void SubscriptionManager::enableBatching(size_t maxBytes, unsigned long windowMs, const char *batchTopic)
+{
+    batcher.configure(maxBytes, windowMs, batchTopic);
+    batching = true;
+}
+
+/**
+ * @brief turns batching off, flushing anything still pending
+ *
+ * @return true - nothing was left unsent
+ */
+bool SubscriptionManager::disableBatching()
+{
+    batching = false;
+    return flush();
+}
+
+bool SubscriptionManager::publishBatched(const char *topic, const char *payload)
+{
+    return publishBatched(topic, (const uint8_t *)payload, strlen(payload));
+}
+
+bool SubscriptionManager::publishBatched(const char *topic, const uint8_t *buf, size_t length)
+{
+    if (!batching)
+    {
+        return publishTopic(topic, (uint8_t *)buf, length);
+    }
+    return batcher.add(topic, buf, length, [this](const char *t, const uint8_t *b, size_t l)
+                       { return sendBatch(t, b, l); });
+}
+
+bool SubscriptionManager::flush()
+{
+    return batcher.flush([this](const char *t, const uint8_t *b, size_t l)
+                         { return sendBatch(t, b, l); });
+}
+
+bool SubscriptionManager::sendBatch(const char *topic, const uint8_t *buf, size_t length)
+{
+    Log.noticeln("Publishing batch to %s with length %d", topic, length);
+    return transmit(topic, buf, length);
+}
+
+bool SubscriptionManager::limitTopic(const char *prefix, float perSecond, uint16_t burst, ThrottlePolicy policy)
+{
+    if (!governor.limitTopic(prefix, perSecond, burst, policy))
+    {
+        Log.errorln("No room for a rate limit on %s (GOVERNOR_RULES_MAX)", prefix);
+        return false;
+    }
+    return true;
+}
+
+void SubscriptionManager::setDataBudget(uint32_t bytesPerPeriod, ThrottlePolicy policy)
+{
+    governor.setBudget(bytesPerPeriod, policy);
+}
+
+GovernorVerdict SubscriptionManager::govern(const char *topic, const uint8_t *buf, size_t length, bool canDefer)
+{
+    GovernorVerdict verdict = governor.admit(topic, buf, length, hyphen::wallclock::epochNow(), canDefer);
+    if (verdict == GovernorVerdict::REJECTED)
+    {
+        Log.warningln("Publish to %s refused by rate/data limits", topic);
+    }
+    return verdict;
+}
+
+/**
+ * @brief sends publishes the governor deferred, as far as the limits allow
+ */
+void SubscriptionManager::releaseGoverned()
+{
+    if (governor.held() == 0)
+    {
+        return;
+    }
+    governor.release(PUBLISH_QUEUE_DRAIN_PER_LOOP, hyphen::wallclock::epochNow(),
+                     [this](const char *topic, const uint8_t *buf, size_t length)
+                     { return transmit(topic, buf, length); });
 }
 
 String SubscriptionManager::buildRegistryPayload()
@@ -269,9 +932,15 @@ String SubscriptionManager::buildRegistryPayload()
     {
         funArray.add(functionTopics[i]);
     }
-    for (auto &entry : variableRegistry)
+    for (int i = 0; i < variableCount; i++)
+    {
+        varArray.add(variableRegistry[i].name.c_str());
+    }
+    if (!aliases.empty())
     {
-        varArray.add(entry.first.c_str());
+        JsonObject aliasMap = doc["aliases"].to<JsonObject>();
+        aliases.each([&](const char *alias, const char *prefix)
+                     { aliasMap[alias] = prefix; });
     }
     String resultStr;
     serializeJson(doc, resultStr);
@@ -287,6 +956,7 @@ void SubscriptionManager::sendRegistry()
     {
         return Log.errorln("Failed to publish registry");
     }
+    aliases.announce();
     tick.detach();
     subscriptionDone = true;
 }
@@ -330,6 +1000,7 @@ bool SubscriptionManager::loop()
     }
 
     processor.loop();
+    drainPublishQueue();
 
     // React immediately if the MQTT socket has dropped, rather than waiting for
     // the keep-alive interval to elapse — shrinks the dead-connection window from
@@ -339,6 +1010,15 @@ bool SubscriptionManager::loop()
         return maintain();
     }
 
+    releaseGoverned();
+    reportVariables();
+
+    if (batching)
+    {
+        batcher.poll([this](const char *t, const uint8_t *b, size_t l)
+                     { return sendBatch(t, b, l); });
+    }
+
     if (!keepAliveReady())
     {
         return true;
@@ -1,8 +1,24 @@
 #include "processors/SecureMQTTProcessor.h"
+#if MBEDTLS_VERSION_MAJOR >= 3
+#include <esp_random.h>
+#endif
+
+#ifdef HYPHEN_TLS_RESUMPTION
+// the last broker session, kept across deep sleep and soft resets
+RTC_NOINIT_ATTR static TlsSession rtcTlsSession;
+#endif
 
 SecureMQTTProcessor::SecureMQTTProcessor(Connection &connection)
     : connection(connection)
+#ifdef HYPHEN_TLS_RESUMPTION
+      , tlsSessions(rtcTlsSession)
+#endif
 {
+    tap.onPacket([this](uint8_t type, uint8_t, const uint8_t *head, size_t headLength, size_t)
+                 { onControlPacket(type, head, headLength); });
+    // keep-alive and ack writes from mqttClient.loop() wait out a streaming
+    // publish, without holding the lock while callbacks run
+    tap.lockWritesWith(Lock::mutex());
 }
 
 /**
@@ -13,6 +29,7 @@ SecureMQTTProcessor::SecureMQTTProcessor(Connection &connection)
 bool SecureMQTTProcessor::init()
 {
     initialized = false;
+    startInboundWorker();
     // health.on();
     if (!connection.isConnected())
     {
@@ -70,13 +87,14 @@ bool SecureMQTTProcessor::attachServer()
     }
 #endif
     // sslClient.validate(MQTT_IOT_ENDPOINT, MQTT_IOT_PORT);
-    mqttClient
-        .setServer(MQTT_IOT_ENDPOINT, MQTT_IOT_PORT)
 #ifndef INSECURE_MQTT
-        .setClient(*secureClient)
+    tap.attach(*secureClient);
 #else
-        .setClient(*client)
+    tap.attach(*client);
 #endif
+    mqttClient
+        .setServer(MQTT_IOT_ENDPOINT, MQTT_IOT_PORT)
+        .setClient(tap)
         .setKeepAlive(KEEP_ALIVE)
 
         .setCallback([this](char *topic, byte *payload, unsigned int length)
@@ -166,6 +184,10 @@ void SecureMQTTProcessor::loop()
         MQTTConnected = false;
         Log.warningln("[diag] mqtt loop detected dropped connection (heap=%u)", (unsigned)ESP.getFreeHeap());
     }
+    else
+    {
+        serviceInflight();
+    }
     loopEvent = false;
 }
 
@@ -200,7 +222,8 @@ bool SecureMQTTProcessor::attachCertificates()
 }
 
 /**
- * @brief loads the certificates from the secure MQTT connection
+ * @brief loads the certificates from the secure MQTT connection. This runs once:
+ * the PEM pointers are kept and re-attached on every later connect.
  *
  * @return true - all certificates are loaded
  */
@@ -227,72 +250,138 @@ bool SecureMQTTProcessor::loadCertificates()
         certificateLengths[DeviceCertificate] = crt_len;
         certificateLengths[DevicePrivateKey] = key_len;
 
+        if (!validateCertificates())
+        {
+            return false;
+        }
         certsCached = true;
         Log.noticeln("✅ Loaded embedded certificates from flash.");
         return attachCertificates();
     }
 
-    if (!fm.start())
-    {
-        Log.errorln("Failed to initialize SPIFFS");
-        return false;
-    }
-    coreDelay(200);
-    // Load Root CA
 #ifdef MQTT_CA_CERTIFICATE
-    String caContent = String(MQTT_CA_CERTIFICATE);
+    const char *caLiteral = MQTT_CA_CERTIFICATE;
 #else
-    String caContent = fm.loadFileContents(MQTT_CA_CERTIFICATE_NAME);
+    const char *caLiteral = nullptr;
+#endif
+#ifdef MQTT_DEVICE_CERTIFICATE
+    const char *certLiteral = MQTT_DEVICE_CERTIFICATE;
+#else
+    const char *certLiteral = nullptr;
+#endif
+#ifdef MQTT_DEVICE_PRIVATE_KEY
+    const char *keyLiteral = MQTT_DEVICE_PRIVATE_KEY;
+#else
+    const char *keyLiteral = nullptr;
 #endif
 
-    if (caContent.isEmpty())
+    bool useFiles = !caLiteral || !certLiteral || !keyLiteral;
+    if (useFiles)
+    {
+        if (!fm.start())
+        {
+            Log.errorln("Failed to initialize SPIFFS");
+            return false;
+        }
+        coreDelay(200);
+    }
+    bool loaded = loadCertificate(CA, caLiteral, MQTT_CA_CERTIFICATE_NAME) &&
+                  loadCertificate(DeviceCertificate, certLiteral, MQTT_DEVICE_CERTIFICATE_NAME) &&
+                  loadCertificate(DevicePrivateKey, keyLiteral, MQTT_DEVICE_PRIVATE_KEY_NAME);
+    if (useFiles)
+    {
+        fm.end();
+    }
+    if (!loaded || !validateCertificates())
     {
-        Log.errorln("CA file is empty");
         return false;
     }
-    // Keep the PEM data alive for the lifetime of the processor. caContent is a
-    // local String; pointing certificates[] at its c_str() would dangle once
-    // this function returns.
-    certStorage[CA] = caContent;
-    certificates[CA] = certStorage[CA].c_str();
-    certificateLengths[CA] = certStorage[CA].length();
-    Log.noticeln("Loaded CA certificate:");
-    Log.noticeln(caContent.substring(0, 20).c_str());
-#ifdef MQTT_DEVICE_CERTIFICATE
-    String certContent = String(MQTT_DEVICE_CERTIFICATE);
-#else
-    String certContent = fm.loadFileContents(MQTT_DEVICE_CERTIFICATE_NAME);
-#endif
-    if (certContent.isEmpty())
+    Log.noticeln("Loaded certificates: ca=%u crt=%u key=%u", (unsigned)certificateLengths[CA],
+                 (unsigned)certificateLengths[DeviceCertificate], (unsigned)certificateLengths[DevicePrivateKey]);
+    certsCached = true;
+    return attachCertificates();
+}
+
+/**
+ * @brief points certificates[index] at its PEM. A compiled-in literal is used
+ * where it lives in flash; a SPIFFS file is read once into an exact-size buffer
+ * owned by certStorage[index], replacing any earlier one.
+ *
+ * @return true - the certificate is non-empty
+ */
+bool SecureMQTTProcessor::loadCertificate(uint8_t index, const char *literal, const char *fileName)
+{
+    if (literal != nullptr)
     {
-        Log.errorln("Device certificate file is empty");
+        certStorage[index].reset();
+        certificates[index] = literal;
+        certificateLengths[index] = strlen(literal);
+    }
+    else
+    {
+        certificateLengths[index] = fm.loadFileBuffer(fileName, certStorage[index]);
+        certificates[index] = certStorage[index].get();
+    }
+    if (certificateLengths[index] == 0)
+    {
+        Log.errorln("Certificate %s is empty", fileName);
         return false;
     }
+    return true;
+}
 
-    certStorage[DeviceCertificate] = certContent;
-    certificates[DeviceCertificate] = certStorage[DeviceCertificate].c_str();
-    certificateLengths[DeviceCertificate] = certStorage[DeviceCertificate].length();
-    Log.noticeln("Loaded device certificate:");
-    Log.noticeln(certContent.substring(0, 20).c_str());
-#ifdef MQTT_DEVICE_PRIVATE_KEY
-    String keyContent = String(MQTT_DEVICE_PRIVATE_KEY);
-#else
-    String keyContent = fm.loadFileContents(MQTT_DEVICE_PRIVATE_KEY_NAME);
+#if MQTT_VALIDATE_CERTIFICATES && !defined(INSECURE_MQTT) && MBEDTLS_VERSION_MAJOR >= 3
+// mbedtls 3 wants an RNG to parse a private key (used for blinding)
+static int keyParseRandom(void *, unsigned char *output, size_t length)
+{
+    esp_fill_random(output, length);
+    return 0;
+}
 #endif
 
-    if (keyContent.isEmpty())
+/**
+ * @brief a validation-only check: each credential is parsed once when it is
+ * loaded, so a corrupt or truncated PEM is reported here rather than as an
+ * opaque handshake failure. It saves no work per connect; the parsed forms are
+ * freed straight away, as the TLS clients only accept PEM and parse it
+ * themselves at every connect.
+ *
+ * @return true - all three credentials parse (or validation is disabled)
+ */
+bool SecureMQTTProcessor::validateCertificates()
+{
+#if MQTT_VALIDATE_CERTIFICATES && !defined(INSECURE_MQTT)
+    mbedtls_x509_crt crt;
+    const char *names[CERT_LENGTH] = {"CA", "device certificate", "private key"};
+    for (uint8_t i = CA; i <= DeviceCertificate; i++)
     {
-        Log.errorln("Private key file is empty");
+        mbedtls_x509_crt_init(&crt);
+        // PEM input must include its NUL terminator in the length
+        int rc = mbedtls_x509_crt_parse(&crt, (const unsigned char *)certificates[i], strlen(certificates[i]) + 1);
+        mbedtls_x509_crt_free(&crt);
+        if (rc != 0)
+        {
+            Log.errorln("Invalid %s (mbedtls -0x%04x)", names[i], (unsigned)-rc);
+            return false;
+        }
+    }
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    const unsigned char *pem = (const unsigned char *)certificates[DevicePrivateKey];
+    size_t pemLength = strlen(certificates[DevicePrivateKey]) + 1;
+#if MBEDTLS_VERSION_MAJOR >= 3
+    int rc = mbedtls_pk_parse_key(&key, pem, pemLength, nullptr, 0, keyParseRandom, nullptr);
+#else
+    int rc = mbedtls_pk_parse_key(&key, pem, pemLength, nullptr, 0);
+#endif
+    mbedtls_pk_free(&key);
+    if (rc != 0)
+    {
+        Log.errorln("Invalid %s (mbedtls -0x%04x)", names[DevicePrivateKey], (unsigned)-rc);
         return false;
     }
-    certStorage[DevicePrivateKey] = keyContent;
-    certificates[DevicePrivateKey] = certStorage[DevicePrivateKey].c_str();
-    certificateLengths[DevicePrivateKey] = certStorage[DevicePrivateKey].length();
-    Log.noticeln("Loaded private key:");
-    Log.noticeln(keyContent.substring(0, 20).c_str());
-    fm.end();
-    certsCached = true;
-    return attachCertificates();
+#endif
+    return true;
 }
 
 /**
@@ -343,11 +432,19 @@ bool SecureMQTTProcessor::setupSecureConnection()
             return false;
         }
 
+        sessionPresent = false;
 #ifndef INSECURE_MQTT
-        if (mqttClient.connect(CLIENT_ID, nullptr, nullptr, // no username/password
-                               nullptr,                     // no will
-                               QOS_MQTT, false, nullptr,
-                               /* cleanSession: */ false))
+        offerTlsSession();
+        uint32_t connects = tap.getConnects();
+        bool connected = mqttClient.connect(CLIENT_ID, nullptr, nullptr, // no username/password
+                                            nullptr,                     // no will
+                                            QOS_MQTT, false, nullptr,
+                                            /* cleanSession: */ false);
+        if (tap.getConnects() != connects)
+        {
+            recordHandshake(connected);
+        }
+        if (connected)
         {
             break;
         }
@@ -382,6 +479,11 @@ bool SecureMQTTProcessor::setupSecureConnection()
     Log.noticeln("Verifing Connection to Secure MQTT Network.");
     if (MQTTConnected)
     {
+        {
+            // unacknowledged QoS 1 publishes must be resent on the new session
+            Lock lock;
+            inflight.expedite(millis(), MQTT_RETRANSMIT_MS);
+        }
         subscribeToTopics();
         Log.noticeln("Connected to IoT Core.");
         light.startBreathing();
@@ -391,6 +493,69 @@ bool SecureMQTTProcessor::setupSecureConnection()
     initialized = true;
     return MQTTConnected;
 }
+/**
+ * @brief hands the stored session for this broker to the secure client, so
+ * the next handshake can be abbreviated. Clients without resumption support
+ * ignore it and run a full handshake. Only built with HYPHEN_TLS_RESUMPTION.
+ */
+void SecureMQTTProcessor::offerTlsSession()
+{
+#if !defined(INSECURE_MQTT) && defined(HYPHEN_TLS_RESUMPTION)
+    sessionOffered = false;
+    const TlsSession *session = tlsSessions.find(MQTT_IOT_ENDPOINT, MQTT_IOT_PORT);
+    if (session && secureClient != nullptr)
+    {
+        sessionOffered = secureClient->offerSession(session->data, session->length);
+    }
+#endif
+}
+
+/**
+ * @brief logs how the transport handshake went and, with
+ * HYPHEN_TLS_RESUMPTION, keeps the resulting session for the next connect
+ *
+ * @param bool connected - whether the MQTT connect succeeded
+ */
+void SecureMQTTProcessor::recordHandshake(bool connected)
+{
+#ifndef INSECURE_MQTT
+    unsigned long elapsed = tap.getConnectMs();
+    if (!connected)
+    {
+        tlsStats.failed++;
+#ifdef HYPHEN_TLS_RESUMPTION
+        if (sessionOffered)
+        {
+            // don't offer a session the broker may be rejecting; next try is a full handshake
+            tlsSessions.clear();
+        }
+#endif
+        Log.warningln("[tls] connect failed after %lu ms (session offered=%d)", elapsed, sessionOffered);
+        return;
+    }
+    bool resumed = secureClient->sessionResumed();
+    tlsStats.handshakes++;
+    tlsStats.lastHandshakeMs = elapsed;
+    if (elapsed > tlsStats.maxHandshakeMs)
+    {
+        tlsStats.maxHandshakeMs = elapsed;
+    }
+    if (resumed)
+    {
+        tlsStats.resumed++;
+    }
+    Log.noticeln("[tls] handshake %lu ms, resumed=%d (%u of %u resumed)", elapsed, resumed,
+                 tlsStats.resumed, tlsStats.handshakes);
+#ifdef HYPHEN_TLS_RESUMPTION
+    if (!resumed)
+    {
+        tlsSessions.update(MQTT_IOT_ENDPOINT, MQTT_IOT_PORT, [this](uint8_t *data, size_t capacity)
+                           { return secureClient->exportSession(data, capacity); });
+    }
+#endif
+#endif
+}
+
 /**
  * @brief attempts to reconnect to the MQTT server and the network connection
  */
@@ -474,11 +639,19 @@ bool SecureMQTTProcessor::preProcesss()
  */
 bool SecureMQTTProcessor::publish(const char *topic, const char *payload)
 {
+    if (publishQos > 0)
+    {
+        return publish(topic, (uint8_t *)payload, strlen(payload));
+    }
     if (!preProcesss())
     {
         return false;
     }
-    bool published = mqttClient.publish(topic, payload);
+    bool published;
+    {
+        Lock lock;
+        published = mqttClient.publish(topic, payload);
+    }
     processing = false;
     return published;
 }
@@ -489,11 +662,189 @@ bool SecureMQTTProcessor::publish(const char *topic, uint8_t *buf, size_t length
     {
         return false;
     }
-    bool published = mqttClient.publish(topic, buf, length);
+    bool published;
+    {
+        Lock lock;
+        published = publishQos > 0 ? publishAcknowledged(topic, buf, length)
+                                   : mqttClient.publish(topic, buf, length);
+    }
     processing = false;
     return published;
 }
 
+/**
+ * @brief starts a streaming publish of `length` bytes. The header goes out
+ * now and write() sends the payload straight to the socket, so a payload of
+ * any size needs no buffer. The processor lock stays held until endPublish(),
+ * which keeps other publishes and keep-alives from interleaving with the
+ * packet. Streams are always sent at QoS 0.
+ *
+ * @return true - the header was written; endPublish() must follow
+ */
+bool SecureMQTTProcessor::beginPublish(const char *topic, size_t length)
+{
+    if (!preProcesss())
+    {
+        return false;
+    }
+    xSemaphoreTakeRecursive(Lock::mutex(), portMAX_DELAY);
+    if (streaming || !mqttClient.beginPublish(topic, length, false))
+    {
+        xSemaphoreGiveRecursive(Lock::mutex());
+        processing = false;
+        return false;
+    }
+    streaming = true;
+    streamRemaining = length;
+    return true;
+}
+
+size_t SecureMQTTProcessor::write(const uint8_t *buf, size_t length)
+{
+    if (!streaming)
+    {
+        return 0;
+    }
+    // never overrun the declared length; the broker would misparse the stream
+    if (length > streamRemaining)
+    {
+        length = streamRemaining;
+    }
+    size_t written = mqttClient.write(buf, length);
+    streamRemaining -= written;
+    return written;
+}
+
+/**
+ * @brief finishes a streaming publish. A stream that ended short of its
+ * declared length has left the broker mid-packet, so the session is dropped
+ * and rebuilt by the manager.
+ *
+ * @return true - every declared byte was written
+ */
+bool SecureMQTTProcessor::endPublish()
+{
+    if (!streaming)
+    {
+        return false;
+    }
+    streaming = false;
+    bool complete = streamRemaining == 0 && mqttClient.endPublish();
+    if (streamRemaining > 0)
+    {
+        Log.errorln("[stream] publish ended %u bytes short, dropping the session", (unsigned)streamRemaining);
+        stop();
+    }
+    xSemaphoreGiveRecursive(Lock::mutex());
+    processing = false;
+    return complete;
+}
+
+/**
+ * @brief sets the QoS used by publish(). QoS 2 is not supported and is
+ * treated as 1.
+ *
+ * @param uint8_t qos
+ */
+void SecureMQTTProcessor::setPublishQos(uint8_t qos)
+{
+    if (qos > 1)
+    {
+        Log.warningln("[qos] QoS %d is not supported, publishing at QoS 1", qos);
+    }
+    publishQos = qos > 0 ? 1 : 0;
+}
+
+InflightStats SecureMQTTProcessor::getInflightStats()
+{
+    Lock lock;
+    return inflight.stats();
+}
+
+/**
+ * @brief writes a QoS 1 PUBLISH and keeps it in the in-flight window until its
+ * PUBACK arrives. Returns once the packet is on the socket, so several
+ * publishes can be outstanding at once; when the window is full the publish
+ * is refused rather than waiting on the broker.
+ *
+ * @return true - the packet was written and is being tracked
+ */
+bool SecureMQTTProcessor::publishAcknowledged(const char *topic, const uint8_t *buf, size_t length)
+{
+    Lock lock;
+    InflightWindow<MQTT_INFLIGHT_BYTES, MQTT_INFLIGHT_WINDOW>::Packet packet;
+    if (!inflight.add(topic, buf, length, millis(), packet))
+    {
+        Log.warningln("[qos] in-flight window full (%d), publish to %s refused", inflight.size(), topic);
+        return false;
+    }
+    if (tap.write(packet.data, packet.length) != packet.length)
+    {
+        inflight.cancel(packet.id);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief control packets seen on the inbound stream that PubSubClient itself
+ * ignores
+ */
+void SecureMQTTProcessor::onControlPacket(uint8_t type, const uint8_t *head, size_t headLength)
+{
+    if (type == hyphen::mqtt::PUBACK && headLength >= 2)
+    {
+        Lock lock;
+        inflight.ack((uint16_t)(head[0] << 8 | head[1]), millis());
+    }
+    else if (type == hyphen::mqtt::CONNACK && headLength >= 2)
+    {
+        Lock lock;
+        sessionPresent = head[1] == 0 && (head[0] & 0x01); // accepted, and the broker kept our session
+    }
+    else if (type == hyphen::mqtt::SUBACK && headLength >= 2)
+    {
+        Lock lock;
+        uint32_t refused = resubscribe.stats().refused;
+        if (!resubscribe.ack((uint16_t)(head[0] << 8 | head[1]), head + 2, headLength - 2, millis()))
+        {
+            return; // a single SUBSCRIBE from PubSubClient
+        }
+        if (resubscribe.stats().refused != refused)
+        {
+            Log.warningln("[sub] broker refused %d filters", resubscribe.stats().refused - refused);
+        }
+        if (resubscribe.ready())
+        {
+            Log.noticeln("[sub] subscriptions ready after %lu ms", resubscribe.stats().lastReadyMs);
+        }
+        if (resubscribe.complete())
+        {
+            brokerSubscriptions = resubscribe.fingerprint();
+            brokerSubscriptionsKnown = true;
+        }
+    }
+}
+
+/**
+ * @brief resends timed-out QoS 1 publishes with the DUP flag
+ */
+void SecureMQTTProcessor::serviceInflight()
+{
+    Lock lock;
+    if (inflight.empty())
+    {
+        return;
+    }
+    size_t resent = inflight.service(millis(), MQTT_RETRANSMIT_MS, MQTT_MAX_RETRANSMITS,
+                                     [this](const uint8_t *data, size_t length)
+                                     { return tap.write(data, length) == length; });
+    if (resent)
+    {
+        Log.noticeln("[qos] resent %d unacknowledged publishes", resent);
+    }
+}
+
 /**
  * @brief subscribes to a topic on the MQTT server
  *
@@ -503,6 +854,10 @@ bool SecureMQTTProcessor::publish(const char *topic, uint8_t *buf, size_t length
 bool SecureMQTTProcessor::subscribeToTopic(const char *topic)
 {
     Log.notice(F("SUBSCRIBING TO: %s" CR), topic);
+    {
+        Lock lock;
+        brokerSubscriptionsKnown = false; // not confirmed until the next full resubscription
+    }
     return mqttClient.subscribe(topic);
 }
 
@@ -515,17 +870,82 @@ bool SecureMQTTProcessor::subscribeToTopic(const char *topic)
 bool SecureMQTTProcessor::unsubscribeToTopic(const char *topic)
 {
     Log.notice(F("UNSUBSCRIBING TO: %s" CR), topic);
+    {
+        Lock lock;
+        brokerSubscriptionsKnown = false;
+    }
     return mqttClient.unsubscribe(topic);
 }
 
 /**
  * @brief on disconnect, we find that the topics will need to be re-subscribed to, this method
- * will iterate through previously subscribed topics and re-subscribe to them.
+ * will iterate through previously subscribed topics and re-subscribe to them. The filters are
+ * packed into as few SUBSCRIBE packets as MQTT_SUBSCRIBE_BATCH_BYTES / _FILTERS allow and
+ * written back to back; their SUBACKs are matched in onControlPacket. A filter that does not
+ * fit a batch is subscribed on its own.
  */
 void SecureMQTTProcessor::subscribeToTopics()
 {
-    CommunicationRegistry::getInstance().iterateCallbacks([this](const char *topic)
-                                                          { subscribeToTopic(topic); });
+    Lock lock;
+    if (sessionHoldsSubscriptions())
+    {
+        resubscribe.skip();
+        Log.noticeln("[sub] session present, %d subscriptions kept by the broker", brokerSubscriptions.count);
+        return;
+    }
+    auto write = [this](const uint8_t *data, size_t length)
+    { return tap.write(data, length) == length; };
+    bool written = true;
+    resubscribe.begin(millis());
+    CommunicationRegistry::getInstance().iterateCallbacks([&](const char *topic)
+                                                          {
+        if (!written)
+        {
+            return;
+        }
+        switch (resubscribe.add(topic, 0, write))
+        {
+        case Resubscribe::Result::SINGLE:
+            subscribeToTopic(topic);
+            break;
+        case Resubscribe::Result::WRITE_FAILED:
+            written = false;
+            break;
+        default:
+            break;
+        } });
+    if (!written || !resubscribe.flush(write))
+    {
+        Log.warningln("[sub] connection lost while resubscribing");
+        return;
+    }
+    Log.noticeln("[sub] resubscribed in %d packets", resubscribe.packets());
+}
+
+/**
+ * @brief true when the broker reported our persistent session on connect and
+ * the registered filters are exactly the set it last granted in full
+ */
+bool SecureMQTTProcessor::sessionHoldsSubscriptions()
+{
+#if MQTT_SKIP_RESUBSCRIBE
+    if (!sessionPresent || !brokerSubscriptionsKnown)
+    {
+        return false;
+    }
+    SubscriptionFingerprint registered;
+    CommunicationRegistry::getInstance().iterateCallbacks([&](const char *topic)
+                                                          { registered.add(topic); });
+    return registered == brokerSubscriptions;
+#else
+    return false;
+#endif
+}
+
+SubscribeStats SecureMQTTProcessor::getSubscribeStats()
+{
+    Lock lock;
+    return resubscribe.stats();
 }
 
 /**
@@ -537,17 +957,36 @@ void SecureMQTTProcessor::subscribeToTopics()
  */
 bool SecureMQTTProcessor::subscribe(const char *topic, std::function<void(const char *, const char *)> callback)
 {
-    if (!CommunicationRegistry::getInstance().hasCallback(topic))
+    if (!CommunicationRegistry::getInstance().hasFilter(topic) &&
+        !CommunicationRegistry::getInstance().registerCallback(topic, callback))
+    {
+        return false; // the registry is full or the filter invalid
+    }
+    return subscribeToTopic(topic);
+}
+
+/**
+ * @brief subscribes with a binary callback. The payload is delivered straight
+ * from the MQTT receive buffer: not copied, not NUL-terminated, and only valid
+ * for the duration of the call.
+ *
+ * @param const char * topic
+ * @param std::function<void(const char *, const uint8_t *, size_t)> callback
+ * @return true - if successful
+ */
+bool SecureMQTTProcessor::subscribe(const char *topic, std::function<void(const char *, const uint8_t *, size_t)> callback)
+{
+    if (!CommunicationRegistry::getInstance().hasFilter(topic) &&
+        !CommunicationRegistry::getInstance().registerCallback(topic, callback))
     {
-        CommunicationRegistry::getInstance().registerCallback(topic, callback);
+        return false; // the registry is full or the filter invalid
     }
-    // CommunicationRegistry::getInstance().registerCallback(topic, callback);
     return subscribeToTopic(topic);
 }
 
 bool SecureMQTTProcessor::unsubscribe(const char *topic)
 {
-    if (CommunicationRegistry::getInstance().hasCallback(topic))
+    if (CommunicationRegistry::getInstance().hasFilter(topic))
     {
         CommunicationRegistry::getInstance().unregisterCallback(topic);
         return unsubscribeToTopic(topic);
@@ -556,7 +995,10 @@ bool SecureMQTTProcessor::unsubscribe(const char *topic)
 }
 
 /**
- * @brief all subscribed topics are returned to this callback. It manages what functions are called
+ * @brief all subscribed topics are returned to this callback. Messages are
+ * handed to the inbound dispatch task so a slow callback never holds up the
+ * receive loop (and with it PINGRESP and PUBACK handling); a message too large
+ * for the inbound queue is dispatched here.
  *
  * @param char *topic
  * @param byte *payload
@@ -564,16 +1006,48 @@ bool SecureMQTTProcessor::unsubscribe(const char *topic)
  */
 void SecureMQTTProcessor::mqttCallback(char *topic, byte *payload, unsigned int length)
 {
-    // Reserve once instead of growing char-by-char: every inbound cloud message
-    // ran ~log2(len) reallocations, churning the heap. length is bounded by
-    // MQTT_MAX_PACKET_SIZE, so a single up-front allocation is cheap and safe.
-    String message;
-    message.reserve(length);
-    for (unsigned int i = 0; i < length; i++)
+    Log.verbose(F("MQTT Callback: %s (%u bytes)" CR), topic, length);
+#if INBOUND_WORKER
+    if (inboundHandle && InboundQueue::fits(topic, length))
     {
-        char c = (char)payload[i];
-        message += c;
+        if (!inbound.push(topic, payload, length))
+        {
+            Log.warningln("[inbound] queue full, dropped a message on %s", topic);
+        }
+        return;
     }
-    Serial.println("MQTT Callback: " + String(topic) + " " + message);
-    CommunicationRegistry::getInstance().triggerCallbacks(topic, message.c_str());
-}
\ No newline at end of file
+    inbound.recordInline();
+#endif
+    // Dispatch straight from PubSubClient's receive buffer: binary callbacks
+    // see the bytes in place, and only text callbacks take a terminated copy.
+    CommunicationRegistry::getInstance().triggerCallbacks(topic, payload, length);
+}
+
+// Start the inbound dispatch task once, on INBOUND_TASK_CORE
+void SecureMQTTProcessor::startInboundWorker()
+{
+#if INBOUND_WORKER
+    if (inboundHandle != nullptr)
+        return;
+
+    xTaskCreatePinnedToCore(
+        runInbound,
+        "InboundDispatch",
+        INBOUND_TASK_STACK,
+        this,
+        INBOUND_TASK_PRIORITY,
+        &inboundHandle,
+        INBOUND_TASK_CORE);
+#endif
+}
+
+void SecureMQTTProcessor::runInbound(void *param)
+{
+    SecureMQTTProcessor *processor = static_cast<SecureMQTTProcessor *>(param);
+    for (;;)
+    {
+        processor->inbound.dispatchNext([](const char *topic, const uint8_t *payload, size_t length)
+                                        { CommunicationRegistry::getInstance().triggerCallbacks(topic, payload, length); },
+                                        portMAX_DELAY);
+    }
+}
@@ -6,7 +6,10 @@
 // deterministically.
 #pragma once
 
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
@@ -62,13 +65,50 @@ class FakeProcessor : public Processor {
     publishes.emplace_back(topic ? topic : "", payload ? payload : "");
     return defaultPublish;
   }
-  bool publish(const char* topic, uint8_t*, size_t) override {
+  std::vector<std::string> binaryPayloads;  // bytes of each binary publish
+  bool publish(const char* topic, uint8_t* buf, size_t length) override {
     publishes.emplace_back(topic ? topic : "", "<binary>");
+    binaryPayloads.emplace_back((const char*)buf, length);
     return defaultPublish;
   }
 
+  // streaming publishes are recorded like the others once ended
+  std::string streamTopic, streamBody;
+  size_t streamDeclared = 0;
+  bool streaming = false;
+  size_t writeLimit = SIZE_MAX;  // bytes accepted per write() call
+  bool beginPublish(const char* topic, size_t length) override {
+    if (!defaultPublish || streaming) return false;
+    streaming = true;
+    streamTopic = topic ? topic : "";
+    streamBody.clear();
+    streamDeclared = length;
+    return true;
+  }
+  size_t write(const uint8_t* buf, size_t length) override {
+    if (!streaming) return 0;
+    size_t n = length < writeLimit ? length : writeLimit;
+    streamBody.append((const char*)buf, n);
+    return n;
+  }
+  bool endPublish() override {
+    if (!streaming) return false;
+    streaming = false;
+    if (streamBody.size() != streamDeclared) return false;
+    publishes.emplace_back(streamTopic, streamBody);
+    return true;
+  }
+
+  // text handlers by filter, so a test can deliver a message to one
+  std::map<std::string, std::function<void(const char*, const char*)>> textHandlers;
+  bool subscribe(const char* topic,
+                 std::function<void(const char*, const char*)> callback) override {
+    subscribes.emplace_back(topic ? topic : "");
+    textHandlers[topic ? topic : ""] = callback;
+    return defaultSubscribe;
+  }
   bool subscribe(const char* topic,
-                 std::function<void(const char*, const char*)>) override {
+                 std::function<void(const char*, const uint8_t*, size_t)>) override {
     subscribes.emplace_back(topic ? topic : "");
     return defaultSubscribe;
   }
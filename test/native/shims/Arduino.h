@@ -199,6 +199,20 @@ class IPAddress {
   IPAddress(uint8_t, uint8_t, uint8_t, uint8_t) {}
 };
 
+class Stream {
+ public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    int c;
+    while (n < length && (c = read()) >= 0) buffer[n++] = (char)c;
+    return n;
+  }
+};
+
 class Client {
  public:
   virtual ~Client() {}
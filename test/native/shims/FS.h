@@ -0,0 +1,128 @@
+// FS.h — native in-memory shim for the Arduino-ESP32 fs::FS / fs::File API.
+//
+// Files live in a std::map keyed by path, so tests can inspect, truncate or
+// corrupt them directly between calls (e.g. to simulate a torn write) and a
+// "reboot" is just a new owner over the same map. Only a flat root directory
+// is modelled, which is all SPIFFS has. fs::bytesRead counts every byte read,
+// so tests can bound the flash traffic of an operation.
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+inline size_t bytesRead = 0;
+
+struct MemoryNode {
+  std::string data;
+};
+
+class File {
+ public:
+  File() = default;
+  File(std::string name, std::shared_ptr<MemoryNode> node, bool writable)
+      : name_(std::move(name)), node_(std::move(node)), writable_(writable) {}
+  File(std::map<std::string, std::shared_ptr<MemoryNode>>* dir) : dir_(dir), next_(dir->begin()) {}
+
+  size_t write(const uint8_t* buf, size_t size) {
+    if (!node_ || !writable_) return 0;
+    node_->data.append((const char*)buf, size);
+    return size;
+  }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t read(uint8_t* buf, size_t size);
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  int available() { return node_ ? (int)(node_->data.size() - pos_) : 0; }
+  bool seek(uint32_t pos) {
+    if (!node_ || pos > node_->data.size()) return false;
+    pos_ = pos;
+    return true;
+  }
+  size_t position() const { return pos_; }
+  size_t size() const { return node_ ? node_->data.size() : 0; }
+  void close() {
+    node_.reset();
+    dir_ = nullptr;
+  }
+  void flush() {}
+  operator bool() const { return node_ || dir_; }
+  const char* name() const { return name_.c_str(); }
+  bool isDirectory() const { return dir_ != nullptr; }
+  File openNextFile() {
+    if (!dir_ || next_ == dir_->end()) return File();
+    auto it = next_++;
+    return File(it->first.substr(1), it->second, false);
+  }
+  String readString() {
+    if (!node_) return String();
+    std::string rest = node_->data.substr(pos_);
+    pos_ = node_->data.size();
+    return String(rest);
+  }
+
+ private:
+  std::string name_;
+  std::shared_ptr<MemoryNode> node_;
+  bool writable_ = false;
+  size_t pos_ = 0;
+  std::map<std::string, std::shared_ptr<MemoryNode>>* dir_ = nullptr;
+  std::map<std::string, std::shared_ptr<MemoryNode>>::iterator next_;
+};
+
+class FS {
+ public:
+  std::map<std::string, std::shared_ptr<MemoryNode>> files;
+
+  File open(const char* path, const char* mode = FILE_READ, bool = false) {
+    std::string p(path);
+    if (p == "/") return File(&files);
+    auto it = files.find(p);
+    if (mode[0] == 'r') {
+      return it == files.end() ? File() : File(p, it->second, false);
+    }
+    if (it == files.end()) {
+      it = files.emplace(p, std::make_shared<MemoryNode>()).first;
+    } else if (mode[0] == 'w') {
+      it->second->data.clear();
+    }
+    return File(p, it->second, true);
+  }
+  File open(const String& path, const char* mode = FILE_READ, bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path) { return files.count(path) > 0; }
+  bool remove(const char* path) { return files.erase(path) > 0; }
+  bool rename(const char* from, const char* to) {
+    auto it = files.find(from);
+    if (it == files.end()) return false;
+    files[to] = it->second;
+    files.erase(from);
+    return true;
+  }
+};
+
+}  // namespace fs
+
+inline size_t fs::File::read(uint8_t* buf, size_t size) {
+  if (!node_) return 0;
+  size_t n = std::min(size, node_->data.size() - pos_);
+  memcpy(buf, node_->data.data() + pos_, n);
+  pos_ += n;
+  bytesRead += n;
+  return n;
+}
+
+using fs::File;
+using fs::FS;
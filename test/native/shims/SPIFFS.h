@@ -0,0 +1,14 @@
+// SPIFFS.h — native shim: the global SPIFFS mount over the in-memory FS.h.
+#pragma once
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS {
+ public:
+  bool begin(bool = false) { return true; }
+  void end() {}
+  size_t totalBytes() { return 1 << 20; }
+  size_t usedBytes() { return 0; }
+};
+
+inline SPIFFSFS SPIFFS;
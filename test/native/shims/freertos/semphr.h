@@ -8,6 +8,7 @@ typedef void* SemaphoreHandle_t;
 
 inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return (void*)1; }
 inline SemaphoreHandle_t xSemaphoreCreateMutex() { return (void*)1; }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return (void*)1; }
 inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t) {
   return pdTRUE;
 }
@@ -1,7 +1,8 @@
 // Native unit tests for CommunicationRegistry — the singleton that maps MQTT
-// topics to callbacks and performs (prefix-style) wildcard matching. These lock
+// topic filters to callbacks and performs MQTT wildcard matching. These lock
 // down the public dispatch behavior that SecureMQTTProcessor relies on, in
-// particular iterateCallbacks() (used to re-subscribe every topic on reconnect).
+// particular iterateCallbacks() (used to re-subscribe every topic on reconnect),
+// and its fixed pool capacities.
 #include <unity.h>
 
 #include <string>
@@ -14,7 +15,7 @@
 static void resetRegistry() {
   auto& reg = CommunicationRegistry::getInstance();
   while (reg.getCallbackCount() > 0) {
-    std::string first = reg.getCallbacks()[0];
+    std::string first = reg.getCallbacks()[0].c_str();
     if (!reg.unregisterCallback(first)) break;  // guard against a stuck entry
   }
 }
@@ -56,6 +57,45 @@ void test_hash_wildcard_matches_prefix() {
   TEST_ASSERT_FALSE(reg.hasCallback("Hy/Post/Variable/testdevice0001/x/req1"));
 }
 
+void test_plus_wildcard_in_the_middle() {
+  auto& reg = CommunicationRegistry::getInstance();
+  std::vector<std::string> seen;
+  reg.registerCallback("Hy/+/Config", [&](const char* topic, const char*) { seen.emplace_back(topic); });
+
+  reg.triggerCallbacks("Hy/dev1/Config", "x");
+  reg.triggerCallbacks("Hy/dev1/Other", "x");
+  reg.triggerCallbacks("Hy/dev1/sub/Config", "x");
+  TEST_ASSERT_EQUAL_size_t(1, seen.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/dev1/Config", seen[0].c_str());
+}
+
+// Overlapping filters each receive the message, and an exact filter
+// registered after a wildcard covering it is kept as its own entry.
+void test_overlapping_filters_all_trigger() {
+  auto& reg = CommunicationRegistry::getInstance();
+  int wild = 0, exact = 0;
+  reg.registerCallback("a/#", [&](const char*, const char*) { wild++; });
+  reg.registerCallback("a/b", [&](const char*, const char*) { exact++; });
+  TEST_ASSERT_EQUAL_size_t(2, reg.getCallbackCount());
+  TEST_ASSERT_TRUE(reg.hasFilter("a/b"));
+  TEST_ASSERT_FALSE(reg.hasFilter("a/c"));
+
+  reg.triggerCallbacks("a/b", "x");
+  reg.triggerCallbacks("a/c", "x");
+  TEST_ASSERT_EQUAL_INT(2, wild);
+  TEST_ASSERT_EQUAL_INT(1, exact);
+
+  // unregistering is by filter, never by whatever happens to match
+  TEST_ASSERT_TRUE(reg.unregisterCallback("a/b"));
+  TEST_ASSERT_TRUE(reg.hasFilter("a/#"));
+}
+
+void test_invalid_filter_is_refused() {
+  auto& reg = CommunicationRegistry::getInstance();
+  TEST_ASSERT_FALSE(reg.registerCallback("a/#/b", noopCb()));
+  TEST_ASSERT_EQUAL_size_t(0, reg.getCallbackCount());
+}
+
 void test_no_match_does_not_trigger() {
   auto& reg = CommunicationRegistry::getInstance();
   int hits = 0;
@@ -113,14 +153,105 @@ void test_iterate_visits_every_registered_topic() {
   TEST_ASSERT_TRUE(one && two && three);
 }
 
+// Binary callbacks receive the payload bytes as-is, embedded NULs included.
+void test_binary_callback_receives_embedded_nuls() {
+  auto& reg = CommunicationRegistry::getInstance();
+  std::string seen;
+  reg.registerCallback("fw/chunk", [&](const char*, const uint8_t* data, size_t len) {
+    seen.assign((const char*)data, len);
+  });
+
+  const uint8_t chunk[] = {0x01, 0x00, 0x02, 0x00, 0x03};
+  reg.triggerCallbacks("fw/chunk", chunk, sizeof(chunk));
+  TEST_ASSERT_EQUAL_size_t(sizeof(chunk), seen.size());
+  TEST_ASSERT_EQUAL_MEMORY(chunk, seen.data(), sizeof(chunk));
+}
+
+// Text callbacks get a NUL-terminated copy even though the source buffer is
+// not terminated, for both the small (stack) and large (heap) copy paths.
+void test_text_callback_adapts_unterminated_payload() {
+  auto& reg = CommunicationRegistry::getInstance();
+  std::string seen;
+  reg.registerCallback("cfg/set", [&](const char*, const char* payload) { seen = payload; });
+
+  const char raw[] = {'a', 'b', 'c', 'X'};  // 'X' must not leak through
+  reg.triggerCallbacks("cfg/set", (const uint8_t*)raw, 3);
+  TEST_ASSERT_EQUAL_STRING("abc", seen.c_str());
+
+  std::string big(TEXT_CALLBACK_STACK_BYTES * 2, 'z');
+  big += 'X';
+  reg.triggerCallbacks("cfg/set", (const uint8_t*)big.data(), big.size() - 1);
+  TEST_ASSERT_EQUAL_size_t(TEXT_CALLBACK_STACK_BYTES * 2, seen.size());
+  TEST_ASSERT_EQUAL_INT('z', seen.back());
+}
+
+// A filter takes any number of callbacks; the only ceiling is the shared pool.
+void test_callbacks_per_filter_are_not_capped() {
+  auto& reg = CommunicationRegistry::getInstance();
+  int hits = 0;
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(reg.registerCallback("many/cb", [&](const char*, const char*) { hits++; }));
+  }
+  reg.triggerCallbacks("many/cb", "x");
+  TEST_ASSERT_EQUAL_INT(5, hits);
+  TEST_ASSERT_EQUAL_size_t(1, reg.getCallbackCount());
+  TEST_ASSERT_EQUAL_size_t(5, reg.getStats().callbacks);
+}
+
+// Full pools refuse further registrations, high-water marks survive removal
+// and freed slots are reused.
+void test_full_pools_fail_explicitly_and_report_high_water() {
+  auto& reg = CommunicationRegistry::getInstance();
+  uint32_t rejected = reg.getStats().rejected;
+  for (int i = 0; i < REGISTRY_MAX_FILTERS; i++) {
+    std::string filter = "pool/" + std::to_string(i);
+    TEST_ASSERT_TRUE(reg.registerCallback(filter, noopCb()));
+  }
+  TEST_ASSERT_FALSE(reg.registerCallback("pool/extra", noopCb()));
+  TEST_ASSERT_FALSE(reg.hasFilter("pool/extra"));
+  RegistryStats stats = reg.getStats();
+  TEST_ASSERT_EQUAL_size_t(REGISTRY_MAX_FILTERS, stats.filters);
+  TEST_ASSERT_EQUAL_size_t(REGISTRY_MAX_FILTERS, stats.filtersHighWater);
+  TEST_ASSERT_EQUAL_UINT32(rejected + 1, stats.rejected);
+  TEST_ASSERT_TRUE(stats.nodesHighWater >= REGISTRY_MAX_FILTERS + 2);  // root, "pool", one leaf each
+
+  resetRegistry();
+  stats = reg.getStats();
+  TEST_ASSERT_EQUAL_size_t(0, stats.filters);
+  TEST_ASSERT_EQUAL_size_t(0, stats.callbacks);
+  TEST_ASSERT_EQUAL_size_t(1, stats.nodes);
+  TEST_ASSERT_EQUAL_size_t(REGISTRY_MAX_FILTERS, stats.filtersHighWater);
+
+  for (int i = 0; i < REGISTRY_MAX_CALLBACKS; i++) {
+    TEST_ASSERT_TRUE(reg.registerCallback("pool/one", noopCb()));
+  }
+  TEST_ASSERT_FALSE(reg.registerCallback("pool/one", noopCb()));
+  TEST_ASSERT_FALSE(reg.registerCallback("pool/two", noopCb()));
+  TEST_ASSERT_EQUAL_size_t(REGISTRY_MAX_CALLBACKS, reg.getStats().callbacksHighWater);
+}
+
+// Only the filter order is copied per reader slot, so 30 filters with their
+// callbacks and index nodes stay within a few kilobytes.
+void test_default_footprint_stays_small() {
+  TEST_ASSERT_TRUE(sizeof(CommunicationRegistry) < 8192);
+}
+
 int main(int, char**) {
   UNITY_BEGIN();
   RUN_TEST(test_exact_match_registers_and_triggers);
   RUN_TEST(test_hash_wildcard_matches_prefix);
+  RUN_TEST(test_plus_wildcard_in_the_middle);
+  RUN_TEST(test_overlapping_filters_all_trigger);
+  RUN_TEST(test_invalid_filter_is_refused);
   RUN_TEST(test_no_match_does_not_trigger);
   RUN_TEST(test_duplicate_registration_keeps_single_entry);
   RUN_TEST(test_unregister_removes_and_decrements);
   RUN_TEST(test_unregister_unknown_returns_false);
   RUN_TEST(test_iterate_visits_every_registered_topic);
+  RUN_TEST(test_binary_callback_receives_embedded_nuls);
+  RUN_TEST(test_text_callback_adapts_unterminated_payload);
+  RUN_TEST(test_callbacks_per_filter_are_not_capped);
+  RUN_TEST(test_full_pools_fail_explicitly_and_report_high_water);
+  RUN_TEST(test_default_footprint_stays_small);
   return UNITY_END();
 }
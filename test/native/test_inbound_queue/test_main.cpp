@@ -0,0 +1,232 @@
+// Native tests for InboundQueue, the hand-off from the MQTT receive loop to
+// the dispatch task: FIFO dispatch with queue-wait stats, and the per-topic
+// overflow policies (drop-oldest, coalesce-latest, bounded block). The worker
+// is driven by calling dispatchNext() directly.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "managers/InboundQueue.h"
+#include "test_clock.h"
+
+namespace {
+struct Seen {
+  std::vector<std::string> topics;
+  std::vector<std::string> payloads;
+  std::function<void(const char*, const uint8_t*, size_t)> deliver() {
+    return [this](const char* topic, const uint8_t* payload, size_t length) {
+      topics.emplace_back(topic);
+      payloads.emplace_back((const char*)payload, length);
+    };
+  }
+};
+
+bool push(InboundQueue& q, const char* topic, const std::string& payload) {
+  return q.push(topic, (const uint8_t*)payload.data(), payload.size());
+}
+
+void drain(InboundQueue& q, Seen& seen) {
+  while (q.dispatchNext(seen.deliver())) {
+  }
+}
+}  // namespace
+
+void setUp() { setMillis(0); }
+void tearDown() {}
+
+void test_dispatches_in_order_and_records_wait() {
+  InboundQueue q;
+  Seen seen;
+  TEST_ASSERT_TRUE(push(q, "a/1", "one"));
+  advanceMillis(40);
+  TEST_ASSERT_TRUE(push(q, "a/2", "two"));
+  advanceMillis(10);
+  drain(q, seen);
+
+  TEST_ASSERT_EQUAL_size_t(2, seen.topics.size());
+  TEST_ASSERT_EQUAL_STRING("a/1", seen.topics[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("two", seen.payloads[1].c_str());
+  InboundStats stats = q.getStats();
+  TEST_ASSERT_EQUAL_UINT32(2, stats.received);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.dispatched);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.highWater);
+  TEST_ASSERT_EQUAL_UINT32(10, stats.lastWaitMs);
+  TEST_ASSERT_EQUAL_UINT32(50, stats.maxWaitMs);
+  TEST_ASSERT_FALSE(q.dispatchNext(seen.deliver()));
+}
+
+void test_drop_oldest_is_the_default() {
+  InboundQueue q;
+  Seen seen;
+  for (int i = 0; i < INBOUND_QUEUE_DEPTH + 2; i++) {
+    TEST_ASSERT_TRUE(push(q, "t", std::to_string(i)));
+  }
+  drain(q, seen);
+  TEST_ASSERT_EQUAL_size_t(INBOUND_QUEUE_DEPTH, seen.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("2", seen.payloads[0].c_str());
+  TEST_ASSERT_EQUAL_UINT32(2, q.getStats().dropped);
+}
+
+void test_coalesce_keeps_only_the_latest_per_topic() {
+  InboundQueue q;
+  Seen seen;
+  TEST_ASSERT_TRUE(q.setPolicy("cfg/", InboundPolicy::COALESCE));
+  push(q, "cfg/led", "on");
+  push(q, "cmd/x", "1");
+  push(q, "cfg/led", "off");
+  push(q, "cfg/fan", "3");
+  push(q, "cfg/led", "dim");
+  push(q, "cmd/x", "2");  // not coalesced: no rule for cmd/
+  drain(q, seen);
+
+  std::vector<std::string> expected = {"cmd/x=1", "cfg/fan=3", "cfg/led=dim", "cmd/x=2"};
+  TEST_ASSERT_EQUAL_size_t(expected.size(), seen.topics.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    std::string got = seen.topics[i] + "=" + seen.payloads[i];
+    TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), got.c_str());
+  }
+  InboundStats stats = q.getStats();
+  TEST_ASSERT_EQUAL_UINT32(2, stats.coalesced);
+  TEST_ASSERT_EQUAL_UINT32(4, stats.dispatched);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+}
+
+// Without a worker making room, a BLOCK push waits out INBOUND_BLOCK_MS and
+// the new message is the one dropped; the queued ones are kept.
+void test_block_drops_the_new_message_when_no_room_appears() {
+  InboundQueue q;
+  Seen seen;
+  q.setPolicy("", InboundPolicy::BLOCK);
+  for (int i = 0; i < INBOUND_QUEUE_DEPTH; i++) {
+    TEST_ASSERT_TRUE(push(q, "t", std::to_string(i)));
+  }
+  TEST_ASSERT_FALSE(push(q, "t", "late"));
+  InboundStats stats = q.getStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.blocked);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.dropped);
+  drain(q, seen);
+  TEST_ASSERT_EQUAL_size_t(INBOUND_QUEUE_DEPTH, seen.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("0", seen.payloads[0].c_str());
+}
+
+void test_longest_prefix_policy_applies() {
+  InboundQueue q;
+  Seen seen;
+  q.setPolicy("", InboundPolicy::BLOCK);
+  q.setPolicy("Hy/", InboundPolicy::DROP_OLDEST);
+  for (int i = 0; i < INBOUND_QUEUE_DEPTH; i++) {
+    push(q, "x", std::to_string(i));
+  }
+  TEST_ASSERT_FALSE(push(q, "x", "blocked"));
+  TEST_ASSERT_TRUE(push(q, "Hy/Get/x", "drops the oldest"));
+  drain(q, seen);
+  TEST_ASSERT_EQUAL_STRING("1", seen.payloads[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("drops the oldest", seen.payloads.back().c_str());
+}
+
+// Messages arriving while a callback runs never overwrite the one it reads.
+void test_message_in_dispatch_is_never_discarded() {
+  InboundQueue q;
+  std::string big(INBOUND_QUEUE_BYTES / 2, 'a');
+  push(q, "first", big);
+  std::string during;
+  q.dispatchNext([&](const char*, const uint8_t* payload, size_t length) {
+    TEST_ASSERT_FALSE(push(q, "second", std::string(INBOUND_QUEUE_BYTES / 2 + 8, 'b')));
+    for (int i = 0; i < INBOUND_QUEUE_DEPTH * 2; i++) push(q, "small", "s");
+    during.assign((const char*)payload, length);
+  });
+  TEST_ASSERT_TRUE(during == big);
+  TEST_ASSERT_TRUE(q.size() <= INBOUND_QUEUE_DEPTH);
+  TEST_ASSERT_TRUE(q.getStats().dropped > 0);
+}
+
+// A full ring during a slow callback still drops the oldest waiting messages,
+// just never the one the callback is reading.
+void test_drop_oldest_while_dispatching() {
+  InboundQueue q;
+  Seen seen;
+  push(q, "t", "0");
+  q.dispatchNext([&](const char*, const uint8_t*, size_t) {
+    for (int i = 1; i <= INBOUND_QUEUE_DEPTH + 2; i++) {
+      TEST_ASSERT_TRUE(push(q, "t", std::to_string(i)));
+    }
+  });
+  drain(q, seen);
+  TEST_ASSERT_EQUAL_size_t(INBOUND_QUEUE_DEPTH - 1, seen.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("4", seen.payloads[0].c_str());
+  std::string last = std::to_string(INBOUND_QUEUE_DEPTH + 2);
+  TEST_ASSERT_EQUAL_STRING(last.c_str(), seen.payloads.back().c_str());
+  TEST_ASSERT_EQUAL_UINT32(3, q.getStats().dropped);
+}
+
+// Coalescing under pressure during a callback replaces the waiting value on
+// the topic, whether slots or bytes run out, and the latest always arrives.
+void test_coalesce_while_dispatching() {
+  InboundQueue q;
+  Seen seen;
+  q.setPolicy("cfg/", InboundPolicy::COALESCE);
+  push(q, "t", "front");
+  q.dispatchNext([&](const char*, const uint8_t*, size_t) {
+    push(q, "cfg/led", "on");
+    for (int i = 0; i < INBOUND_QUEUE_DEPTH - 2; i++) push(q, "t", "filler");
+    TEST_ASSERT_TRUE(push(q, "cfg/led", "off"));
+  });
+  drain(q, seen);
+  TEST_ASSERT_EQUAL_size_t(INBOUND_QUEUE_DEPTH - 1, seen.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("cfg/led", seen.topics.back().c_str());
+  TEST_ASSERT_EQUAL_STRING("off", seen.payloads.back().c_str());
+  InboundStats stats = q.getStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.coalesced);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+
+  Seen big;
+  std::string third(INBOUND_QUEUE_BYTES / 3, 'v');
+  push(q, "t", std::string(INBOUND_QUEUE_BYTES / 2, 'f'));
+  q.dispatchNext([&](const char*, const uint8_t*, size_t) {
+    TEST_ASSERT_TRUE(push(q, "cfg/led", "a" + third));
+    TEST_ASSERT_TRUE(push(q, "cfg/led", "b" + third));
+  });
+  drain(q, big);
+  TEST_ASSERT_EQUAL_size_t(1, big.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("cfg/led", big.topics[0].c_str());
+  TEST_ASSERT_TRUE(big.payloads[0] == "b" + third);
+  TEST_ASSERT_EQUAL_UINT32(2, q.getStats().coalesced);
+  TEST_ASSERT_EQUAL_UINT32(0, q.getStats().dropped);
+}
+
+// A new message that could not fit beside the one in dispatch is dropped
+// alone; nothing waiting is evicted for it.
+void test_nothing_is_evicted_for_a_message_that_cannot_fit() {
+  InboundQueue q;
+  Seen seen;
+  push(q, "t", std::string(INBOUND_QUEUE_BYTES / 2, 'a'));
+  q.dispatchNext([&](const char*, const uint8_t*, size_t) {
+    push(q, "t", "kept");
+    TEST_ASSERT_FALSE(push(q, "t", std::string(INBOUND_QUEUE_BYTES / 2 + 8, 'b')));
+  });
+  drain(q, seen);
+  TEST_ASSERT_EQUAL_size_t(1, seen.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("kept", seen.payloads[0].c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, q.getStats().dropped);
+}
+
+void test_fits_rejects_messages_larger_than_the_arena() {
+  TEST_ASSERT_TRUE(InboundQueue::fits("t", INBOUND_QUEUE_BYTES - 3));
+  TEST_ASSERT_FALSE(InboundQueue::fits("t", INBOUND_QUEUE_BYTES - 2));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_dispatches_in_order_and_records_wait);
+  RUN_TEST(test_drop_oldest_is_the_default);
+  RUN_TEST(test_coalesce_keeps_only_the_latest_per_topic);
+  RUN_TEST(test_block_drops_the_new_message_when_no_room_appears);
+  RUN_TEST(test_longest_prefix_policy_applies);
+  RUN_TEST(test_message_in_dispatch_is_never_discarded);
+  RUN_TEST(test_drop_oldest_while_dispatching);
+  RUN_TEST(test_coalesce_while_dispatching);
+  RUN_TEST(test_nothing_is_evicted_for_a_message_that_cannot_fit);
+  RUN_TEST(test_fits_rejects_messages_larger_than_the_arena);
+  return UNITY_END();
+}
@@ -0,0 +1,240 @@
+// Native tests for JsonWriter, the fixed-buffer writer function and variable
+// results are serialized with: comma placement through nesting, string
+// escaping, integer and double formatting, overflow sizing, and a benchmark
+// of the result shape against the JsonDocument + String path it replaced.
+// Allocations are counted by replacing malloc (glibc, unsanitized builds,
+// which also sees ArduinoJson's allocator) or else the global operator new.
+#include <unity.h>
+
+#include <ArduinoJson.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "managers/JsonWriter.h"
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+
+namespace {
+size_t g_allocations = 0;
+}  // namespace
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* malloc(size_t size) {
+  g_allocations++;
+  return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+  g_allocations++;
+  return __libc_calloc(count, size);
+}
+void* realloc(void* p, size_t size) {
+  g_allocations++;
+  return __libc_realloc(p, size);
+}
+}
+#else
+void* operator new(size_t size) {
+  g_allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#endif
+
+namespace {
+void expectNumber(const char* expected, double n) {
+  char buf[48];
+  JsonWriter out(buf, sizeof(buf));
+  out.value(n);
+  TEST_ASSERT_EQUAL_STRING(expected, buf);
+}
+
+// CPU cycles where the timestamp counter is available, else nanoseconds.
+#if defined(__x86_64__) || defined(__i386__)
+const char* kTickUnit = "cycles";
+#else
+const char* kTickUnit = "ns";
+#endif
+
+uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_nesting_places_commas() {
+  char buf[128];
+  JsonWriter out(buf, sizeof(buf));
+  out.beginObject();
+  out.key("a").value(1);
+  out.key("list").beginArray().value(true).value(false).null().beginObject().endObject().endArray();
+  out.key("o").beginObject().key("x").value("y").endObject();
+  out.endObject();
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1,\"list\":[true,false,null,{}],\"o\":{\"x\":\"y\"}}", out.c_str());
+  TEST_ASSERT_EQUAL_size_t(strlen(buf), out.size());
+  TEST_ASSERT_FALSE(out.overflowed());
+}
+
+void test_strings_are_escaped() {
+  char buf[128];
+  JsonWriter out(buf, sizeof(buf));
+  out.value("q\"b\\n\nt\tr\rb\bf\f\x01/\xc3\xa9");
+  TEST_ASSERT_EQUAL_STRING("\"q\\\"b\\\\n\\nt\\tr\\rb\\bf\\f\\u0001/\xc3\xa9\"", out.c_str());
+
+  JsonWriter view(buf, sizeof(buf));
+  view.value("pump/c7", 4);  // a view, not NUL-terminated
+  TEST_ASSERT_EQUAL_STRING("\"pump\"", view.c_str());
+}
+
+void test_integers() {
+  char buf[128];
+  JsonWriter out(buf, sizeof(buf));
+  out.beginArray()
+      .value(0)
+      .value(-7)
+      .value(std::numeric_limits<int>::min())
+      .value(std::numeric_limits<long long>::min())
+      .value(std::numeric_limits<unsigned long long>::max())
+      .endArray();
+  TEST_ASSERT_EQUAL_STRING("[0,-7,-2147483648,-9223372036854775808,18446744073709551615]", out.c_str());
+}
+
+void test_doubles() {
+  expectNumber("0", 0);
+  expectNumber("3.14", 3.14);
+  expectNumber("-21.5", -21.5);
+  expectNumber("0.1", 0.1);
+  expectNumber("0.333333333", 1.0 / 3);
+  expectNumber("1", 0.9999999999);  // rounds up into the integer
+  expectNumber("1234567", 1234567);
+  expectNumber("1.2345678e7", 12345678);
+  expectNumber("1e100", 1e100);
+  expectNumber("1e-6", 1e-6);
+  expectNumber("-2.5e-8", -2.5e-8);
+  expectNumber("null", std::numeric_limits<double>::quiet_NaN());
+  expectNumber("null", -std::numeric_limits<double>::infinity());
+}
+
+void test_overflow_reports_the_size_needed() {
+  char buf[8];
+  JsonWriter out(buf, sizeof(buf));
+  out.beginObject().key("key").value("value").endObject();
+  TEST_ASSERT_TRUE(out.overflowed());
+  TEST_ASSERT_EQUAL_size_t(15, out.size());
+  TEST_ASSERT_EQUAL_STRING("{\"key\":", out.c_str());  // truncated, still terminated
+
+  char fits[16];
+  JsonWriter again(fits, sizeof(fits));
+  again.beginObject().key("key").value("value").endObject();
+  TEST_ASSERT_FALSE(again.overflowed());
+  TEST_ASSERT_EQUAL_STRING("{\"key\":\"value\"}", again.c_str());
+}
+
+// The manager's buffer API and String API agree; a long String variable that
+// does not fit RESULT_PAYLOAD_BYTES still comes back whole.
+void test_manager_results() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  String label(std::string(RESULT_PAYLOAD_BYTES, 'x'));
+  mgr.variable("label", &label);
+  mgr.function("pump", [](const char*) { return 3; });
+
+  char buf[96];
+  size_t n = mgr.runFunction("Hy/Post/Function/testdevice0001/pump/c1", "", buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("{\"key\":\"pump\",\"id\":\"testdevice0001\",\"request\":\"c1\",\"value\":3}", buf);
+  TEST_ASSERT_EQUAL_size_t(strlen(buf), n);
+  TEST_ASSERT_EQUAL_size_t(0, mgr.runFunction("Hy/Post/Function/testdevice0001/none/c1", "", buf, sizeof(buf)));
+
+  n = mgr.runVariable("Hy/Post/Variable/testdevice0001/label/c2", "", buf, sizeof(buf));
+  TEST_ASSERT_TRUE(n >= sizeof(buf));
+  String whole = mgr.runVariable("Hy/Post/Variable/testdevice0001/label/c2", "");
+  TEST_ASSERT_EQUAL_size_t(n, whole.length());
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, whole.c_str()));
+  TEST_ASSERT_EQUAL_size_t(RESULT_PAYLOAD_BYTES, strlen(doc["value"].as<const char*>()));
+}
+
+// A function result built both ways: same bytes, and the writer allocates
+// nothing. Timings are printed, not asserted.
+void test_benchmark_against_json_document() {
+  const char* key = "pump";
+  const String deviceId = "testdevice0001";
+  const char* callId = "a1b2c3d4-\"quoted\"";
+  const int rounds = 20000;
+
+  String viaDocument;
+  size_t before = g_allocations;
+  uint64_t started = ticks();
+  for (int r = 0; r < rounds; r++) {
+    JsonDocument doc;
+    doc["key"] = key;
+    doc["id"] = deviceId;
+    doc["request"] = callId;
+    doc["value"] = r;
+    viaDocument = String();
+    serializeJson(doc, viaDocument);
+  }
+  uint64_t documentTicks = (ticks() - started) / rounds;
+  size_t documentAllocations = (g_allocations - before) / rounds;
+
+  char buf[RESULT_PAYLOAD_BYTES];
+  before = g_allocations;
+  started = ticks();
+  for (int r = 0; r < rounds; r++) {
+    JsonWriter out(buf, sizeof(buf));
+    out.beginObject();
+    out.key("key").value(key);
+    out.key("id").value(deviceId.c_str(), deviceId.length());
+    out.key("request").value(callId);
+    out.key("value").value(r);
+    out.endObject();
+  }
+  uint64_t writerTicks = (ticks() - started) / rounds;
+  size_t writerAllocations = g_allocations - before;
+
+  TEST_ASSERT_EQUAL_STRING(viaDocument.c_str(), buf);
+  TEST_ASSERT_EQUAL_size_t(0, writerAllocations);
+  char line[160];
+  snprintf(line, sizeof(line), "JsonDocument + String: %zu allocations, %llu %s per result", documentAllocations,
+           (unsigned long long)documentTicks, kTickUnit);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "JsonWriter:            %zu allocations, %llu %s per result", writerAllocations,
+           (unsigned long long)writerTicks, kTickUnit);
+  TEST_MESSAGE(line);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nesting_places_commas);
+  RUN_TEST(test_strings_are_escaped);
+  RUN_TEST(test_integers);
+  RUN_TEST(test_doubles);
+  RUN_TEST(test_overflow_reports_the_size_needed);
+  RUN_TEST(test_manager_results);
+  RUN_TEST(test_benchmark_against_json_document);
+  return UNITY_END();
+}
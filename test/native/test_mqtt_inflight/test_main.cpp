@@ -0,0 +1,233 @@
+// Native tests for QoS 1 delivery: PUBLISH encoding, the inbound PacketSniffer,
+// the InflightWindow (ack matching, DUP retransmit, expiry, backpressure) and
+// the MqttClientTap that feeds the sniffer from the transport.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "processors/InflightWindow.h"
+#include "processors/MqttClientTap.h"
+#include "processors/MqttPacket.h"
+
+using namespace hyphen::mqtt;
+
+namespace {
+struct Seen {
+  uint8_t type;
+  std::vector<uint8_t> head;
+  size_t remaining;
+};
+
+void collect(PacketSniffer& sniffer, std::vector<Seen>& out) {
+  sniffer.onPacket([&out](uint8_t type, uint8_t, const uint8_t* head, size_t n,
+                          size_t remaining) {
+    out.push_back(Seen{type, std::vector<uint8_t>(head, head + n), remaining});
+  });
+}
+
+const uint8_t* bytes(const char* s) { return (const uint8_t*)s; }
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_encode_qos1_publish_layout() {
+  uint8_t out[32];
+  size_t n = encodePublish(out, sizeof(out), "a/b", bytes("hi"), 2, 1, 0x8001);
+  const uint8_t expected[] = {0x32, 9, 0, 3, 'a', '/', 'b', 0x80, 0x01, 'h', 'i'};
+  TEST_ASSERT_EQUAL_size_t(sizeof(expected), n);
+  TEST_ASSERT_EQUAL_MEMORY(expected, out, n);
+  TEST_ASSERT_EQUAL_size_t(n, publishSize(3, 2, 1));
+  TEST_ASSERT_EQUAL_size_t(0, encodePublish(out, 10, "a/b", bytes("hi"), 2, 1, 1));
+}
+
+void test_encode_multibyte_remaining_length() {
+  std::vector<uint8_t> payload(200, 'x');
+  std::vector<uint8_t> out(256);
+  size_t n = encodePublish(out.data(), out.size(), "t", payload.data(),
+                           payload.size(), 1, 7);
+  // remaining = 2 + 1 + 2 + 200 = 205 -> 0xCD 0x01
+  TEST_ASSERT_EQUAL_HEX8(0xCD, out[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, out[2]);
+  TEST_ASSERT_EQUAL_size_t(1 + 2 + 205, n);
+}
+
+void test_sniffer_finds_acks_between_split_publishes() {
+  PacketSniffer sniffer;
+  std::vector<Seen> seen;
+  collect(sniffer, seen);
+
+  std::vector<uint8_t> stream;
+  std::vector<uint8_t> payload(300, 'p');
+  std::vector<uint8_t> publish(400);
+  publish.resize(encodePublish(publish.data(), publish.size(), "in/topic",
+                               payload.data(), payload.size(), 0, 0));
+  const uint8_t connack[] = {0x20, 2, 0x01, 0x00};
+  const uint8_t puback[] = {0x40, 2, 0x80, 0x05};
+  const uint8_t pingresp[] = {0xD0, 0};
+  stream.insert(stream.end(), connack, connack + 4);
+  stream.insert(stream.end(), publish.begin(), publish.end());
+  stream.insert(stream.end(), puback, puback + 4);
+  stream.insert(stream.end(), pingresp, pingresp + 2);
+
+  // fed one byte at a time, as PubSubClient reads
+  for (uint8_t b : stream) sniffer.feed(b);
+
+  TEST_ASSERT_EQUAL_size_t(4, seen.size());
+  TEST_ASSERT_EQUAL_UINT8(CONNACK, seen[0].type);
+  TEST_ASSERT_EQUAL_HEX8(0x01, seen[0].head[0]);  // session present
+  TEST_ASSERT_EQUAL_UINT8(PUBLISH, seen[1].type);
+  TEST_ASSERT_EQUAL_size_t(publish.size() - 3, seen[1].remaining);
+  TEST_ASSERT_EQUAL_size_t(PacketSniffer::kHeadBytes, seen[1].head.size());
+  TEST_ASSERT_EQUAL_UINT8(PUBACK, seen[2].type);
+  TEST_ASSERT_EQUAL_HEX8(0x80, seen[2].head[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x05, seen[2].head[1]);
+  TEST_ASSERT_EQUAL_UINT8(13, seen[3].type);
+}
+
+void test_window_pipelines_and_matches_acks() {
+  InflightWindow<512, 4> window;
+  InflightWindow<512, 4>::Packet p[4];
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(window.add("t", bytes("x"), 1, 0, p[i]));
+  }
+  TEST_ASSERT_TRUE(window.full());
+  TEST_ASSERT_FALSE(window.add("t", bytes("x"), 1, 0, p[0]));
+  TEST_ASSERT_EQUAL_UINT32(1, window.stats().rejected);
+  TEST_ASSERT_EQUAL_HEX16(0x8000, p[0].id);
+  TEST_ASSERT_EQUAL_HEX16(0x8003, p[3].id);
+
+  // out-of-order ack settles its slot; the ring frees once the head is acked
+  TEST_ASSERT_TRUE(window.ack(p[1].id, 40));
+  TEST_ASSERT_EQUAL_size_t(4, window.size());
+  TEST_ASSERT_TRUE(window.ack(p[0].id, 60));
+  TEST_ASSERT_EQUAL_size_t(2, window.size());
+  TEST_ASSERT_FALSE(window.ack(p[0].id, 70));  // duplicate PUBACK ignored
+
+  TEST_ASSERT_EQUAL_UINT32(2, window.stats().acked);
+  TEST_ASSERT_EQUAL_UINT32(60, window.stats().maxAckMs);
+  TEST_ASSERT_EQUAL_UINT32(50, window.stats().averageAckMs());
+}
+
+void test_window_retransmits_with_dup_then_expires() {
+  InflightWindow<512, 4> window;
+  InflightWindow<512, 4>::Packet p;
+  window.add("t", bytes("x"), 1, 0, p);
+  TEST_ASSERT_EQUAL_HEX8(0x32, p.data[0]);
+
+  std::vector<std::vector<uint8_t>> writes;
+  auto write = [&](const uint8_t* data, size_t n) {
+    writes.emplace_back(data, data + n);
+    return true;
+  };
+  TEST_ASSERT_EQUAL_size_t(0, window.service(999, 1000, 2, write));
+  TEST_ASSERT_EQUAL_size_t(1, window.service(1000, 1000, 2, write));
+  TEST_ASSERT_EQUAL_HEX8(0x3A, writes[0][0]);  // DUP set
+  TEST_ASSERT_EQUAL_size_t(p.length, writes[0].size());
+  window.service(2000, 1000, 2, write);
+  TEST_ASSERT_EQUAL_UINT32(2, window.stats().retransmits);
+
+  window.service(3000, 1000, 2, write);  // limit reached: given up
+  TEST_ASSERT_EQUAL_size_t(2, writes.size());
+  TEST_ASSERT_EQUAL_UINT32(1, window.stats().expired);
+  TEST_ASSERT_TRUE(window.empty());
+}
+
+void test_expedite_resends_everything_now() {
+  InflightWindow<512, 4> window;
+  InflightWindow<512, 4>::Packet p;
+  window.add("a", bytes("1"), 1, 500, p);
+  window.add("b", bytes("2"), 1, 500, p);
+  window.expedite(600, 1000);
+  size_t resent = window.service(600, 1000, 3,
+                                 [](const uint8_t*, size_t) { return true; });
+  TEST_ASSERT_EQUAL_size_t(2, resent);
+}
+
+void test_cancel_forgets_unsent_packet() {
+  InflightWindow<512, 4> window;
+  InflightWindow<512, 4>::Packet p;
+  window.add("t", bytes("x"), 1, 0, p);
+  window.cancel(p.id);
+  TEST_ASSERT_TRUE(window.empty());
+  TEST_ASSERT_EQUAL_UINT32(0, window.stats().published);
+}
+
+void test_packet_ids_wrap_within_upper_range() {
+  InflightWindow<64, 1> window;
+  InflightWindow<64, 1>::Packet p;
+  uint16_t last = 0;
+  for (uint32_t i = 0; i < 0x8001; i++) {
+    window.add("t", bytes(""), 0, 0, p);
+    window.ack(p.id, 0);
+    last = p.id;
+  }
+  TEST_ASSERT_EQUAL_HEX16(0x8000, last);
+}
+
+namespace {
+// Transport double that replays a scripted inbound stream.
+class ScriptedClient : public Client {
+ public:
+  std::vector<uint8_t> inbound;
+  std::vector<uint8_t> written;
+  size_t pos = 0;
+  int connect(IPAddress, uint16_t) override { return 1; }
+  int connect(const char*, uint16_t) override { return 1; }
+  size_t write(uint8_t b) override {
+    written.push_back(b);
+    return 1;
+  }
+  size_t write(const uint8_t* buf, size_t n) override {
+    written.insert(written.end(), buf, buf + n);
+    return n;
+  }
+  int available() override { return (int)(inbound.size() - pos); }
+  int read() override { return pos < inbound.size() ? inbound[pos++] : -1; }
+  int read(uint8_t* buf, size_t n) override {
+    size_t k = 0;
+    while (k < n && pos < inbound.size()) buf[k++] = inbound[pos++];
+    return (int)k;
+  }
+  int peek() override { return pos < inbound.size() ? inbound[pos] : -1; }
+  void flush() override {}
+  void stop() override {}
+  uint8_t connected() override { return 1; }
+  operator bool() override { return true; }
+};
+}  // namespace
+
+void test_tap_passes_bytes_through_and_sniffs_reads() {
+  ScriptedClient inner;
+  inner.inbound = {0x40, 2, 0x80, 0x00, 0x40, 2, 0x80, 0x01};
+  MqttClientTap tap;
+  tap.attach(inner);
+  std::vector<uint16_t> acked;
+  tap.onPacket([&](uint8_t type, uint8_t, const uint8_t* head, size_t n, size_t) {
+    if (type == PUBACK && n >= 2) acked.push_back((uint16_t)(head[0] << 8 | head[1]));
+  });
+
+  uint8_t buf[8];
+  TEST_ASSERT_EQUAL_INT(0x40, tap.read());
+  TEST_ASSERT_EQUAL_INT(7, tap.read(buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_size_t(2, acked.size());
+  TEST_ASSERT_EQUAL_HEX16(0x8001, acked[1]);
+
+  TEST_ASSERT_EQUAL_size_t(3, tap.write(bytes("abc"), 3));
+  TEST_ASSERT_EQUAL_size_t(3, inner.written.size());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_encode_qos1_publish_layout);
+  RUN_TEST(test_encode_multibyte_remaining_length);
+  RUN_TEST(test_sniffer_finds_acks_between_split_publishes);
+  RUN_TEST(test_window_pipelines_and_matches_acks);
+  RUN_TEST(test_window_retransmits_with_dup_then_expires);
+  RUN_TEST(test_expedite_resends_everything_now);
+  RUN_TEST(test_cancel_forgets_unsent_packet);
+  RUN_TEST(test_packet_ids_wrap_within_upper_range);
+  RUN_TEST(test_tap_passes_bytes_through_and_sniffs_reads);
+  return UNITY_END();
+}
@@ -0,0 +1,307 @@
+// Native tests for the flash-backed Outbox on the in-memory SPIFFS shim:
+// append and in-order drain, recovery from the read cursor after a reboot,
+// torn and corrupted records, the disk cap dropping the oldest segment, the
+// drain-rate limit, and records that cannot be allocated or that change while
+// one is being published. A reboot is a new Outbox over the same files.
+#include <unity.h>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "SPIFFS.h"
+#include "managers/Outbox.h"
+#include "test_clock.h"
+
+// The largest array the code under test asked for, to catch a buffer sized
+// from a damaged length.
+// Arrays above g_arrayLimit fail, as a large record would on a fragmented heap.
+namespace {
+size_t g_largestArray = 0;
+size_t g_arrayLimit = SIZE_MAX;
+}  // namespace
+
+void* operator new[](size_t size) {
+  if (size > g_largestArray) g_largestArray = size;
+  void* p = size > g_arrayLimit ? nullptr : malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return operator new[](size);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+namespace {
+struct Sent {
+  std::vector<std::string> topics;
+  std::vector<std::string> payloads;
+  bool accept = true;
+  std::function<bool(const char*, const uint8_t*, size_t)> publisher() {
+    return [this](const char* topic, const uint8_t* payload, size_t length) {
+      if (!accept) return false;
+      topics.emplace_back(topic);
+      payloads.emplace_back((const char*)payload, length);
+      return true;
+    };
+  }
+};
+
+bool enqueue(Outbox& box, const char* topic, const std::string& payload) {
+  return box.enqueue(topic, (const uint8_t*)payload.data(), payload.size());
+}
+
+// Drains everything, a second of rate allowance at a time.
+void drainAll(Outbox& box, Sent& sent) {
+  for (int i = 0; i < 10000 && !box.empty(); i++) {
+    advanceMillis(1000);
+    box.drain(sent.publisher());
+  }
+}
+
+std::string segment(uint32_t n) {
+  char path[24];
+  snprintf(path, sizeof(path), OUTBOX_PATH_PREFIX "%08lx", (unsigned long)n);
+  return path;
+}
+}  // namespace
+
+void setUp() {
+  SPIFFS.files.clear();
+  g_arrayLimit = SIZE_MAX;
+  setMillis(1000);
+}
+void tearDown() {}
+
+void test_append_then_drain_in_order() {
+  Outbox box;
+  TEST_ASSERT_TRUE(box.begin());
+  TEST_ASSERT_TRUE(box.empty());
+  TEST_ASSERT_TRUE(enqueue(box, "a/1", "one"));
+  TEST_ASSERT_TRUE(enqueue(box, "a/2", ""));
+  TEST_ASSERT_TRUE(enqueue(box, "a/3", "three"));
+  TEST_ASSERT_EQUAL_UINT32(3, box.getDepth());
+
+  Sent sent;
+  sent.accept = false;  // a rejected record stays at the head
+  advanceMillis(1000);
+  TEST_ASSERT_EQUAL_size_t(0, box.drain(sent.publisher()));
+  sent.accept = true;
+  TEST_ASSERT_EQUAL_size_t(3, box.drain(sent.publisher()));
+
+  std::vector<std::string> expected = {"a/1=one", "a/2=", "a/3=three"};
+  TEST_ASSERT_EQUAL_size_t(expected.size(), sent.topics.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    std::string got = sent.topics[i] + "=" + sent.payloads[i];
+    TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), got.c_str());
+  }
+  TEST_ASSERT_TRUE(box.empty());
+  TEST_ASSERT_EQUAL_UINT32(3, box.getDrained());
+  TEST_ASSERT_FALSE(SPIFFS.exists(segment(0).c_str()));  // drained segments are deleted
+}
+
+// Records drained since the last cursor write are replayed after a reboot
+// (at-least-once); nothing is skipped and order holds across the restart.
+void test_reboot_resumes_from_the_cursor() {
+  {
+    Outbox box;
+    for (int i = 0; i < 20; i++) {
+      enqueue(box, "t", std::to_string(i));
+    }
+    Sent sent;
+    advanceMillis(1000);
+    box.drain(sent.publisher());
+    advanceMillis(1000);
+    box.drain(sent.publisher());
+    TEST_ASSERT_EQUAL_size_t(10, sent.payloads.size());
+  }
+  Outbox rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin());
+  TEST_ASSERT_EQUAL_UINT32(20 - OUTBOX_CURSOR_SYNC, rebooted.getDepth());
+  enqueue(rebooted, "t", "after");
+
+  Sent sent;
+  drainAll(rebooted, sent);
+  TEST_ASSERT_EQUAL_size_t(20 - OUTBOX_CURSOR_SYNC + 1, sent.payloads.size());
+  std::string first = std::to_string(OUTBOX_CURSOR_SYNC);
+  TEST_ASSERT_EQUAL_STRING(first.c_str(), sent.payloads[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("19", sent.payloads[sent.payloads.size() - 2].c_str());
+  TEST_ASSERT_EQUAL_STRING("after", sent.payloads.back().c_str());
+
+  Outbox again;
+  again.begin();
+  TEST_ASSERT_TRUE(again.empty());
+}
+
+// A record cut short by power loss is not counted or replayed, and later
+// records go to a fresh segment instead of after it.
+void test_torn_tail_record_is_skipped() {
+  {
+    Outbox box;
+    enqueue(box, "t", "kept-1");
+    enqueue(box, "t", "kept-2");
+    enqueue(box, "t", "torn");
+  }
+  std::string& bytes = SPIFFS.files[segment(0)]->data;
+  bytes.resize(bytes.size() - 2);
+
+  Outbox rebooted;
+  rebooted.begin();
+  TEST_ASSERT_EQUAL_UINT32(2, rebooted.getDepth());
+  enqueue(rebooted, "t", "new");
+  TEST_ASSERT_TRUE(SPIFFS.exists(segment(1).c_str()));
+  Sent sent;
+  drainAll(rebooted, sent);
+  TEST_ASSERT_EQUAL_size_t(3, sent.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("kept-2", sent.payloads[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("new", sent.payloads[2].c_str());
+}
+
+// A header whose magic survived but whose lengths did not is treated as torn;
+// nothing is allocated from the bogus length.
+void test_corrupted_header_lengths_are_not_trusted() {
+  Outbox box;
+  enqueue(box, "t", "good");
+  enqueue(box, "t", "bad");
+  std::string& bytes = SPIFFS.files[segment(0)]->data;
+  size_t second = 12 + 1 + 4;  // header + "t" + "good"
+  uint32_t huge = 0xFFFFFFF0u;
+  memcpy(&bytes[second + 4], &huge, sizeof(huge));  // payloadLength
+
+  g_largestArray = 0;
+  Sent sent;
+  drainAll(box, sent);
+  TEST_ASSERT_TRUE(g_largestArray <= OUTBOX_SEGMENT_BYTES);
+  TEST_ASSERT_EQUAL_size_t(1, sent.payloads.size());
+  TEST_ASSERT_EQUAL_STRING("good", sent.payloads[0].c_str());
+  TEST_ASSERT_TRUE(box.empty());
+}
+
+// Past OUTBOX_MAX_BYTES whole segments are dropped from the head; what is
+// left is the newest records, still in order.
+void test_disk_cap_drops_the_oldest_segment() {
+  Outbox box;
+  std::string payload(OUTBOX_SEGMENT_BYTES / 2 - 32, 'p');
+  const int records = 2 * OUTBOX_MAX_BYTES / OUTBOX_SEGMENT_BYTES * 2;
+  for (int i = 0; i < records; i++) {
+    TEST_ASSERT_TRUE(enqueue(box, std::to_string(i).c_str(), payload));
+    TEST_ASSERT_TRUE(box.getBytes() <= OUTBOX_MAX_BYTES);
+  }
+  uint32_t dropped = box.getDropped();
+  TEST_ASSERT_TRUE(dropped > 0);
+  TEST_ASSERT_EQUAL_UINT32(records - dropped, box.getDepth());
+
+  Sent sent;
+  drainAll(box, sent);
+  TEST_ASSERT_EQUAL_size_t(records - dropped, sent.topics.size());
+  for (size_t i = 0; i < sent.topics.size(); i++) {
+    std::string expected = std::to_string(dropped + i);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), sent.topics[i].c_str());
+  }
+}
+
+void test_drain_is_rate_limited() {
+  Outbox box;
+  for (int i = 0; i < 20; i++) {
+    enqueue(box, "t", std::to_string(i));
+  }
+  Sent sent;
+  TEST_ASSERT_EQUAL_size_t(0, box.drain(sent.publisher()));
+  advanceMillis(1000);
+  TEST_ASSERT_EQUAL_size_t(OUTBOX_DRAIN_PER_SECOND, box.drain(sent.publisher()));
+  TEST_ASSERT_EQUAL_size_t(0, box.drain(sent.publisher()));
+  advanceMillis(1000 / OUTBOX_DRAIN_PER_SECOND);
+  TEST_ASSERT_EQUAL_size_t(1, box.drain(sent.publisher()));
+  advanceMillis(60000);  // an idle minute does not bank a burst
+  TEST_ASSERT_EQUAL_size_t(OUTBOX_DRAIN_PER_SECOND, box.drain(sent.publisher()));
+}
+
+// Draining a segment reads each record about once, not the rest of the
+// segment after every record.
+void test_draining_a_segment_reads_it_once() {
+  Outbox box;
+  int records = 0;
+  while (box.getBytes() + 64 < OUTBOX_SEGMENT_BYTES) {
+    enqueue(box, "t/reading", "21.5");
+    records++;
+  }
+  fs::bytesRead = 0;
+  Sent sent;
+  drainAll(box, sent);
+  TEST_ASSERT_EQUAL_size_t(records, sent.payloads.size());
+  TEST_ASSERT_TRUE(fs::bytesRead < 2 * OUTBOX_SEGMENT_BYTES);
+}
+
+// A record too large to allocate is dropped instead of stalling the drain.
+void test_record_that_cannot_be_allocated_is_skipped() {
+  Outbox box;
+  enqueue(box, "a", "1");
+  enqueue(box, "b", std::string(512, 'x'));
+  enqueue(box, "c", "3");
+  g_arrayLimit = 256;
+  Sent sent;
+  drainAll(box, sent);
+  TEST_ASSERT_TRUE((sent.topics == std::vector<std::string>{"a", "c"}));
+  TEST_ASSERT_EQUAL_UINT32(1, box.getDropped());
+  TEST_ASSERT_EQUAL_UINT32(0, box.getDepth());
+}
+
+// The publisher runs outside the lock, so records may be appended, or the
+// oldest segment dropped, while one is being sent.
+void test_changes_made_while_publishing_are_kept() {
+  Outbox box;
+  enqueue(box, "0", "x");
+  int appended = 1;
+  Sent sent;
+  auto publish = sent.publisher();
+  auto appending = [&](const char* topic, const uint8_t* payload, size_t length) {
+    if (appended < 4) enqueue(box, std::to_string(appended++).c_str(), "x");
+    return publish(topic, payload, length);
+  };
+  for (int i = 0; i < 10 && !box.empty(); i++) {
+    advanceMillis(1000);
+    box.drain(appending);
+  }
+  TEST_ASSERT_TRUE((sent.topics == std::vector<std::string>{"0", "1", "2", "3"}));
+
+  // fill the disk while the head record is out: its segment is dropped
+  std::string payload(OUTBOX_SEGMENT_BYTES / 2 - 32, 'p');
+  enqueue(box, "head", "x");
+  bool filled = false;
+  auto filling = [&](const char* topic, const uint8_t* payload2, size_t length) {
+    for (int i = 0; !filled && i < 2 * OUTBOX_MAX_BYTES / OUTBOX_SEGMENT_BYTES * 2; i++) {
+      enqueue(box, "fill", payload);
+    }
+    filled = true;
+    return publish(topic, payload2, length);
+  };
+  advanceMillis(1000);
+  box.drain(filling);
+  uint32_t depth = box.getDepth();
+  TEST_ASSERT_TRUE(box.getDropped() > 0);
+  size_t before = sent.topics.size();
+  drainAll(box, sent);
+  TEST_ASSERT_EQUAL_size_t(depth, sent.topics.size() - before);
+  TEST_ASSERT_EQUAL_UINT32(0, box.getDepth());
+  TEST_ASSERT_EQUAL_STRING("fill", sent.topics.back().c_str());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_append_then_drain_in_order);
+  RUN_TEST(test_reboot_resumes_from_the_cursor);
+  RUN_TEST(test_torn_tail_record_is_skipped);
+  RUN_TEST(test_corrupted_header_lengths_are_not_trusted);
+  RUN_TEST(test_disk_cap_drops_the_oldest_segment);
+  RUN_TEST(test_drain_is_rate_limited);
+  RUN_TEST(test_draining_a_segment_reads_it_once);
+  RUN_TEST(test_record_that_cannot_be_allocated_is_skipped);
+  RUN_TEST(test_changes_made_while_publishing_are_kept);
+  return UNITY_END();
+}
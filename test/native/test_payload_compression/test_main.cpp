@@ -0,0 +1,187 @@
+// Native tests for optional payload compression: LZ4 blocks that decode back
+// to the input (repetitive JSON, incompressible bytes, long literal and match
+// runs, tiny inputs), the one-byte envelope PayloadCompressor wraps them in,
+// and the SubscriptionManager publishes that go through it.
+#include <unity.h>
+
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "managers/PayloadCompressor.h"
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+
+using namespace hyphen;
+
+namespace {
+uint16_t table[1u << 10];
+
+std::string roundTrip(const std::string& input, size_t* compressedSize = nullptr) {
+  std::vector<uint8_t> block(lz4::bound(input.size()));
+  size_t n = lz4::compress<10>((const uint8_t*)input.data(), input.size(), block.data(), block.size(), table);
+  if (compressedSize) *compressedSize = n;
+  std::string out(input.size() + 16, '\0');
+  size_t m = lz4::decompress(block.data(), n, (uint8_t*)&out[0], out.size());
+  out.resize(m);
+  return out;
+}
+
+std::string telemetry(size_t readings) {
+  std::string json = "[";
+  for (size_t i = 0; i < readings; i++) {
+    json += (i ? "," : "");
+    json += "{\"sensor\":\"soil_moisture\",\"unit\":\"percent\",\"value\":" + std::to_string(40 + i % 7) + "}";
+  }
+  return json + "]";
+}
+
+// Decodes a PayloadCompressor envelope.
+std::string open(const std::string& wire) {
+  const uint8_t* p = (const uint8_t*)wire.data();
+  if (wire.empty() || p[0] < PayloadCompressor::STORED) return wire;
+  if (p[0] == PayloadCompressor::STORED) return wire.substr(1);
+  size_t length = 0, at = 1;
+  for (int shift = 0;; shift += 7) {
+    length |= (size_t)(p[at] & 0x7F) << shift;
+    if (!(p[at++] & 0x80)) break;
+  }
+  std::string out(length, '\0');
+  size_t n = lz4::decompress(p + at, wire.size() - at, (uint8_t*)&out[0], length);
+  return n == length ? out : std::string("<corrupt>");
+}
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trips_and_shrinks_json() {
+  std::string json = telemetry(40);
+  size_t n = 0;
+  TEST_ASSERT_TRUE(roundTrip(json, &n) == json);
+  TEST_ASSERT_TRUE(n < json.size() / 4);
+}
+
+void test_round_trips_incompressible_and_edge_inputs() {
+  std::mt19937 rng(7);
+  std::string noise(3000, '\0');
+  for (char& c : noise) c = (char)rng();
+  size_t n = 0;
+  TEST_ASSERT_TRUE(roundTrip(noise, &n) == noise);
+  TEST_ASSERT_TRUE(n <= lz4::bound(noise.size()));
+
+  TEST_ASSERT_TRUE(roundTrip("") == "");
+  TEST_ASSERT_TRUE(roundTrip("abc") == "abc");
+  TEST_ASSERT_TRUE(roundTrip("aaaaaaaaaaaaa") == "aaaaaaaaaaaaa");  // just past the match limit
+  std::string run(5000, 'z');                                       // one match longer than 255 * 15
+  TEST_ASSERT_TRUE(roundTrip(run, &n) == run);
+  TEST_ASSERT_TRUE(n < 40);
+  std::string mixed = noise.substr(0, 300) + run + noise.substr(300, 20);  // long literal runs around it
+  TEST_ASSERT_TRUE(roundTrip(mixed) == mixed);
+}
+
+void test_compress_fails_cleanly_when_output_is_too_small() {
+  std::string json = telemetry(10);
+  uint8_t small[16];
+  TEST_ASSERT_EQUAL_size_t(0, lz4::compress<10>((const uint8_t*)json.data(), json.size(), small, sizeof(small), table));
+}
+
+void test_decompress_rejects_bad_offsets() {
+  const uint8_t block[] = {0x14, 'a', 0x05, 0x00};  // one literal, then an offset past it
+  uint8_t out[32];
+  TEST_ASSERT_EQUAL_size_t(0, lz4::decompress(block, sizeof(block), out, sizeof(out)));
+}
+
+void test_envelope_only_when_it_pays() {
+  PayloadCompressor c;
+  std::string sent;
+  auto send = [&](const uint8_t* p, size_t n) {
+    sent.assign((const char*)p, n);
+    return true;
+  };
+  std::string json = telemetry(20);
+  TEST_ASSERT_TRUE(c.send((const uint8_t*)json.data(), json.size(), send));
+  TEST_ASSERT_TRUE(sent == json);  // disabled
+
+  c.enable(64);
+  c.send((const uint8_t*)json.data(), json.size(), send);
+  TEST_ASSERT_EQUAL_HEX8(PayloadCompressor::COMPRESSED, (uint8_t)sent[0]);
+  TEST_ASSERT_TRUE(open(sent) == json);
+
+  c.send((const uint8_t*)"{\"v\":1}", 7, send);  // under the threshold
+  TEST_ASSERT_EQUAL_STRING("{\"v\":1}", sent.c_str());
+
+  std::mt19937 rng(3);
+  std::string noise(200, '\0');
+  for (char& ch : noise) ch = (char)rng();
+  noise[0] = 'n';
+  c.send((const uint8_t*)noise.data(), noise.size(), send);
+  TEST_ASSERT_TRUE(sent == noise);  // did not shrink
+
+  const uint8_t marked[] = {0xFF, 1, 2};
+  c.send(marked, sizeof(marked), send);
+  TEST_ASSERT_EQUAL_size_t(4, sent.size());
+  TEST_ASSERT_EQUAL_HEX8(PayloadCompressor::STORED, (uint8_t)sent[0]);
+  TEST_ASSERT_TRUE(open(sent) == std::string((const char*)marked, 3));
+
+  CompressionStats stats = c.getStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.compressed);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.stored);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.escaped);
+  TEST_ASSERT_EQUAL_UINT64(json.size(), stats.bytesIn);
+  TEST_ASSERT_TRUE(stats.ratioPercent() < 30);
+}
+
+// Compression costs no RAM until it is enabled, and the envelope is sent
+// outside the lock: a sender may publish through the same compressor.
+void test_table_is_allocated_on_enable_and_send_is_unlocked() {
+  TEST_ASSERT_TRUE(sizeof(PayloadCompressor) < 256);
+  PayloadCompressor c;
+  TEST_ASSERT_TRUE(c.enable(64));
+  std::string json = telemetry(20);
+  std::vector<std::string> sent;
+  std::function<bool(const uint8_t*, size_t)> send = [&](const uint8_t* p, size_t n) {
+    sent.emplace_back((const char*)p, n);
+    if (sent.size() == 1) c.send((const uint8_t*)json.data(), json.size(), send);
+    return true;
+  };
+  c.send((const uint8_t*)json.data(), json.size(), send);
+  TEST_ASSERT_EQUAL_size_t(2, sent.size());
+  TEST_ASSERT_TRUE(open(sent[0]) == json);
+  TEST_ASSERT_TRUE(open(sent[1]) == json);
+  c.disable();
+  c.send((const uint8_t*)json.data(), json.size(), send);
+  TEST_ASSERT_TRUE(sent.back() == json);
+}
+
+void test_manager_publishes_compressed_payloads() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  std::string json = telemetry(30);
+  mgr.publishTopic("Hy/Post/Telemetry", (uint8_t*)json.data(), json.size());
+  TEST_ASSERT_TRUE(proc.binaryPayloads.back() == json);
+
+  mgr.enableCompression(128);
+  mgr.publishTopic("Hy/Post/Telemetry", (uint8_t*)json.data(), json.size());
+  TEST_ASSERT_TRUE(proc.binaryPayloads.back().size() < json.size() / 4);
+  TEST_ASSERT_TRUE(open(proc.binaryPayloads.back()) == json);
+
+  mgr.publishTopic(String("Hy/Post/Small"), String("{\"ok\":1}"));
+  TEST_ASSERT_EQUAL_STRING("{\"ok\":1}", proc.publishes.back().second.c_str());  // text publish kept
+  mgr.publishTopic(String("Hy/Post/Big"), String(json.c_str()));
+  TEST_ASSERT_TRUE(open(proc.binaryPayloads.back()) == json);
+  TEST_ASSERT_EQUAL_UINT32(2, mgr.getCompressionStats().compressed);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trips_and_shrinks_json);
+  RUN_TEST(test_round_trips_incompressible_and_edge_inputs);
+  RUN_TEST(test_compress_fails_cleanly_when_output_is_too_small);
+  RUN_TEST(test_decompress_rejects_bad_offsets);
+  RUN_TEST(test_envelope_only_when_it_pays);
+  RUN_TEST(test_table_is_allocated_on_enable_and_send_is_unlocked);
+  RUN_TEST(test_manager_publishes_compressed_payloads);
+  return UNITY_END();
+}
@@ -0,0 +1,236 @@
+// Native tests for the non-blocking publish path: publishAsync() only copies
+// into the bounded queue; SubscriptionManager::loop() does the (blocking)
+// publish and completes each message with a receipt. Also covers the priority
+// lanes and the fixed-arena MessageRing the queue is built on.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "managers/MessageRing.h"
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+#include "test_clock.h"
+
+void setUp() { setMillis(0); }
+void tearDown() {}
+
+void test_publishAsync_does_not_publish_inline() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Post/Data", "{\"a\":1}"));
+  TEST_ASSERT_EQUAL_size_t(0, proc.publishes.size());  // nothing on the radio yet
+
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(1, proc.publishes.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/Post/Data", proc.publishes[0].first.c_str());
+}
+
+void test_completion_reports_sent_with_latency() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  std::vector<PublishReceipt> receipts;
+
+  mgr.publishAsync("t/one", "x", [&](const PublishReceipt& r) { receipts.push_back(r); });
+  advanceMillis(150);
+  mgr.loop();
+
+  TEST_ASSERT_EQUAL_size_t(1, receipts.size());
+  TEST_ASSERT_EQUAL_INT((int)PublishResult::SENT, (int)receipts[0].result);
+  TEST_ASSERT_EQUAL_UINT32(0, receipts[0].enqueuedAt);
+  TEST_ASSERT_EQUAL_UINT32(150, receipts[0].queuedMs());
+  TEST_ASSERT_EQUAL_UINT32(1, mgr.getPublishQueueStats().sent);
+}
+
+void test_completion_reports_failure() {
+  FakeProcessor proc;
+  proc.defaultPublish = false;
+  SubscriptionManager mgr(proc);
+  PublishResult seen = PublishResult::SENT;
+
+  mgr.publishAsync("t/one", "x", [&](const PublishReceipt& r) { seen = r.result; });
+  mgr.loop();
+
+  TEST_ASSERT_EQUAL_INT((int)PublishResult::FAILED, (int)seen);
+  TEST_ASSERT_EQUAL_UINT32(1, mgr.getPublishQueueStats().failed);
+}
+
+void test_waits_while_offline_then_times_out() {
+  FakeProcessor proc;
+  proc.defaultConnected = false;
+  proc.defaultMaintain = true;
+  SubscriptionManager mgr(proc);
+  PublishResult seen = PublishResult::SENT;
+  int calls = 0;
+
+  mgr.publishAsync("t/one", "x", [&](const PublishReceipt& r) {
+    seen = r.result;
+    calls++;
+  });
+  mgr.loop();
+  TEST_ASSERT_EQUAL_INT(0, calls);  // held while the session is down
+
+  advanceMillis(PUBLISH_ASYNC_TIMEOUT_MS + 1);
+  mgr.loop();
+  TEST_ASSERT_EQUAL_INT(1, calls);
+  TEST_ASSERT_EQUAL_INT((int)PublishResult::TIMEOUT, (int)seen);
+  TEST_ASSERT_EQUAL_size_t(0, proc.publishes.size());
+}
+
+void test_full_queue_rejects_without_callback() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int calls = 0;
+  for (int i = 0; i < PUBLISH_QUEUE_DEPTH; i++) {
+    TEST_ASSERT_TRUE(mgr.publishAsync("t", "x"));
+  }
+  TEST_ASSERT_FALSE(mgr.publishAsync("t", "x", [&](const PublishReceipt&) { calls++; }));
+  TEST_ASSERT_EQUAL_INT(0, calls);
+  TEST_ASSERT_EQUAL_UINT32(1, mgr.getPublishQueueStats().rejected);
+  TEST_ASSERT_EQUAL_UINT32(PUBLISH_QUEUE_DEPTH, mgr.getPublishQueueStats().highWater);
+}
+
+void test_drains_in_order_bounded_per_loop() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  for (int i = 0; i < PUBLISH_QUEUE_DRAIN_PER_LOOP + 2; i++) {
+    std::string payload = std::to_string(i);
+    mgr.publishAsync("t", payload.c_str());
+  }
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(PUBLISH_QUEUE_DRAIN_PER_LOOP, proc.publishes.size());
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(PUBLISH_QUEUE_DRAIN_PER_LOOP + 2, proc.publishes.size());
+  for (size_t i = 0; i < proc.publishes.size(); i++) {
+    TEST_ASSERT_EQUAL_STRING("<binary>", proc.publishes[i].second.c_str());
+  }
+}
+
+namespace {
+std::vector<std::string> drainTopics(PublishQueue& q, size_t limit = 16) {
+  std::vector<std::string> topics;
+  q.drain(limit, [] { return true; }, [&](const char* t, const uint8_t*, size_t) {
+    topics.emplace_back(t);
+    return true;
+  });
+  return topics;
+}
+}  // namespace
+
+void test_lanes_drain_strictly_by_priority() {
+  PublishQueue q;
+  q.push("bulk", (const uint8_t*)"b", 1, nullptr, PublishPriority::BULK);
+  q.push("tele", (const uint8_t*)"t", 1, nullptr);
+  q.push("alarm", (const uint8_t*)"a", 1, nullptr, PublishPriority::ALARM);
+  q.push("ctrl", (const uint8_t*)"c", 1, nullptr, PublishPriority::CONTROL);
+  q.push("tele2", (const uint8_t*)"t", 1, nullptr);
+
+  TEST_ASSERT_TRUE((drainTopics(q, 2) == std::vector<std::string>{"ctrl", "alarm"}));
+  q.push("ctrl2", (const uint8_t*)"c", 1, nullptr, PublishPriority::CONTROL);
+  TEST_ASSERT_TRUE((drainTopics(q) == std::vector<std::string>{"ctrl2", "tele", "tele2", "bulk"}));
+}
+
+void test_waiting_lower_lane_is_not_starved() {
+  PublishQueue q;
+  q.push("bulk", (const uint8_t*)"b", 1, nullptr, PublishPriority::BULK);
+  advanceMillis(PUBLISH_LANE_MAX_WAIT_MS - 1);
+  q.push("ctrl", (const uint8_t*)"c", 1, nullptr, PublishPriority::CONTROL);
+  TEST_ASSERT_TRUE((drainTopics(q, 1) == std::vector<std::string>{"ctrl"}));
+
+  q.push("ctrl", (const uint8_t*)"c", 1, nullptr, PublishPriority::CONTROL);
+  advanceMillis(1);
+  TEST_ASSERT_TRUE((drainTopics(q, 1) == std::vector<std::string>{"bulk"}));
+  PublishLaneStats bulk = q.getStats().lanes[(size_t)PublishPriority::BULK];
+  TEST_ASSERT_EQUAL_UINT32(1, bulk.promoted);
+  TEST_ASSERT_EQUAL_UINT32(PUBLISH_LANE_MAX_WAIT_MS, bulk.lastWaitMs);
+}
+
+void test_full_lane_does_not_block_other_lanes() {
+  PublishQueue q;
+  for (int i = 0; i < PUBLISH_QUEUE_DEPTH; i++) {
+    TEST_ASSERT_TRUE(q.push("b", (const uint8_t*)"x", 1, nullptr, PublishPriority::BULK));
+  }
+  TEST_ASSERT_FALSE(q.push("b", (const uint8_t*)"x", 1, nullptr, PublishPriority::BULK));
+  TEST_ASSERT_TRUE(q.push("c", (const uint8_t*)"x", 1, nullptr, PublishPriority::CONTROL));
+
+  PublishQueueStats s = q.getStats();
+  TEST_ASSERT_EQUAL_UINT32(PUBLISH_QUEUE_DEPTH, s.lanes[(size_t)PublishPriority::BULK].depth);
+  TEST_ASSERT_EQUAL_UINT32(1, s.lanes[(size_t)PublishPriority::BULK].rejected);
+  TEST_ASSERT_EQUAL_UINT32(1, s.lanes[(size_t)PublishPriority::CONTROL].depth);
+  TEST_ASSERT_EQUAL_UINT32(PUBLISH_QUEUE_DEPTH + 1, s.highWater);
+}
+
+// The ring wraps around its arena and never hands out overlapping space.
+void test_message_ring_wraps_without_corruption() {
+  struct Meta {
+    int seq = 0;
+  };
+  MessageRing<64, 8, Meta> ring;
+  int pushed = 0, popped = 0;
+  for (int round = 0; round < 50; round++) {
+    std::string payload(5 + round % 9, (char)('a' + round % 26));
+    while (ring.push("tp", (const uint8_t*)payload.data(), payload.size(), Meta{pushed})) {
+      pushed++;
+    }
+    TEST_ASSERT_FALSE(ring.empty());
+    auto v = ring.front();
+    TEST_ASSERT_EQUAL_INT(popped, v.meta->seq);
+    TEST_ASSERT_EQUAL_STRING("tp", v.topic);
+    TEST_ASSERT_EQUAL_INT(0, v.payload[v.length]);  // NUL-terminated in place
+    ring.pop();
+    popped++;
+  }
+  while (!ring.empty()) {
+    TEST_ASSERT_EQUAL_INT(popped++, ring.front().meta->seq);
+    ring.pop();
+  }
+  TEST_ASSERT_EQUAL_INT(pushed, popped);
+  TEST_ASSERT_EQUAL_size_t(64, ring.freeBytes());
+}
+
+// Erasing a later entry moves the ones after it down without disturbing the
+// front, and its bytes are free again at once.
+void test_message_ring_erase_compacts_behind_the_front() {
+  struct Meta {
+    int seq = 0;
+  };
+  MessageRing<64, 8, Meta> ring;
+  std::string payload(10, 'x');
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(ring.push("tp", (const uint8_t*)payload.data(), payload.size(), Meta{i}));
+  }
+  ring.pop();  // entries now start a record in, and wrap on the next push
+  TEST_ASSERT_TRUE(ring.push("tp", (const uint8_t*)"wrapped", 7, Meta{4}));
+  const char* front = ring.front().topic;
+  size_t before = ring.freeBytes();
+  ring.erase(1);
+  TEST_ASSERT_TRUE(front == ring.front().topic);
+  TEST_ASSERT_EQUAL_size_t(3, ring.size());
+  TEST_ASSERT_TRUE(ring.freeBytes() > before);
+  int expected[] = {1, 3, 4};
+  for (int seq : expected) {
+    auto v = ring.front();
+    TEST_ASSERT_EQUAL_INT(seq, v.meta->seq);
+    TEST_ASSERT_EQUAL_STRING("tp", v.topic);
+    TEST_ASSERT_EQUAL_INT(0, v.payload[v.length]);
+    ring.pop();
+  }
+  TEST_ASSERT_EQUAL_size_t(64, ring.largestFree(1));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_publishAsync_does_not_publish_inline);
+  RUN_TEST(test_completion_reports_sent_with_latency);
+  RUN_TEST(test_completion_reports_failure);
+  RUN_TEST(test_waits_while_offline_then_times_out);
+  RUN_TEST(test_full_queue_rejects_without_callback);
+  RUN_TEST(test_drains_in_order_bounded_per_loop);
+  RUN_TEST(test_lanes_drain_strictly_by_priority);
+  RUN_TEST(test_waiting_lower_lane_is_not_starved);
+  RUN_TEST(test_full_lane_does_not_block_other_lanes);
+  RUN_TEST(test_message_ring_wraps_without_corruption);
+  RUN_TEST(test_message_ring_erase_compacts_behind_the_front);
+  return UNITY_END();
+}
@@ -0,0 +1,217 @@
+// Native tests for publish coalescing: PublishBatcher envelope format and
+// flush triggers (size, window, explicit), plus the SubscriptionManager wiring
+// that flushes due batches from loop().
+#include <unity.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "managers/PublishBatcher.h"
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+#include "test_clock.h"
+
+namespace {
+std::vector<std::pair<std::string, std::string>> sent;
+bool sendOk = true;
+
+bool record(const char* topic, const uint8_t* payload, size_t length) {
+  if (!sendOk) return false;
+  sent.emplace_back(topic, std::string((const char*)payload, length));
+  return true;
+}
+
+bool add(PublishBatcher& b, const char* topic, const char* payload) {
+  return b.add(topic, (const uint8_t*)payload, strlen(payload), record);
+}
+}  // namespace
+
+void setUp() {
+  setMillis(0);
+  sent.clear();
+  sendOk = true;
+}
+void tearDown() {}
+
+void test_same_topic_coalesces_into_array() {
+  PublishBatcher b;
+  b.configure(256, 1000);
+  TEST_ASSERT_TRUE(add(b, "t/a", "{\"v\":1}"));
+  TEST_ASSERT_TRUE(add(b, "t/a", "[2]"));
+  TEST_ASSERT_TRUE(add(b, "t/a", "plain \"text\""));
+  TEST_ASSERT_EQUAL_size_t(0, sent.size());
+  TEST_ASSERT_EQUAL_size_t(3, b.pending());
+
+  TEST_ASSERT_TRUE(b.flush(record));
+  TEST_ASSERT_EQUAL_size_t(1, sent.size());
+  TEST_ASSERT_EQUAL_STRING("t/a", sent[0].first.c_str());
+  TEST_ASSERT_EQUAL_STRING("[{\"v\":1},[2],\"plain \\\"text\\\"\"]", sent[0].second.c_str());
+  TEST_ASSERT_EQUAL_size_t(0, b.pending());
+}
+
+void test_batch_topic_wraps_entries_with_their_topic() {
+  PublishBatcher b;
+  b.configure(256, 1000, "t/batch");
+  add(b, "t/a", "{\"v\":1}");
+  add(b, "t/b", "2");
+  b.flush(record);
+  TEST_ASSERT_EQUAL_size_t(1, sent.size());
+  TEST_ASSERT_EQUAL_STRING("t/batch", sent[0].first.c_str());
+  TEST_ASSERT_EQUAL_STRING(
+      "[{\"topic\":\"t/a\",\"payload\":{\"v\":1}},{\"topic\":\"t/b\",\"payload\":\"2\"}]",
+      sent[0].second.c_str());
+}
+
+void test_size_limit_flushes_before_overflow() {
+  PublishBatcher b;
+  b.configure(16, 1000);
+  add(b, "t", "{\"a\":1}");  // [{"a":1}       -> 8 bytes open
+  add(b, "t", "{\"b\":2}");  // would close at 17 > 16: first batch goes out
+  TEST_ASSERT_EQUAL_size_t(1, sent.size());
+  TEST_ASSERT_EQUAL_STRING("[{\"a\":1}]", sent[0].second.c_str());
+  TEST_ASSERT_EQUAL_size_t(1, b.pending());
+  TEST_ASSERT_EQUAL_UINT32(1, b.getStats().sizeFlushes);
+  for (auto& p : sent) TEST_ASSERT_TRUE(p.second.size() <= 16);
+}
+
+void test_oversized_message_passes_through() {
+  PublishBatcher b;
+  b.configure(8, 1000);
+  add(b, "t", "{\"long\":12345}");
+  TEST_ASSERT_EQUAL_size_t(1, sent.size());
+  TEST_ASSERT_EQUAL_STRING("{\"long\":12345}", sent[0].second.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, b.getStats().passthrough);
+}
+
+void test_oversized_message_follows_its_topics_open_batch() {
+  PublishBatcher b;
+  b.configure(16, 1000);
+  add(b, "t", "{}");
+  add(b, "u", "{}");
+  add(b, "t", "{\"long\":1234567}");
+  TEST_ASSERT_EQUAL_size_t(2, sent.size());
+  TEST_ASSERT_EQUAL_STRING("[{}]", sent[0].second.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"long\":1234567}", sent[1].second.c_str());
+  TEST_ASSERT_EQUAL_size_t(1, b.pending());  // "u" is left alone
+  TEST_ASSERT_EQUAL_UINT32(1, b.getStats().passthrough);
+}
+
+void test_window_flush_only_when_due() {
+  PublishBatcher b;
+  b.configure(256, 1000);
+  add(b, "t", "{}");
+  advanceMillis(999);
+  b.poll(record);
+  TEST_ASSERT_EQUAL_size_t(0, sent.size());
+  advanceMillis(1);
+  b.poll(record);
+  TEST_ASSERT_EQUAL_size_t(1, sent.size());
+  TEST_ASSERT_EQUAL_UINT32(1, b.getStats().windowFlushes);
+}
+
+void test_failed_flush_keeps_messages() {
+  PublishBatcher b;
+  b.configure(256, 1000);
+  add(b, "t", "{\"a\":1}");
+  sendOk = false;
+  TEST_ASSERT_FALSE(b.flush(record));
+  TEST_ASSERT_EQUAL_size_t(1, b.pending());
+  sendOk = true;
+  add(b, "t", "{\"b\":2}");
+  TEST_ASSERT_TRUE(b.flush(record));
+  TEST_ASSERT_EQUAL_STRING("[{\"a\":1},{\"b\":2}]", sent[0].second.c_str());
+}
+
+// Envelopes are sent outside the batcher's lock: a sender may publish
+// through the same batcher, as an inline callback does.
+void test_sender_can_publish_through_the_batcher() {
+  PublishBatcher b;
+  b.configure(256, 1000);
+  add(b, "t", "{\"a\":1}");
+  int calls = 0;
+  bool added = false;
+  auto sender = [&](const char* topic, const uint8_t* payload, size_t length) {
+    if (calls++ == 0) added = add(b, "t", "{\"b\":2}");
+    return record(topic, payload, length);
+  };
+  TEST_ASSERT_TRUE(b.flush(sender));
+  TEST_ASSERT_TRUE(added);
+  TEST_ASSERT_EQUAL_size_t(1, sent.size());
+  TEST_ASSERT_EQUAL_STRING("[{\"a\":1}]", sent[0].second.c_str());
+  TEST_ASSERT_EQUAL_size_t(1, b.pending());
+  b.flush(record);
+  TEST_ASSERT_EQUAL_STRING("[{\"b\":2}]", sent[1].second.c_str());
+}
+
+// A failed envelope goes back ahead of what its topic gathered during the
+// send, so order holds once it is retried.
+void test_failed_send_is_restored_ahead_of_newer_messages() {
+  PublishBatcher b;
+  b.configure(256, 1000);
+  add(b, "t", "{\"a\":1}");
+  auto failing = [&](const char*, const uint8_t*, size_t) {
+    add(b, "t", "{\"b\":2}");
+    return false;
+  };
+  TEST_ASSERT_FALSE(b.flush(failing));
+  TEST_ASSERT_EQUAL_size_t(2, b.pending());
+  TEST_ASSERT_TRUE(b.flush(record));
+  TEST_ASSERT_EQUAL_STRING("[{\"a\":1},{\"b\":2}]", sent[0].second.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, b.getStats().failed);
+  TEST_ASSERT_EQUAL_UINT32(0, b.getStats().lost);
+}
+
+void test_new_topic_beyond_capacity_flushes_oldest() {
+  PublishBatcher b;
+  b.configure(256, 100000);
+  char topic[16];
+  for (int i = 0; i < PUBLISH_BATCH_TOPICS; i++) {
+    snprintf(topic, sizeof(topic), "t/%d", i);
+    add(b, topic, "{}");
+    advanceMillis(10);
+  }
+  TEST_ASSERT_EQUAL_size_t(0, sent.size());
+  add(b, "t/new", "{}");
+  TEST_ASSERT_EQUAL_size_t(1, sent.size());
+  TEST_ASSERT_EQUAL_STRING("t/0", sent[0].first.c_str());
+}
+
+void test_manager_flushes_due_batches_from_loop() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  mgr.enableBatching(256, 1000);
+  TEST_ASSERT_TRUE(mgr.publishBatched("Hy/Post/Data", "{\"a\":1}"));
+  TEST_ASSERT_TRUE(mgr.publishBatched("Hy/Post/Data", "{\"a\":2}"));
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(0, proc.publishes.size());
+
+  advanceMillis(1000);
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(1, proc.publishes.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/Post/Data", proc.publishes[0].first.c_str());
+  TEST_ASSERT_EQUAL_UINT32(2, mgr.getBatchStats().messages);
+
+  // disabling flushes, and later publishes go straight out
+  mgr.publishBatched("Hy/Post/Data", "{}");
+  TEST_ASSERT_TRUE(mgr.disableBatching());
+  TEST_ASSERT_EQUAL_size_t(2, proc.publishes.size());
+  mgr.publishBatched("Hy/Post/Data", "{}");
+  TEST_ASSERT_EQUAL_size_t(3, proc.publishes.size());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_topic_coalesces_into_array);
+  RUN_TEST(test_batch_topic_wraps_entries_with_their_topic);
+  RUN_TEST(test_size_limit_flushes_before_overflow);
+  RUN_TEST(test_oversized_message_passes_through);
+  RUN_TEST(test_oversized_message_follows_its_topics_open_batch);
+  RUN_TEST(test_window_flush_only_when_due);
+  RUN_TEST(test_failed_flush_keeps_messages);
+  RUN_TEST(test_sender_can_publish_through_the_batcher);
+  RUN_TEST(test_failed_send_is_restored_ahead_of_newer_messages);
+  RUN_TEST(test_new_topic_beyond_capacity_flushes_oldest);
+  RUN_TEST(test_manager_flushes_due_batches_from_loop);
+  return UNITY_END();
+}
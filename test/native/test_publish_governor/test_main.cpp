@@ -0,0 +1,298 @@
+// Native tests for PublishGovernor: per-topic token buckets and the periodic
+// data budget only apply on metered links, over-limit publishes follow their
+// policy, deferred ones are released by SubscriptionManager::loop() and async
+// publishes are governed as they leave the queue.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "managers/PublishGovernor.h"
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+#include "test_clock.h"
+
+namespace {
+const uint32_t kEpoch = 1700000000;  // any synced clock
+const uint32_t kPeriod = DATA_BUDGET_PERIOD_DAYS * 86400UL;
+
+GovernorVerdict admit(PublishGovernor& g, const char* topic, const char* payload,
+                      uint32_t epoch = kEpoch) {
+  return g.admit(topic, (const uint8_t*)payload, strlen(payload), epoch);
+}
+
+// MQTT bytes for one QoS 0 publish
+uint32_t wire(const char* topic, const char* payload) {
+  return hyphen::mqtt::publishSize(strlen(topic), strlen(payload), 0);
+}
+
+size_t releaseInto(PublishGovernor& g, std::vector<std::string>& out, uint32_t epoch = kEpoch) {
+  return g.release(16, epoch, [&](const char*, const uint8_t* p, size_t n) {
+    out.emplace_back((const char*)p, n);
+    return true;
+  });
+}
+}  // namespace
+
+void setUp() { setMillis(0); }
+void tearDown() {}
+
+void test_unmetered_link_is_never_limited() {
+  PublishGovernor g;
+  g.limitTopic("t", 1, 1, ThrottlePolicy::REJECT);
+  g.setBudget(1, ThrottlePolicy::REJECT);
+  for (int i = 0; i < 5; i++) TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "t", "x"));
+  TEST_ASSERT_EQUAL_UINT32(0, g.getStats().budgetUsed);
+}
+
+void test_bucket_allows_burst_then_refills() {
+  PublishGovernor g;
+  g.setMetered(true);
+  g.limitTopic("Hy/Post/Telemetry", 0.5f, 2, ThrottlePolicy::REJECT);
+
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Telemetry/a", "1"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Telemetry/a", "2"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::REJECTED, (int)admit(g, "Hy/Post/Telemetry/a", "3"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Other", "x"));  // no rule
+
+  advanceMillis(1999);
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::REJECTED, (int)admit(g, "Hy/Post/Telemetry/a", "4"));
+  advanceMillis(1);
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Telemetry/a", "5"));
+  TEST_ASSERT_EQUAL_UINT32(2, g.getStats().rejected);
+}
+
+void test_longest_prefix_rule_applies() {
+  PublishGovernor g;
+  g.setMetered(true);
+  g.limitTopic("Hy/", 100, 100, ThrottlePolicy::REJECT);
+  g.limitTopic("Hy/Post/Debug", 1, 1, ThrottlePolicy::REJECT);
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Debug", "a"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::REJECTED, (int)admit(g, "Hy/Post/Debug", "b"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Data", "c"));
+}
+
+void test_deferred_messages_release_in_order_as_tokens_return() {
+  PublishGovernor g;
+  g.setMetered(true);
+  g.limitTopic("t", 1, 1, ThrottlePolicy::DEFER);
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "t", "a"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::DEFERRED, (int)admit(g, "t", "b"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::DEFERRED, (int)admit(g, "t", "c"));
+
+  std::vector<std::string> sent;
+  TEST_ASSERT_EQUAL_size_t(0, releaseInto(g, sent));
+  advanceMillis(1000);
+  TEST_ASSERT_EQUAL_size_t(1, releaseInto(g, sent));
+  advanceMillis(1000);
+  TEST_ASSERT_EQUAL_size_t(1, releaseInto(g, sent));
+  TEST_ASSERT_EQUAL_size_t(0, g.held());
+  TEST_ASSERT_TRUE((sent == std::vector<std::string>{"b", "c"}));
+}
+
+void test_held_messages_only_hold_back_their_own_topic_or_rule() {
+  PublishGovernor g;
+  g.setMetered(true);
+  g.limitTopic("Hy/Post/Telemetry", 1, 1, ThrottlePolicy::DEFER);
+  g.limitTopic("Hy/Post/Debug", 0.5f, 1, ThrottlePolicy::DEFER);
+  admit(g, "Hy/Post/Telemetry/a", "t1");
+  admit(g, "Hy/Post/Debug", "d1");
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::DEFERRED, (int)admit(g, "Hy/Post/Debug", "d2"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::DEFERRED, (int)admit(g, "Hy/Post/Telemetry/a", "t2"));
+  // no rule and nothing of its own held: not held back by the others
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Other", "x"));
+
+  // telemetry refills first and goes out past the debug message still held
+  advanceMillis(1000);
+  // same rule as the held t2, so it waits its turn even with a token back
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::DEFERRED, (int)admit(g, "Hy/Post/Telemetry/b", "t3"));
+  std::vector<std::string> sent;
+  TEST_ASSERT_EQUAL_size_t(1, releaseInto(g, sent));
+  TEST_ASSERT_TRUE((sent == std::vector<std::string>{"t2"}));
+  advanceMillis(1000);
+  TEST_ASSERT_EQUAL_size_t(2, releaseInto(g, sent));
+  TEST_ASSERT_TRUE((sent == std::vector<std::string>{"t2", "d2", "t3"}));
+  TEST_ASSERT_EQUAL_size_t(0, g.held());
+}
+
+void test_full_hold_rejects_or_drops_oldest() {
+  PublishGovernor defer;
+  defer.setMetered(true);
+  defer.limitTopic("t", 1, 1, ThrottlePolicy::DEFER);
+  PublishGovernor drop;
+  drop.setMetered(true);
+  drop.limitTopic("t", 1, 1, ThrottlePolicy::DROP_OLDEST);
+  admit(defer, "t", "first");
+  admit(drop, "t", "first");
+
+  for (int i = 0; i < GOVERNOR_DEFER_DEPTH; i++) {
+    std::string p = std::to_string(i);
+    admit(defer, "t", p.c_str());
+    admit(drop, "t", p.c_str());
+  }
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::REJECTED, (int)admit(defer, "t", "late"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::DEFERRED, (int)admit(drop, "t", "late"));
+  TEST_ASSERT_EQUAL_UINT32(1, drop.getStats().dropped);
+
+  std::vector<std::string> sent;
+  advanceMillis(1000UL * (GOVERNOR_DEFER_DEPTH + 1));
+  for (int i = 0; i <= GOVERNOR_DEFER_DEPTH; i++) {
+    releaseInto(drop, sent);
+    advanceMillis(1000);
+  }
+  TEST_ASSERT_EQUAL_STRING("1", sent.front().c_str());  // "0" was dropped
+  TEST_ASSERT_EQUAL_STRING("late", sent.back().c_str());
+}
+
+void test_streams_cannot_be_deferred() {
+  PublishGovernor g;
+  g.setMetered(true);
+  g.limitTopic("t", 1, 1, ThrottlePolicy::DEFER);
+  admit(g, "t", "a");
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::REJECTED, (int)g.admit("t", nullptr, 4096, kEpoch, false));
+}
+
+void test_budget_counts_wire_bytes_until_exhausted() {
+  PublishGovernor g;
+  g.setMetered(true);
+  uint32_t one = wire("Hy/Post/Data", "0123456789");
+  g.setBudget(one * 2, ThrottlePolicy::REJECT);
+
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Data", "0123456789"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "Hy/Post/Data", "0123456789"));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::REJECTED, (int)admit(g, "Hy/Post/Data", "0"));
+  GovernorStats s = g.getStats();
+  TEST_ASSERT_EQUAL_UINT32(one * 2, s.budgetUsed);
+  TEST_ASSERT_EQUAL_UINT32(0, s.budgetRemaining());
+}
+
+void test_budget_period_rolls_on_its_boundary() {
+  PublishGovernor g;
+  g.setMetered(true);
+  uint32_t one = wire("t", "x");
+  g.setBudget(one, ThrottlePolicy::REJECT);
+  g.restoreBudget(one, kEpoch);  // exhausted, as persisted before a reboot
+
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::REJECTED, (int)admit(g, "t", "x", kEpoch + kPeriod - 1));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND, (int)admit(g, "t", "x", kEpoch + kPeriod * 2 + 50));
+
+  uint32_t used, start;
+  TEST_ASSERT_TRUE(g.takeBudgetSync(used, start));
+  TEST_ASSERT_EQUAL_UINT32(one, used);
+  TEST_ASSERT_EQUAL_UINT32(kEpoch + kPeriod * 2, start);  // still the billing day
+}
+
+void test_budget_sync_is_throttled() {
+  PublishGovernor g;
+  g.setMetered(true);
+  g.setBudget(1000000, ThrottlePolicy::REJECT);
+  uint32_t used, start;
+  admit(g, "t", "x", 0);  // no clock yet: usage counts, period unknown
+  TEST_ASSERT_FALSE(g.takeBudgetSync(used, start));
+
+  std::string big(DATA_BUDGET_SYNC_BYTES, 'b');
+  g.admit("t", (const uint8_t*)big.data(), big.size(), 0);
+  TEST_ASSERT_TRUE(g.takeBudgetSync(used, start));
+  TEST_ASSERT_EQUAL_UINT32(0, start);
+  TEST_ASSERT_FALSE(g.takeBudgetSync(used, start));
+
+  admit(g, "t", "x", kEpoch);  // the first synced clock starts the period
+  TEST_ASSERT_TRUE(g.takeBudgetSync(used, start));
+  TEST_ASSERT_EQUAL_UINT32(kEpoch, start);
+}
+
+void test_manager_loop_releases_deferred_publishes() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  mgr.setMetered(true);
+  mgr.limitTopic("Hy/Post/Telemetry", 1, 1);
+
+  const uint8_t payload[] = {0x01, 0x02, 0x03};
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::SEND,
+                        (int)mgr.govern("Hy/Post/Telemetry", payload, 3));
+  TEST_ASSERT_EQUAL_INT((int)GovernorVerdict::DEFERRED,
+                        (int)mgr.govern("Hy/Post/Telemetry", payload, 3));
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(0, proc.publishes.size());
+  advanceMillis(1000);
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(1, proc.publishes.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/Post/Telemetry", proc.publishes[0].first.c_str());
+}
+
+// publishAsync() copies first and is governed when its turn comes: over a
+// deferring limit the message keeps its place, over a rejecting one it
+// completes as REFUSED.
+void test_async_publishes_are_governed_from_the_queue() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  mgr.setMetered(true);
+  mgr.limitTopic("Hy/Post/Telemetry", 1, 1);
+  mgr.limitTopic("Hy/Post/Debug", 1, 1, ThrottlePolicy::REJECT);
+
+  std::vector<PublishResult> debug;
+  auto note = [&](const PublishReceipt& r) { debug.push_back(r.result); };
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Post/Telemetry", "a"));
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Post/Telemetry", "b"));
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(1, proc.publishes.size());
+  TEST_ASSERT_EQUAL_size_t(1, mgr.getPublishQueueStats().lanes[(size_t)PublishPriority::TELEMETRY].depth);
+
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Post/Debug", "1", note, PublishPriority::ALARM));
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Post/Debug", "2", note, PublishPriority::ALARM));
+  advanceMillis(1000);
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(2, debug.size());
+  TEST_ASSERT_EQUAL_INT((int)PublishResult::SENT, (int)debug[0]);
+  TEST_ASSERT_EQUAL_INT((int)PublishResult::REFUSED, (int)debug[1]);
+  TEST_ASSERT_EQUAL_size_t(3, proc.publishes.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/Post/Telemetry", proc.publishes[2].first.c_str());
+  PublishQueueStats stats = mgr.getPublishQueueStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.refused);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.timedOut);
+  TEST_ASSERT_EQUAL_UINT32(0, mgr.getGovernorStats().deferred);  // never copied into the hold
+}
+
+void test_deferred_promoted_lane_does_not_block_control() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  mgr.setMetered(true);
+  mgr.limitTopic("Hy/Post/Telemetry", 0.1f, 1);
+
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Post/Telemetry", "a"));
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Post/Telemetry", "b"));
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(1, proc.publishes.size());
+
+  // "b" is now past PUBLISH_LANE_MAX_WAIT_MS and goes first, but its bucket
+  // is still empty; the reply behind it must not wait on that
+  advanceMillis(PUBLISH_LANE_MAX_WAIT_MS + 1000);
+  TEST_ASSERT_TRUE(mgr.publishAsync("Hy/Result/Function", "ok", nullptr, PublishPriority::CONTROL));
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(2, proc.publishes.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/Result/Function", proc.publishes[1].first.c_str());
+  TEST_ASSERT_EQUAL_size_t(1, mgr.getPublishQueueStats().lanes[(size_t)PublishPriority::TELEMETRY].depth);
+
+  advanceMillis(10000);
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(3, proc.publishes.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/Post/Telemetry", proc.publishes[2].first.c_str());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unmetered_link_is_never_limited);
+  RUN_TEST(test_bucket_allows_burst_then_refills);
+  RUN_TEST(test_longest_prefix_rule_applies);
+  RUN_TEST(test_deferred_messages_release_in_order_as_tokens_return);
+  RUN_TEST(test_held_messages_only_hold_back_their_own_topic_or_rule);
+  RUN_TEST(test_full_hold_rejects_or_drops_oldest);
+  RUN_TEST(test_streams_cannot_be_deferred);
+  RUN_TEST(test_budget_counts_wire_bytes_until_exhausted);
+  RUN_TEST(test_budget_period_rolls_on_its_boundary);
+  RUN_TEST(test_budget_sync_is_throttled);
+  RUN_TEST(test_manager_loop_releases_deferred_publishes);
+  RUN_TEST(test_async_publishes_are_governed_from_the_queue);
+  RUN_TEST(test_deferred_promoted_lane_does_not_block_control);
+  return UNITY_END();
+}
@@ -0,0 +1,106 @@
+// Native tests for streaming publish: SubscriptionManager::publishStream()
+// pushes a payload of any size through Processor::beginPublish/write/
+// endPublish in fixed chunks, and fails cleanly when the source runs short.
+#include <unity.h>
+
+#include <string>
+
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+#include "test_clock.h"
+
+namespace {
+// Stream over an in-memory string, standing in for a SPIFFS File.
+class StringStream : public Stream {
+ public:
+  explicit StringStream(std::string data) : data_(std::move(data)) {}
+  int available() override { return (int)(data_.size() - pos_); }
+  int read() override { return pos_ < data_.size() ? (uint8_t)data_[pos_++] : -1; }
+  int peek() override { return pos_ < data_.size() ? (uint8_t)data_[pos_] : -1; }
+  size_t readBytes(char* buffer, size_t length) override {
+    reads++;
+    size_t n = std::min(length, data_.size() - pos_);
+    memcpy(buffer, data_.data() + pos_, n);
+    pos_ += n;
+    largestRead = std::max(largestRead, length);
+    return n;
+  }
+  int reads = 0;
+  size_t largestRead = 0;
+
+ private:
+  std::string data_;
+  size_t pos_ = 0;
+};
+}  // namespace
+
+void setUp() { setMillis(0); }
+void tearDown() {}
+
+void test_stream_larger_than_chunk_is_sent_whole() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  std::string body(MQTT_STREAM_CHUNK_BYTES * 5 + 17, '\0');
+  for (size_t i = 0; i < body.size(); i++) body[i] = (char)(i * 31);
+  StringStream file(body);
+
+  TEST_ASSERT_TRUE(mgr.publishStream("Hy/Post/Frame", file, body.size()));
+  TEST_ASSERT_EQUAL_size_t(1, proc.publishes.size());
+  TEST_ASSERT_EQUAL_STRING("Hy/Post/Frame", proc.publishes[0].first.c_str());
+  TEST_ASSERT_TRUE(proc.publishes[0].second == body);
+  TEST_ASSERT_EQUAL_INT(6, file.reads);
+  TEST_ASSERT_EQUAL_size_t(MQTT_STREAM_CHUNK_BYTES, file.largestRead);  // constant RAM
+}
+
+void test_partial_processor_writes_are_resumed() {
+  FakeProcessor proc;
+  proc.writeLimit = 7;
+  SubscriptionManager mgr(proc);
+  std::string body(100, 'z');
+  StringStream file(body);
+  TEST_ASSERT_TRUE(mgr.publishStream("t", file, body.size()));
+  TEST_ASSERT_TRUE(proc.publishes[0].second == body);
+}
+
+void test_short_source_fails_the_publish() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  StringStream file("only ten b");
+  TEST_ASSERT_FALSE(mgr.publishStream("t", file, 64));
+  TEST_ASSERT_EQUAL_size_t(0, proc.publishes.size());
+  TEST_ASSERT_FALSE(proc.streaming);  // the stream was still ended
+}
+
+void test_reader_callback_source() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  size_t produced = 0;
+  const size_t total = 1500;
+  bool ok = mgr.publishStream("t", total, [&](uint8_t* buf, size_t capacity) {
+    size_t n = std::min(capacity, total - produced);
+    memset(buf, 'r', n);
+    produced += n;
+    return n;
+  });
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_EQUAL_size_t(total, proc.publishes[0].second.size());
+}
+
+void test_refused_begin_reads_nothing() {
+  FakeProcessor proc;
+  proc.defaultPublish = false;
+  SubscriptionManager mgr(proc);
+  StringStream file("data");
+  TEST_ASSERT_FALSE(mgr.publishStream("t", file, 4));
+  TEST_ASSERT_EQUAL_INT(0, file.reads);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stream_larger_than_chunk_is_sent_whole);
+  RUN_TEST(test_partial_processor_writes_are_resumed);
+  RUN_TEST(test_short_source_fails_the_publish);
+  RUN_TEST(test_reader_callback_source);
+  RUN_TEST(test_refused_begin_reads_nothing);
+  return UNITY_END();
+}
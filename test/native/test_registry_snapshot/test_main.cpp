@@ -0,0 +1,154 @@
+// Native tests for the snapshot-read CommunicationRegistry: dispatch reads an
+// immutable version without locking while another thread subscribes and
+// unsubscribes, every dispatch still reaches its callback exactly once, and a
+// version is reused only once no reader holds it (under ASan, a use-after-free
+// fails the run). Dispatch latency with and without churn is printed, not asserted.
+//
+// The native FreeRTOS shim's mutex is a no-op, so these tests keep to a single
+// writer thread, which is also how the firmware uses the registry.
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "managers/CommunicationRegistry.h"
+
+static void resetRegistry() {
+  auto& reg = CommunicationRegistry::getInstance();
+  while (reg.getCallbackCount() > 0) {
+    std::string first = reg.getCallbacks()[0].c_str();
+    if (!reg.unregisterCallback(first)) break;
+  }
+}
+
+void setUp() { resetRegistry(); }
+void tearDown() { resetRegistry(); }
+
+namespace {
+// Registers and unregisters churn filters until told to stop.
+void churn(std::atomic<bool>& stop, std::atomic<size_t>& changes) {
+  auto& reg = CommunicationRegistry::getInstance();
+  size_t round = 0;
+  while (!stop.load()) {
+    char filter[48];
+    snprintf(filter, sizeof(filter), "Hy/churn/dev%zu/#", round % 8);
+    reg.registerCallback(filter, [](const char*, const uint8_t*, size_t) {});
+    if (round % 3 == 0) {
+      reg.registerCallback("Hy/+/x", [](const char*, const uint8_t*, size_t) {});
+    }
+    reg.unregisterCallback(filter);
+    if (round % 3 == 2) {
+      reg.unregisterCallback("Hy/+/x");
+    }
+    changes.fetch_add(1);
+    round++;
+  }
+}
+
+// Per-dispatch latencies in nanoseconds for `rounds` dispatches on "Hy/stable/y".
+std::vector<long long> dispatch(size_t rounds) {
+  auto& reg = CommunicationRegistry::getInstance();
+  std::vector<long long> ns;
+  ns.reserve(rounds);
+  const uint8_t payload[] = {1, 2, 3};
+  for (size_t i = 0; i < rounds; i++) {
+    auto started = std::chrono::steady_clock::now();
+    reg.triggerCallbacks("Hy/stable/y", payload, sizeof(payload));
+    ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started)
+                     .count());
+  }
+  return ns;
+}
+
+long long percentile(std::vector<long long> ns, double p) {
+  std::sort(ns.begin(), ns.end());
+  return ns[(size_t)(p * (ns.size() - 1))];
+}
+}  // namespace
+
+void test_snapshot_reuses_versions_no_reader_holds() {
+  Snapshot<std::string, 2> snap;
+  std::string* first = snap.acquire();
+  *first = "v1";
+  snap.publish(first);
+  {
+    Snapshot<std::string, 2>::Reader pinned(snap);
+    for (int i = 2; i <= 6; i++) {
+      std::string* next = snap.acquire();
+      TEST_ASSERT_TRUE(next != &*pinned);  // never handed out while held
+      *next = "v" + std::to_string(i);
+      snap.publish(next);
+    }
+    TEST_ASSERT_EQUAL_STRING("v1", pinned->c_str());
+    TEST_ASSERT_EQUAL_size_t(1, snap.pending());
+    Snapshot<std::string, 2>::Reader fresh(snap);
+    TEST_ASSERT_EQUAL_STRING("v6", fresh->c_str());
+  }
+  TEST_ASSERT_EQUAL_size_t(0, snap.pending());
+  TEST_ASSERT_EQUAL_UINT32(6, snap.version());
+}
+
+void test_callback_may_change_registry_during_dispatch() {
+  auto& reg = CommunicationRegistry::getInstance();
+  size_t calls = 0, pendingInside = 0;
+  reg.registerCallback("Hy/self/#", [&](const char*, const uint8_t*, size_t) {
+    calls++;
+    reg.unregisterCallback("Hy/self/#");
+    reg.registerCallback("Hy/other", [](const char*, const uint8_t*, size_t) {});
+    pendingInside = reg.getPendingReclaim();
+  });
+  reg.registerCallback("Hy/+/z", [&](const char*, const uint8_t*, size_t) { calls++; });
+
+  reg.triggerCallbacks("Hy/self/z", (const uint8_t*)"a", 1);
+  TEST_ASSERT_EQUAL_size_t(2, calls);  // the dispatch finishes on its snapshot
+  TEST_ASSERT_FALSE(reg.hasFilter("Hy/self/#"));
+  TEST_ASSERT_TRUE(reg.hasFilter("Hy/other"));
+  TEST_ASSERT_EQUAL_size_t(1, pendingInside);  // the snapshot the dispatch held
+  TEST_ASSERT_EQUAL_size_t(0, reg.getPendingReclaim());
+}
+
+void test_dispatch_is_exact_while_another_thread_churns() {
+  auto& reg = CommunicationRegistry::getInstance();
+  std::atomic<size_t> hits(0);
+  reg.registerCallback("Hy/stable/+", [&](const char*, const uint8_t*, size_t length) { hits.fetch_add(length); });
+
+  const size_t rounds = 20000;
+  std::vector<long long> quiet = dispatch(rounds);
+  TEST_ASSERT_EQUAL_size_t(rounds * 3, hits.load());
+
+  hits.store(0);
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> changes(0);
+  std::thread writer(churn, std::ref(stop), std::ref(changes));
+  std::vector<long long> busy;
+  std::thread second([&] { dispatch(rounds); });
+  busy = dispatch(rounds);
+  second.join();
+  stop.store(true);
+  writer.join();
+  reg.unregisterCallback("Hy/+/x");  // may be left over by the last churn round
+
+  TEST_ASSERT_EQUAL_size_t(2 * rounds * 3, hits.load());
+  TEST_ASSERT_TRUE(changes.load() > 0);
+  TEST_ASSERT_EQUAL_size_t(0, reg.getPendingReclaim());
+  TEST_ASSERT_EQUAL_size_t(1, reg.getCallbackCount());
+
+  char line[160];
+  snprintf(line, sizeof(line), "quiet p50 %lld ns p99 %lld ns; churn (%zu changes) p50 %lld ns p99 %lld ns",
+           percentile(quiet, 0.5), percentile(quiet, 0.99), changes.load(), percentile(busy, 0.5),
+           percentile(busy, 0.99));
+  TEST_MESSAGE(line);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_snapshot_reuses_versions_no_reader_holds);
+  RUN_TEST(test_callback_may_change_registry_during_dispatch);
+  RUN_TEST(test_dispatch_is_exact_while_another_thread_churns);
+  return UNITY_END();
+}
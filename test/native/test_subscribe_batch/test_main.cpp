@@ -0,0 +1,242 @@
+// Native tests for SubscribeBatch, the resubscription after a connect: filters
+// packed into multi-filter SUBSCRIBE packets within the filter and byte
+// limits, every packet written before any SUBACK, and the SUBACKs (as the
+// PacketSniffer reports them) matched back to make the batch ready; and the
+// fingerprint that lets a reconnect into a kept session skip all of it.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "processors/MqttPacket.h"
+#include "processors/SubscribeBatch.h"
+
+using namespace hyphen::mqtt;
+
+namespace {
+typedef SubscribeBatch<128, 4, 3> Batch;
+
+// A SUBSCRIBE decoded back from the wire.
+struct Packet {
+  uint8_t type;
+  uint16_t id;
+  bool framed;  // the remaining length matches the bytes written
+  std::vector<std::string> filters;
+  std::vector<uint8_t> qos;
+};
+
+struct Wire {
+  std::vector<Packet> packets;
+  std::vector<uint8_t> bytes;
+  bool fail = false;
+  Batch::Writer writer() {
+    return [this](const uint8_t* data, size_t length) {
+      if (fail) return false;
+      bytes.insert(bytes.end(), data, data + length);
+      packets.push_back(decode(data, length));
+      return true;
+    };
+  }
+  static Packet decode(const uint8_t* data, size_t length) {
+    Packet p;
+    p.type = data[0];
+    size_t remaining = 0, multiplier = 1, at = 1;
+    do {
+      remaining += (data[at] & 0x7F) * multiplier;
+      multiplier *= 128;
+    } while (data[at++] & 0x80);
+    p.framed = at + remaining == length;
+    p.id = (uint16_t)(data[at] << 8 | data[at + 1]);
+    for (at += 2; at < length;) {
+      size_t n = data[at] << 8 | data[at + 1];
+      p.filters.emplace_back((const char*)data + at + 2, n);
+      p.qos.push_back(data[at + 2 + n]);
+      at += n + 3;
+    }
+    return p;
+  }
+};
+
+void suback(uint8_t* out, uint16_t id, size_t codes, uint8_t code = 0) {
+  out[0] = (uint8_t)(id >> 8);
+  out[1] = (uint8_t)(id & 0xFF);
+  for (size_t i = 0; i < codes; i++) out[2 + i] = code;
+}
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_packs_filters_into_as_few_packets_as_allowed() {
+  Batch batch;
+  Wire wire;
+  batch.begin(0);
+  for (int i = 0; i < 10; i++) {
+    std::string filter = "Hy/f/" + std::to_string(i);
+    TEST_ASSERT_TRUE(batch.add(filter.c_str(), 0, wire.writer()) == Batch::Result::QUEUED);
+  }
+  TEST_ASSERT_EQUAL_size_t(2, wire.packets.size());  // the third is still open
+  TEST_ASSERT_TRUE(batch.flush(wire.writer()));
+
+  TEST_ASSERT_EQUAL_size_t(3, wire.packets.size());
+  TEST_ASSERT_EQUAL_size_t(4, wire.packets[0].filters.size());
+  TEST_ASSERT_EQUAL_size_t(2, wire.packets[2].filters.size());
+  for (const Packet& p : wire.packets) TEST_ASSERT_TRUE(p.framed);
+  TEST_ASSERT_EQUAL_HEX8(0x82, wire.packets[0].type);
+  TEST_ASSERT_EQUAL_HEX16(Batch::kFirstPacketId, wire.packets[0].id);
+  TEST_ASSERT_EQUAL_HEX16(Batch::kFirstPacketId + 2, wire.packets[2].id);
+  TEST_ASSERT_EQUAL_STRING("Hy/f/0", wire.packets[0].filters[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Hy/f/9", wire.packets[2].filters[1].c_str());
+  TEST_ASSERT_EQUAL_UINT8(0, wire.packets[1].qos[3]);
+  TEST_ASSERT_EQUAL_UINT32(10, batch.stats().filters);
+  TEST_ASSERT_EQUAL_size_t(3, batch.pending());
+}
+
+void test_byte_limit_starts_a_new_packet() {
+  Batch batch;
+  Wire wire;
+  batch.begin(0);
+  std::string wide(50, 'w');  // 53 bytes a filter: two fit in 128, three do not
+  for (int i = 0; i < 3; i++) {
+    batch.add((wide + std::to_string(i)).c_str(), 1, wire.writer());
+  }
+  batch.flush(wire.writer());
+  TEST_ASSERT_EQUAL_size_t(2, wire.packets.size());
+  TEST_ASSERT_EQUAL_size_t(2, wire.packets[0].filters.size());
+  TEST_ASSERT_TRUE(wire.packets[0].framed);
+  TEST_ASSERT_EQUAL_UINT8(1, wire.packets[1].qos[0]);
+  TEST_ASSERT_TRUE(wire.bytes.size() <= 2 * 128);
+}
+
+void test_filters_that_do_not_fit_are_left_to_single_subscribes() {
+  Batch batch;
+  Wire wire;
+  batch.begin(0);
+  std::string huge(200, 'h');
+  TEST_ASSERT_TRUE(batch.add(huge.c_str(), 0, wire.writer()) == Batch::Result::SINGLE);
+  for (int i = 0; i < 12; i++) {
+    TEST_ASSERT_TRUE(batch.add("a", 0, wire.writer()) == Batch::Result::QUEUED);
+  }
+  // three packets of four are the most one batch tracks
+  TEST_ASSERT_TRUE(batch.add("b", 0, wire.writer()) == Batch::Result::SINGLE);
+  batch.flush(wire.writer());
+  TEST_ASSERT_EQUAL_size_t(3, wire.packets.size());
+  TEST_ASSERT_EQUAL_UINT32(2, batch.stats().single);
+}
+
+// SUBACKs arrive after every packet was written and are matched by id, in any
+// order; readiness is the time from begin() to the last of them.
+void test_subacks_make_the_batch_ready() {
+  Batch batch;
+  Wire wire;
+  batch.begin(1000);
+  for (int i = 0; i < 6; i++) batch.add("t/+", 0, wire.writer());
+  batch.flush(wire.writer());
+  TEST_ASSERT_EQUAL_size_t(2, wire.packets.size());
+  TEST_ASSERT_FALSE(batch.ready());
+
+  uint8_t head[PacketSniffer::kHeadBytes];
+  suback(head, wire.packets[1].id, 2);
+  TEST_ASSERT_TRUE(batch.ack(wire.packets[1].id, head + 2, 2, 1500));
+  TEST_ASSERT_FALSE(batch.ready());
+  TEST_ASSERT_FALSE(batch.ack(wire.packets[1].id, head + 2, 2, 1500));  // duplicate
+  TEST_ASSERT_FALSE(batch.ack(1, head + 2, 1, 1500));  // PubSubClient's own
+
+  suback(head, wire.packets[0].id, 4);
+  head[2 + 3] = kSubscribeFailure;
+  TEST_ASSERT_TRUE(batch.ack(wire.packets[0].id, head + 2, 4, 1650));
+  TEST_ASSERT_TRUE(batch.ready());
+  TEST_ASSERT_EQUAL_UINT32(5, batch.stats().granted);
+  TEST_ASSERT_EQUAL_UINT32(1, batch.stats().refused);
+  TEST_ASSERT_EQUAL_UINT32(650, batch.stats().lastReadyMs);
+}
+
+// The sniffer keeps enough of a SUBACK for a full packet's return codes.
+void test_sniffer_sees_every_return_code_of_a_full_packet() {
+  PacketSniffer sniffer;
+  std::vector<uint8_t> codes;
+  sniffer.onPacket([&](uint8_t type, uint8_t, const uint8_t* head, size_t n, size_t) {
+    if (type == SUBACK) codes.assign(head + 2, head + n);
+  });
+  const size_t filters = PacketSniffer::kHeadBytes - 2;
+  std::vector<uint8_t> packet = {(uint8_t)(SUBACK << 4), (uint8_t)(2 + filters), 0x40, 0x00};
+  for (size_t i = 0; i < filters; i++) packet.push_back(i == filters - 1 ? kSubscribeFailure : 1);
+  sniffer.feed(packet.data(), packet.size());
+  TEST_ASSERT_EQUAL_size_t(filters, codes.size());
+  TEST_ASSERT_EQUAL_HEX8(kSubscribeFailure, codes.back());
+}
+
+void test_write_failure_stops_the_batch_and_begin_forgets_it() {
+  Batch batch;
+  Wire wire;
+  batch.begin(0);
+  for (int i = 0; i < 4; i++) batch.add("x", 0, wire.writer());
+  wire.fail = true;
+  TEST_ASSERT_TRUE(batch.add("y", 0, wire.writer()) == Batch::Result::WRITE_FAILED);
+  TEST_ASSERT_EQUAL_size_t(0, batch.packets());
+
+  wire.fail = false;
+  batch.begin(0);
+  batch.add("z", 0, wire.writer());
+  TEST_ASSERT_TRUE(batch.flush(wire.writer()));
+  TEST_ASSERT_EQUAL_size_t(1, wire.packets.size());
+  TEST_ASSERT_EQUAL_STRING("z", wire.packets[0].filters[0].c_str());
+  TEST_ASSERT_EQUAL_UINT32(2, batch.stats().batches);
+}
+
+void test_fingerprint_ignores_order_and_tells_sets_apart() {
+  SubscriptionFingerprint a, b, c;
+  a.add("Hy/Post/Function/dev/#");
+  a.add("Hy/Post/Variable/dev/#");
+  b.add("Hy/Post/Variable/dev/#");
+  b.add("Hy/Post/Function/dev/#");
+  TEST_ASSERT_TRUE(a == b);
+  c = a;
+  c.add("app/x");
+  TEST_ASSERT_TRUE(a != c);
+  TEST_ASSERT_TRUE(SubscriptionFingerprint() != SubscriptionFingerprint(a));
+}
+
+// Only a batch whose every filter was granted vouches for the broker's set.
+void test_complete_only_when_every_filter_was_granted() {
+  uint8_t codes[4] = {0, 0, 0, 0};
+  Batch batch;
+  Wire wire;
+  batch.begin(0);
+  batch.add("a", 0, wire.writer());
+  batch.add("b", 0, wire.writer());
+  batch.flush(wire.writer());
+  TEST_ASSERT_FALSE(batch.complete());
+  batch.ack(wire.packets[0].id, codes, 2, 10);
+  TEST_ASSERT_TRUE(batch.complete());
+  SubscriptionFingerprint expected;
+  expected.add("b");
+  expected.add("a");
+  TEST_ASSERT_TRUE(batch.fingerprint() == expected);
+
+  batch.begin(0);
+  batch.add("a", 0, wire.writer());
+  batch.flush(wire.writer());
+  codes[0] = kSubscribeFailure;
+  batch.ack(wire.packets.back().id, codes, 1, 10);
+  TEST_ASSERT_TRUE(batch.ready());
+  TEST_ASSERT_FALSE(batch.complete());
+
+  batch.begin(0);
+  batch.add(std::string(200, 'h').c_str(), 0, wire.writer());  // sent alone
+  TEST_ASSERT_TRUE(batch.ready());
+  TEST_ASSERT_FALSE(batch.complete());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_packs_filters_into_as_few_packets_as_allowed);
+  RUN_TEST(test_byte_limit_starts_a_new_packet);
+  RUN_TEST(test_filters_that_do_not_fit_are_left_to_single_subscribes);
+  RUN_TEST(test_subacks_make_the_batch_ready);
+  RUN_TEST(test_sniffer_sees_every_return_code_of_a_full_packet);
+  RUN_TEST(test_write_failure_stops_the_batch_and_begin_forgets_it);
+  RUN_TEST(test_fingerprint_ignores_order_and_tells_sets_apart);
+  RUN_TEST(test_complete_only_when_every_filter_was_granted);
+  return UNITY_END();
+}
@@ -1,8 +1,8 @@
 // Native unit tests for SubscriptionManager's remote variable/function payload
 // building and topic parsing. runVariable()/runFunction() are pure: they parse
 // the MQTT topic (key + callId), look up the registry, and return the JSON
-// response that gets published back to the cloud. We assert the JSON shape and,
-// implicitly, the getTopicKey()/getCallId() parsing (which are private).
+// response that gets published back to the cloud. We assert the JSON shape, the
+// in-place topic parsing, and the result topics the callbacks publish to.
 #include <unity.h>
 
 #include <ArduinoJson.h>
@@ -25,6 +25,11 @@ static const char* fnTopic(const char* key) {
   return buf.c_str();
 }
 
+static const char* kRegistrationTopic() {
+  static std::string topic = std::string("Hy/Post/Register/") + kDeviceId;
+  return topic.c_str();
+}
+
 void setUp() {}
 void tearDown() {}
 
@@ -105,6 +110,166 @@ void test_runFunction_unknown_returns_empty() {
   TEST_ASSERT_TRUE(out.isEmpty());
 }
 
+// A redelivered request (same function, same call id) returns the first
+// result without running the function again; a new call id runs it.
+void test_runFunction_redelivery_answered_from_cache() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int runs = 0;
+  mgr.function("pump", [&](const char*) { return ++runs; });
+
+  String first = mgr.runFunction(fnTopic("pump"), "");
+  String again = mgr.runFunction(fnTopic("pump"), "");
+  TEST_ASSERT_EQUAL_INT(1, runs);
+  TEST_ASSERT_EQUAL_STRING(first.c_str(), again.c_str());
+
+  std::string other = std::string("Hy/Post/Function/") + kDeviceId + "/pump/req100";
+  String next = mgr.runFunction(other.c_str(), "");
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, next.c_str()));
+  TEST_ASSERT_EQUAL_INT(2, doc["value"].as<int>());
+  TEST_ASSERT_EQUAL_STRING("req100", doc["request"].as<const char*>());
+
+  CallCacheStats stats = mgr.getCallCacheStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.hits);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.misses);
+}
+
+void test_parseRequestTopic_views_into_the_topic() {
+  const char* topic = "Hy/Post/Function/dev/pump/c7";
+  TopicToken key, callId;
+  TEST_ASSERT_TRUE(SubscriptionManager::parseRequestTopic(topic, key, callId));
+  TEST_ASSERT_TRUE(key.at == topic + 21);
+  TEST_ASSERT_TRUE(key.equals("pump"));
+  TEST_ASSERT_FALSE(key.equals("pum"));
+  TEST_ASSERT_TRUE(callId.equals("c7"));
+
+  TEST_ASSERT_TRUE(SubscriptionManager::parseRequestTopic("pump/", key, callId));
+  TEST_ASSERT_TRUE(key.equals("pump"));
+  TEST_ASSERT_EQUAL_size_t(0, callId.length);
+  TEST_ASSERT_FALSE(SubscriptionManager::parseRequestTopic("pump", key, callId));
+}
+
+// Requests delivered through the subscriptions are answered on
+// "<results topic>/<key>/<callId>"; a topic too long for the buffer is dropped.
+void test_callbacks_publish_to_result_topics() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int calls = 0, level = 7;
+  mgr.function("pump", [&](const char*) { return ++calls; });
+  mgr.variable("level", &level);
+  mgr.test_setApplyRegistration(true);
+  mgr.loop();  // subscribes
+
+  std::string base = std::string("Hy/Post/Function/") + kDeviceId;
+  proc.textHandlers[base + "/#"]((base + "/pump/c1").c_str(), "");
+  std::string vbase = std::string("Hy/Post/Variable/") + kDeviceId;
+  proc.textHandlers[vbase + "/#"]((vbase + "/level/c2").c_str(), "");
+  mgr.loop();  // drains the results
+  TEST_ASSERT_EQUAL_size_t(2, proc.publishes.size());
+  std::string fnResult = std::string("Hy/Post/Function/Result/") + kDeviceId + "/pump/c1";
+  std::string varResult = std::string("Hy/Post/Variable/Result/") + kDeviceId + "/level/c2";
+  TEST_ASSERT_EQUAL_STRING(fnResult.c_str(), proc.publishes[0].first.c_str());
+  TEST_ASSERT_EQUAL_STRING(varResult.c_str(), proc.publishes[1].first.c_str());
+
+  std::string longId(RESULT_TOPIC_BYTES, 'x');
+  proc.textHandlers[base + "/#"]((base + "/pump/" + longId).c_str(), "");
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(2, proc.publishes.size());
+  TEST_ASSERT_EQUAL_INT(2, calls);
+}
+
+void test_reregistering_replaces_the_entry() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int a = 1, b = 2;
+  mgr.function("fn", [](const char*) { return 1; });
+  mgr.function("fn", [](const char*) { return 5; });
+  mgr.variable("v", &a);
+  mgr.variable("v", &b);
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, mgr.buildRegistryPayload().c_str()));
+  TEST_ASSERT_EQUAL_INT(1, doc["functionCount"].as<int>());
+  TEST_ASSERT_EQUAL_INT(1, doc["variableCount"].as<int>());
+  TEST_ASSERT_FALSE(deserializeJson(doc, mgr.runFunction(fnTopic("fn"), "").c_str()));
+  TEST_ASSERT_EQUAL_INT(5, doc["value"].as<int>());
+  TEST_ASSERT_FALSE(deserializeJson(doc, mgr.runVariable(varTopic("v"), "").c_str()));
+  TEST_ASSERT_EQUAL_INT(2, doc["value"].as<int>());
+}
+
+// Key "*" reads several variables in one response; the payload picks them.
+void test_bulk_variable_read() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int temp = 21;
+  double humidity = 40.5;
+  String label = "greenhouse";
+  mgr.variable("temp", &temp);
+  mgr.variable("humidity", &humidity);
+  mgr.variable("label", &label);
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, mgr.runVariable(varTopic("*"), "").c_str()));
+  TEST_ASSERT_EQUAL_STRING("*", doc["key"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("req99", doc["request"].as<const char*>());
+  TEST_ASSERT_TRUE(doc["timestamp"].as<long long>() > 0);
+  TEST_ASSERT_EQUAL_size_t(3, doc["values"].size());
+  TEST_ASSERT_EQUAL_INT(21, doc["values"]["temp"].as<int>());
+  TEST_ASSERT_EQUAL_STRING("greenhouse", doc["values"]["label"].as<const char*>());
+
+  TEST_ASSERT_FALSE(deserializeJson(doc, mgr.runVariable(varTopic("*"), " label, temp ,nope").c_str()));
+  TEST_ASSERT_EQUAL_size_t(2, doc["values"].size());
+  TEST_ASSERT_EQUAL_INT(21, doc["values"]["temp"].as<int>());
+  TEST_ASSERT_TRUE(doc["values"]["humidity"].isNull());
+}
+
+// A bulk answer larger than RESULT_PAYLOAD_BYTES still goes out as one publish.
+void test_bulk_read_callback_publishes_one_result() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int values[12] = {0};
+  for (int i = 0; i < 12; i++) {
+    std::string name = "sensor_reading_" + std::to_string(i);
+    mgr.variable(name.c_str(), &values[i]);
+  }
+  mgr.test_setApplyRegistration(true);
+  mgr.loop();
+
+  std::string base = std::string("Hy/Post/Variable/") + kDeviceId;
+  proc.textHandlers[base + "/#"]((base + "/*/dash1").c_str(), "*");
+  mgr.loop();
+  TEST_ASSERT_EQUAL_size_t(1, proc.publishes.size());
+  std::string topic = std::string("Hy/Post/Variable/Result/") + kDeviceId + "/*/dash1";
+  TEST_ASSERT_EQUAL_STRING(topic.c_str(), proc.publishes[0].first.c_str());
+  std::string payload = proc.binaryPayloads.back();  // queued results drain as bytes
+  TEST_ASSERT_TRUE(payload.size() > RESULT_PAYLOAD_BYTES);
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, payload.c_str()));
+  TEST_ASSERT_EQUAL_size_t(12, doc["values"].size());
+}
+
+void test_call_cache_evicts_least_recently_used() {
+  CallCache cache;
+  int result = 0;
+  for (int i = 0; i < CALL_CACHE_SIZE; i++) {
+    cache.remember("fn", std::to_string(i).c_str(), i);
+  }
+  TEST_ASSERT_TRUE(cache.find("fn", "0", result));  // 0 is now the most recent
+  cache.remember("fn", "new", 42);                  // evicts 1
+  TEST_ASSERT_FALSE(cache.find("fn", "1", result));
+  TEST_ASSERT_TRUE(cache.find("fn", "0", result));
+  TEST_ASSERT_EQUAL_INT(0, result);
+  TEST_ASSERT_TRUE(cache.find("fn", "new", result));
+  TEST_ASSERT_EQUAL_INT(42, result);
+  TEST_ASSERT_FALSE(cache.find("fnx", "new", result));  // the function name is part of the key
+  TEST_ASSERT_EQUAL_UINT32(1, cache.getStats().evictions);
+
+  std::string longId(CALL_CACHE_ID_BYTES, 'x');
+  cache.remember("fn", longId.c_str(), 1);
+  TEST_ASSERT_FALSE(cache.find("fn", longId.c_str(), result));
+  TEST_ASSERT_EQUAL_UINT32(1, cache.getStats().uncached);
+}
+
 void test_buildRegistryPayload_manifest_shape() {
   FakeProcessor proc;
   SubscriptionManager mgr(proc);
@@ -123,6 +288,48 @@ void test_buildRegistryPayload_manifest_shape() {
   TEST_ASSERT_EQUAL_size_t(1, doc["variables"].as<JsonArray>().size());
 }
 
+// Aliases are listed in the manifest and used only once it has been sent.
+void test_topic_aliases_apply_after_the_manifest() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  mgr.function("fn", [](const char*) { return 1; });
+  std::string prefix = std::string("Hy/Post/Telemetry/") + kDeviceId;
+  std::string alias = std::string("Hy/t/") + kDeviceId;
+  TEST_ASSERT_TRUE(mgr.topicAlias(prefix.c_str(), alias.c_str()));
+  TEST_ASSERT_FALSE(mgr.topicAlias("Hy/Post/Other", alias.c_str()));  // alias taken
+  TEST_ASSERT_FALSE(mgr.topicAlias("Hy/x", "Hy/xy"));                 // not shorter
+
+  std::string topic = prefix + "/soil";
+  mgr.publishTopic(topic.c_str(), (uint8_t*)"1", 1);
+  TEST_ASSERT_EQUAL_STRING(topic.c_str(), proc.publishes.back().first.c_str());
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, mgr.buildRegistryPayload().c_str()));
+  TEST_ASSERT_EQUAL_STRING(prefix.c_str(), doc["aliases"][alias].as<const char*>());
+
+  mgr.test_setCheckReady(true);
+  mgr.loop();  // publishes the manifest
+  TEST_ASSERT_TRUE(mgr.ready());
+  TEST_ASSERT_EQUAL_STRING(kRegistrationTopic(), proc.publishes.back().first.c_str());
+
+  mgr.publishTopic(String(topic.c_str()), String("2"));
+  std::string aliased = alias + "/soil";
+  TEST_ASSERT_EQUAL_STRING(aliased.c_str(), proc.publishes.back().first.c_str());
+  mgr.publishTopic("Hy/Post/Elsewhere", (uint8_t*)"3", 1);
+  TEST_ASSERT_EQUAL_STRING("Hy/Post/Elsewhere", proc.publishes.back().first.c_str());
+  TopicAliasStats stats = mgr.getTopicAliasStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.aliased);
+  TEST_ASSERT_EQUAL_UINT32(prefix.size() - alias.size(), stats.bytesSaved);
+}
+
+void test_manifest_has_no_aliases_when_none_are_set() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, mgr.buildRegistryPayload().c_str()));
+  TEST_ASSERT_TRUE(doc["aliases"].isNull());
+}
+
 int main(int, char**) {
   UNITY_BEGIN();
   RUN_TEST(test_runVariable_int_payload_shape);
@@ -131,6 +338,15 @@ int main(int, char**) {
   RUN_TEST(test_runVariable_unknown_returns_empty);
   RUN_TEST(test_runFunction_invokes_callback_and_returns_value);
   RUN_TEST(test_runFunction_unknown_returns_empty);
+  RUN_TEST(test_runFunction_redelivery_answered_from_cache);
+  RUN_TEST(test_parseRequestTopic_views_into_the_topic);
+  RUN_TEST(test_callbacks_publish_to_result_topics);
+  RUN_TEST(test_reregistering_replaces_the_entry);
+  RUN_TEST(test_bulk_variable_read);
+  RUN_TEST(test_bulk_read_callback_publishes_one_result);
+  RUN_TEST(test_call_cache_evicts_least_recently_used);
   RUN_TEST(test_buildRegistryPayload_manifest_shape);
+  RUN_TEST(test_topic_aliases_apply_after_the_manifest);
+  RUN_TEST(test_manifest_has_no_aliases_when_none_are_set);
   return UNITY_END();
 }
@@ -0,0 +1,70 @@
+// Native tests for TlsSessionStore: the RTC-resident session slot must never be
+// trusted unless it was written for the same endpoint and is intact.
+#include <unity.h>
+
+#include <string.h>
+
+#include "connections/TlsSession.h"
+
+namespace {
+size_t fillWith(const char* text, uint8_t* data, size_t capacity) {
+  size_t n = strlen(text);
+  if (n > capacity) return 0;
+  memcpy(data, text, n);
+  return n;
+}
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_uninitialized_slot_is_ignored() {
+  TlsSession slot;
+  memset(&slot, 0xA5, sizeof(slot));  // RTC noinit garbage after power-on
+  TlsSessionStore store(slot);
+  TEST_ASSERT_NULL(store.find("broker", 8883));
+}
+
+void test_saved_session_is_found_for_its_endpoint_only() {
+  TlsSession slot = {};
+  TlsSessionStore store(slot);
+  TEST_ASSERT_TRUE(store.update("broker", 8883, [](uint8_t* d, size_t c) {
+    return fillWith("session-bytes", d, c);
+  }));
+
+  const TlsSession* found = store.find("broker", 8883);
+  TEST_ASSERT_NOT_NULL(found);
+  TEST_ASSERT_EQUAL_UINT16(13, found->length);
+  TEST_ASSERT_EQUAL_MEMORY("session-bytes", found->data, 13);
+  TEST_ASSERT_NULL(store.find("broker", 443));
+  TEST_ASSERT_NULL(store.find("other", 8883));
+}
+
+void test_corrupted_or_cleared_slot_is_rejected() {
+  TlsSession slot = {};
+  TlsSessionStore store(slot);
+  store.update("broker", 8883, [](uint8_t* d, size_t c) { return fillWith("abc", d, c); });
+  slot.data[1] ^= 0x01;
+  TEST_ASSERT_NULL(store.find("broker", 8883));
+
+  store.update("broker", 8883, [](uint8_t* d, size_t c) { return fillWith("abc", d, c); });
+  store.clear();
+  TEST_ASSERT_NULL(store.find("broker", 8883));
+}
+
+void test_failed_export_leaves_no_session() {
+  TlsSession slot = {};
+  TlsSessionStore store(slot);
+  store.update("broker", 8883, [](uint8_t* d, size_t c) { return fillWith("abc", d, c); });
+  TEST_ASSERT_FALSE(store.update("broker", 8883, [](uint8_t*, size_t) { return (size_t)0; }));
+  TEST_ASSERT_NULL(store.find("broker", 8883));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_uninitialized_slot_is_ignored);
+  RUN_TEST(test_saved_session_is_found_for_its_endpoint_only);
+  RUN_TEST(test_corrupted_or_cleared_slot_is_rejected);
+  RUN_TEST(test_failed_export_leaves_no_session);
+  return UNITY_END();
+}
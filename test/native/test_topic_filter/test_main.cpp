@@ -0,0 +1,165 @@
+// Native tests for TopicFilter, the compiled form each registered filter is
+// kept in: the text and level offsets are recorded once, and matching an
+// inbound topic (alone or through CommunicationRegistry) performs no heap
+// allocation; changing the registry allocates only a new filter's text.
+// Allocations are counted by replacing the global operator new.
+#include <unity.h>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "managers/CommunicationRegistry.h"
+#include "managers/TopicFilter.h"
+
+namespace {
+size_t g_allocations = 0;
+}  // namespace
+
+void* operator new(size_t size) {
+  g_allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  g_allocations++;
+  return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static void resetRegistry() {
+  auto& reg = CommunicationRegistry::getInstance();
+  while (reg.getCallbackCount() > 0) {
+    std::string first = reg.getCallbacks()[0].c_str();
+    if (!reg.unregisterCallback(first)) break;
+  }
+}
+
+void setUp() { resetRegistry(); }
+void tearDown() { resetRegistry(); }
+
+void test_compile_records_levels() {
+  TopicFilter f("Hy/+/Variable/+/#");
+  TEST_ASSERT_FALSE(f.empty());
+  TEST_ASSERT_EQUAL_size_t(5, f.levels());
+  TEST_ASSERT_EQUAL_size_t(8, f.length(2));
+  TEST_ASSERT_EQUAL_INT(0, memcmp(f.level(2), "Variable", 8));
+  TEST_ASSERT_EQUAL_INT('#', *f.level(4));
+  TEST_ASSERT_EQUAL_size_t(1, f.length(4));
+
+  TopicFilter exact("a//b");
+  TEST_ASSERT_EQUAL_size_t(3, exact.levels());
+  TEST_ASSERT_EQUAL_size_t(0, exact.length(1));
+  TEST_ASSERT_TRUE(exact.is("a//b"));
+  TEST_ASSERT_FALSE(exact.is("a/+"));
+}
+
+void test_invalid_or_too_deep_filters_do_not_compile() {
+  TopicFilter f;
+  TEST_ASSERT_FALSE(f.compile("a/#/b"));
+  TEST_ASSERT_TRUE(f.empty());
+  TEST_ASSERT_FALSE(f.matches("a/x/b"));
+
+  std::string deep = "a";
+  for (size_t i = 1; i < TOPIC_FILTER_MAX_LEVELS; i++) deep += "/a";
+  TEST_ASSERT_TRUE(f.compile(deep.c_str()));
+  TEST_ASSERT_TRUE(f.matches(deep.c_str()));
+  deep += "/a";
+  TEST_ASSERT_FALSE(f.compile(deep.c_str()));
+}
+
+// The text lives on the heap, so a long filter is not refused for its length.
+void test_long_filters_compile() {
+  std::string filter = "Hy/" + std::string(300, 'x') + "/+";
+  TopicFilter f(filter.c_str());
+  TEST_ASSERT_FALSE(f.empty());
+  TEST_ASSERT_TRUE(f.is(filter.c_str()));
+  std::string topic = "Hy/" + std::string(300, 'x') + "/y";
+  TEST_ASSERT_TRUE(f.matches(topic.c_str()));
+}
+
+void test_levels_are_compared_whole() {
+  TopicFilter f("Hy/Post/+");
+  TEST_ASSERT_FALSE(f.matches("Hy/Get/x"));
+  TEST_ASSERT_FALSE(f.matches("Hy/Postx/x"));
+  TEST_ASSERT_FALSE(f.matches("Hy/Pos/x"));
+  TEST_ASSERT_TRUE(f.matches("Hy/Post/x"));
+  TEST_ASSERT_TRUE(f.matches("Hy/Post/"));
+  TEST_ASSERT_FALSE(f.matches("Hy/Post"));
+}
+
+void test_topics_deeper_than_the_limit() {
+  std::string topic = "a";
+  for (size_t i = 1; i < TOPIC_FILTER_MAX_LEVELS + 4; i++) topic += "/a";
+  TEST_ASSERT_TRUE(TopicFilter("a/#").matches(topic.c_str()));
+  TEST_ASSERT_TRUE(TopicFilter("a/+/#").matches(topic.c_str()));
+  TEST_ASSERT_FALSE(TopicFilter("a/+").matches(topic.c_str()));
+}
+
+void test_matching_compiled_filters_does_not_allocate() {
+  TopicFilter filters[] = {TopicFilter("Hy/Post/Function/dev1/#"), TopicFilter("Hy/+/Config"),
+                           TopicFilter("Hy/Post/Variable/dev1/+/+"), TopicFilter("#")};
+  const char* topic = "Hy/Post/Function/dev1/reboot/req1";
+  size_t before = g_allocations;
+  size_t hits = 0;
+  for (int round = 0; round < 100; round++) {
+    for (const TopicFilter& f : filters) hits += f.matches(topic);
+    hits += filters[1].matches("Hy/dev9/Config");
+  }
+  TEST_ASSERT_EQUAL_size_t(0, g_allocations - before);
+  TEST_ASSERT_EQUAL_size_t(300, hits);
+}
+
+void test_registry_dispatch_does_not_allocate() {
+  auto& reg = CommunicationRegistry::getInstance();
+  size_t binary = 0, text = 0;
+  reg.registerCallback("Hy/Post/Function/dev1/#",
+                       [&](const char*, const uint8_t*, size_t length) { binary += length; });
+  reg.registerCallback("Hy/+/Config", [&](const char*, const char* payload) { text += strlen(payload); });
+  reg.registerCallback("Hy/Post/Variable/dev1/#", [](const char*, const char*) {});
+
+  const uint8_t payload[] = {'{', '}', 0x00, 0x01};
+  size_t before = g_allocations;
+  for (int round = 0; round < 100; round++) {
+    reg.triggerCallbacks("Hy/Post/Function/dev1/reboot/req1", payload, sizeof(payload));
+    reg.triggerCallbacks("Hy/dev1/Config", (const uint8_t*)"abc", 3);
+    reg.triggerCallbacks("Hy/Unknown/topic", payload, sizeof(payload));
+  }
+  TEST_ASSERT_EQUAL_size_t(0, g_allocations - before);
+  TEST_ASSERT_EQUAL_size_t(400, binary);
+  TEST_ASSERT_EQUAL_size_t(300, text);
+}
+
+// Once the callbacks exist, subscribing and unsubscribing only move them into
+// and out of the registry's fixed pools; a new filter allocates its text once.
+void test_registry_changes_allocate_only_filter_text() {
+  auto& reg = CommunicationRegistry::getInstance();
+  std::string topics[] = {"Hy/Post/Function/dev1/#", "Hy/+/Config", "Hy/Post/Variable/dev1/+/+"};
+  CommunicationRegistry::Callback callback = [](const char*, const uint8_t*, size_t) {};
+  size_t before = g_allocations;
+  for (int round = 0; round < 50; round++) {
+    for (const std::string& topic : topics) TEST_ASSERT_TRUE(reg.registerCallback(topic, callback));
+    TEST_ASSERT_TRUE(reg.registerCallback(topics[1], callback));
+    for (const std::string& topic : topics) TEST_ASSERT_TRUE(reg.unregisterCallback(topic));
+  }
+  TEST_ASSERT_EQUAL_size_t(50 * 3, g_allocations - before);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_compile_records_levels);
+  RUN_TEST(test_invalid_or_too_deep_filters_do_not_compile);
+  RUN_TEST(test_long_filters_compile);
+  RUN_TEST(test_levels_are_compared_whole);
+  RUN_TEST(test_topics_deeper_than_the_limit);
+  RUN_TEST(test_matching_compiled_filters_does_not_allocate);
+  RUN_TEST(test_registry_dispatch_does_not_allocate);
+  RUN_TEST(test_registry_changes_allocate_only_filter_text);
+  return UNITY_END();
+}
@@ -0,0 +1,257 @@
+// Native tests for TopicIndex and TopicFilter: MQTT 3.1.1 topic-filter
+// matching (§4.7), filter validation and pruning, plus a dispatch benchmark at
+// 10, 100 and 1000 filters comparing the index against a linear scan of
+// compiled filters.
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "managers/TopicIndex.h"
+
+namespace {
+// Slots of `filters` that `index` matches for `topic`.
+template <size_t Nodes>
+std::vector<int> matching(const TopicIndex<Nodes>& index, const TopicFilter* filters, const char* topic) {
+  std::vector<int> slots;
+  index.match(filters, topic, [&](uint16_t slot) { slots.push_back(slot); });
+  return slots;
+}
+
+bool indexMatches(const char* filter, const char* topic) {
+  TopicFilter filters[] = {TopicFilter(filter)};
+  TopicIndex<32> index;
+  index.insert(filters, 0);
+  return index.match(filters, topic, [](uint16_t) {}) == 1;
+}
+
+// Both matchers must agree with the spec on every case.
+void expect(bool expected, const char* filter, const char* topic) {
+  char message[160];
+  snprintf(message, sizeof(message), "filter '%s' topic '%s'", filter, topic);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected, indexMatches(filter, topic), message);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected, TopicFilter(filter).matches(topic), message);
+}
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_filter_validation() {
+  TEST_ASSERT_TRUE(TopicFilter::valid("a/b"));
+  TEST_ASSERT_TRUE(TopicFilter::valid("#"));
+  TEST_ASSERT_TRUE(TopicFilter::valid("+"));
+  TEST_ASSERT_TRUE(TopicFilter::valid("+/+/#"));
+  TEST_ASSERT_TRUE(TopicFilter::valid("/"));
+  TEST_ASSERT_FALSE(TopicFilter::valid(""));
+  TEST_ASSERT_FALSE(TopicFilter::valid("a/#/b"));
+  TEST_ASSERT_FALSE(TopicFilter::valid("a#"));
+  TEST_ASSERT_FALSE(TopicFilter::valid("a/b+"));
+  TEST_ASSERT_FALSE(TopicFilter::valid("+a/b"));
+
+  TopicFilter filters[] = {TopicFilter("a/#/b")};
+  TopicIndex<8> index;
+  TEST_ASSERT_FALSE(index.insert(filters, 0));
+  TEST_ASSERT_EQUAL_size_t(0, index.size());
+}
+
+void test_single_level_wildcard() {
+  expect(true, "sport/tennis/+", "sport/tennis/player1");
+  expect(false, "sport/tennis/+", "sport/tennis/player1/ranking");
+  expect(false, "sport/+", "sport");
+  expect(true, "sport/+", "sport/");
+  expect(true, "+/+", "/finance");
+  expect(true, "/+", "/finance");
+  expect(false, "+", "/finance");
+  expect(true, "a/+/c", "a/b/c");  // wildcard in the middle
+  expect(false, "a/+/c", "a/b/d");
+  expect(true, "+/b/+", "x/b/y");
+}
+
+void test_multi_level_wildcard() {
+  expect(true, "sport/tennis/player1/#", "sport/tennis/player1");
+  expect(true, "sport/tennis/player1/#", "sport/tennis/player1/ranking");
+  expect(true, "sport/tennis/player1/#", "sport/tennis/player1/score/wimbledon");
+  expect(true, "sport/#", "sport");
+  expect(true, "#", "anything/at/all");
+  expect(true, "a/+/#", "a/b");
+  expect(false, "a/+/#", "a");
+  expect(false, "sport/tennis/#", "sport/tennisplayer");  // whole levels only
+}
+
+void test_exact_and_empty_levels() {
+  expect(true, "a/b", "a/b");
+  expect(false, "a/b", "a/b/");
+  expect(false, "a/b", "A/b");  // case sensitive
+  expect(true, "a//b", "a//b");
+  expect(false, "a/b", "a");
+}
+
+void test_dollar_topics_are_not_matched_by_leading_wildcards() {
+  expect(false, "#", "$SYS/broker/uptime");
+  expect(false, "+/monitor/Clients", "$SYS/monitor/Clients");
+  expect(true, "$SYS/#", "$SYS/monitor/Clients");
+  expect(true, "$SYS/monitor/+", "$SYS/monitor/Clients");
+  expect(true, "a/+", "a/$b");  // only the first level is special
+}
+
+void test_every_matching_filter_is_visited_once() {
+  TopicFilter filters[] = {TopicFilter("Hy/#"), TopicFilter("Hy/Post/+"), TopicFilter("Hy/Post/Config"),
+                           TopicFilter("Hy/Get/+"), TopicFilter("+/+/Config")};
+  TopicIndex<16> index;
+  for (uint16_t slot = 0; slot < 5; slot++) TEST_ASSERT_TRUE(index.insert(filters, slot));
+
+  std::vector<int> slots = matching(index, filters, "Hy/Post/Config");
+  TEST_ASSERT_EQUAL_size_t(4, slots.size());
+  for (int want : {0, 1, 2, 4}) {
+    int seen = 0;
+    for (int slot : slots) seen += slot == want;
+    TEST_ASSERT_EQUAL_INT(1, seen);
+  }
+}
+
+void test_insert_and_erase_prunes() {
+  TopicFilter filters[] = {TopicFilter("a/b/c"), TopicFilter("a/+")};
+  TopicIndex<16> index;
+  TEST_ASSERT_TRUE(index.insert(filters, 0));
+  TEST_ASSERT_TRUE(index.insert(filters, 0));  // the same filter again adds nothing
+  TEST_ASSERT_TRUE(index.insert(filters, 1));
+  TEST_ASSERT_EQUAL_size_t(2, index.size());
+  TEST_ASSERT_EQUAL_size_t(5, index.nodes());  // root, a, b, c, +
+  TEST_ASSERT_EQUAL_size_t(0, matching(index, filters, "a/b/c/d").size());
+
+  TEST_ASSERT_TRUE(index.erase(filters, 0));
+  TEST_ASSERT_FALSE(index.erase(filters, 0));
+  TEST_ASSERT_EQUAL_size_t(1, index.size());
+  TEST_ASSERT_EQUAL_size_t(3, index.nodes());
+  TEST_ASSERT_EQUAL_size_t(1, matching(index, filters, "a/b").size());
+  TEST_ASSERT_EQUAL_size_t(0, matching(index, filters, "a/b/c").size());
+
+  TEST_ASSERT_TRUE(index.erase(filters, 1));
+  TEST_ASSERT_EQUAL_size_t(0, index.size());
+  TEST_ASSERT_EQUAL_size_t(1, index.nodes());
+}
+
+// A node reads its level from one filter passing through it; erasing that
+// filter must hand the node to another one before the slot is reused.
+void test_index_erase_moves_shared_levels_to_a_surviving_filter() {
+  TopicFilter filters[] = {TopicFilter("a/b/c"), TopicFilter("a/b/d"), TopicFilter("a/+"), TopicFilter("x/#")};
+  TopicIndex<16> index;
+  for (uint16_t slot = 0; slot < 4; slot++) TEST_ASSERT_TRUE(index.insert(filters, slot));
+  TEST_ASSERT_EQUAL_size_t(4, index.size());
+  TEST_ASSERT_EQUAL_size_t(8, index.nodes());  // root, a, b, c, d, +, x, #
+
+  TEST_ASSERT_TRUE(index.erase(filters, 0));
+  TEST_ASSERT_FALSE(index.erase(filters, 0));
+  filters[0].compile("zz/zz/zz");  // the freed slot is reused
+  std::vector<int> hits;
+  index.match(filters, "a/b/d", [&](uint16_t slot) { hits.push_back(slot); });
+  TEST_ASSERT_EQUAL_size_t(1, hits.size());
+  TEST_ASSERT_EQUAL_INT(1, hits[0]);
+  TEST_ASSERT_EQUAL_size_t(0, index.match(filters, "a/b/c", [](uint16_t) {}));
+  TEST_ASSERT_EQUAL_size_t(1, index.match(filters, "a/q", [](uint16_t) {}));
+  TEST_ASSERT_EQUAL_size_t(7, index.nodes());
+
+  for (uint16_t slot = 1; slot < 4; slot++) TEST_ASSERT_TRUE(index.erase(filters, slot));
+  TEST_ASSERT_EQUAL_size_t(0, index.size());
+  TEST_ASSERT_EQUAL_size_t(1, index.nodes());
+}
+
+void test_index_refuses_filters_it_has_no_nodes_for() {
+  TopicFilter filters[] = {TopicFilter("a/b"), TopicFilter("a/c/d")};
+  TopicIndex<4> index;  // root + three
+  TEST_ASSERT_TRUE(index.insert(filters, 0));
+  TEST_ASSERT_FALSE(index.insert(filters, 1));
+  TEST_ASSERT_EQUAL_size_t(1, index.size());
+  TEST_ASSERT_EQUAL_size_t(3, index.nodes());
+  TEST_ASSERT_EQUAL_size_t(0, index.match(filters, "a/c/d", [](uint16_t) {}));
+  filters[1].compile("a/c");
+  TEST_ASSERT_TRUE(index.insert(filters, 1));
+  TEST_ASSERT_EQUAL_size_t(1, index.match(filters, "a/c", [](uint16_t) {}));
+}
+
+// An unlinked node keeps its links for readers that may still stand on it,
+// and is reused only once the oldest reader is past its retirement stamp.
+void test_erased_nodes_wait_for_readers_before_reuse() {
+  TopicFilter filters[] = {TopicFilter("a/b"), TopicFilter("c/d")};
+  TopicIndex<3> index;  // root + two
+  TEST_ASSERT_TRUE(index.insert(filters, 0));
+  TEST_ASSERT_TRUE(index.erase(filters, 0, 5));
+  TEST_ASSERT_EQUAL_size_t(1, index.nodes());
+  TEST_ASSERT_FALSE(index.insert(filters, 1, 4));  // a reader from before 5 is still out
+  TEST_ASSERT_EQUAL_size_t(0, index.match(filters, "c/d", [](uint16_t) {}));
+  TEST_ASSERT_TRUE(index.insert(filters, 1, 5));
+  TEST_ASSERT_EQUAL_size_t(1, index.match(filters, "c/d", [](uint16_t) {}));
+  TEST_ASSERT_EQUAL_size_t(0, index.match(filters, "a/b", [](uint16_t) {}));
+}
+
+// Dispatch cost with N device-style filters ("Hy/Post/Function/dev<i>/#" and
+// friends), through the same TopicIndex the registry dispatches with. The
+// index's cost follows the topic depth and the siblings scanned at each level;
+// the linear scan's follows N. Timings
+// are printed, not asserted, so the suite stays stable on busy hosts and under
+// sanitizers.
+void test_benchmark_dispatch_10_100_1000_filters() {
+  typedef TopicIndex<4096> Index;
+  const char* kinds[] = {"Hy/Post/Function/%s/#", "Hy/Post/Variable/%s/+/+", "Hy/Get/%s/Config"};
+  for (size_t count : {10u, 100u, 1000u}) {
+    std::unique_ptr<Index> index(new Index());
+    std::vector<TopicFilter> filters(count);
+    for (size_t i = 0; i < count; i++) {
+      char device[24], filter[64];
+      snprintf(device, sizeof(device), "dev%04zu", i);
+      snprintf(filter, sizeof(filter), kinds[i % 3], device);
+      filters[i].compile(filter);
+      TEST_ASSERT_TRUE(index->insert(filters.data(), (uint16_t)i));
+    }
+    char topic[64];
+    snprintf(topic, sizeof(topic), "Hy/Post/Function/dev%04zu/reboot/req1", (count - 1) / 3 * 3);
+
+    const int rounds = 20000;
+    size_t hits = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      hits += index->match(filters.data(), topic, [](uint16_t) {});
+    }
+    auto indexNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - started)
+                       .count() / rounds;
+
+    size_t linearHits = 0;
+    started = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      for (const TopicFilter& f : filters) {
+        linearHits += f.matches(topic);
+      }
+    }
+    auto linearNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - started)
+                        .count() / rounds;
+
+    TEST_ASSERT_EQUAL_size_t(rounds, hits);
+    TEST_ASSERT_EQUAL_size_t(hits, linearHits);
+    char line[128];
+    snprintf(line, sizeof(line), "%4zu filters: index %lld ns/dispatch, linear scan %lld ns/dispatch", count,
+             (long long)indexNs, (long long)linearNs);
+    TEST_MESSAGE(line);
+  }
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_filter_validation);
+  RUN_TEST(test_single_level_wildcard);
+  RUN_TEST(test_multi_level_wildcard);
+  RUN_TEST(test_exact_and_empty_levels);
+  RUN_TEST(test_dollar_topics_are_not_matched_by_leading_wildcards);
+  RUN_TEST(test_every_matching_filter_is_visited_once);
+  RUN_TEST(test_insert_and_erase_prunes);
+  RUN_TEST(test_index_erase_moves_shared_levels_to_a_surviving_filter);
+  RUN_TEST(test_index_refuses_filters_it_has_no_nodes_for);
+  RUN_TEST(test_erased_nodes_wait_for_readers_before_reuse);
+  RUN_TEST(test_benchmark_dispatch_10_100_1000_filters);
+  return UNITY_END();
+}
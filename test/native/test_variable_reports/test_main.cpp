@@ -0,0 +1,208 @@
+// Native tests for report-on-change variables: loop() samples the variables
+// marked with report() and pushes one only when it moves past its absolute or
+// percent deadband, no more often than minIntervalMs, with a heartbeat after
+// maxIntervalMs. Time is driven through the fake millis() clock.
+#include <unity.h>
+
+#include <ArduinoJson.h>
+
+#include <string>
+
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+#include "test_clock.h"
+
+namespace {
+const std::string kReportTopic = "Hy/Post/Variable/Report/testdevice0001/";
+
+// Runs the manager VARIABLE_REPORT_SAMPLE_MS later: one sample, and the
+// reports it queued are sent by a second loop.
+void step(SubscriptionManager& mgr, unsigned long ms = VARIABLE_REPORT_SAMPLE_MS) {
+  advanceMillis(ms);
+  mgr.loop();
+  mgr.loop();
+}
+
+size_t reportsOf(FakeProcessor& proc, const char* key) {
+  size_t n = 0;
+  for (auto& publish : proc.publishes) {
+    n += publish.first == kReportTopic + key;
+  }
+  return n;
+}
+
+// The "value" of the last publish, which must be a report.
+double lastValue(FakeProcessor& proc) {
+  JsonDocument doc;
+  deserializeJson(doc, proc.binaryPayloads.back().c_str());
+  return doc["value"].as<double>();
+}
+}  // namespace
+
+void setUp() { setMillis(1000); }
+void tearDown() {}
+
+void test_absolute_deadband_and_min_interval() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  double temp = 20.0;
+  mgr.variable("temp", &temp);
+  ReportPolicy policy;
+  policy.deadband = 0.5;
+  policy.minIntervalMs = 1000;
+  TEST_ASSERT_TRUE(mgr.report("temp", policy));
+
+  step(mgr);  // the first sample is always reported
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "temp"));
+  std::string topic = kReportTopic + "temp";
+  TEST_ASSERT_EQUAL_STRING(topic.c_str(), proc.publishes.back().first.c_str());
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, proc.binaryPayloads.back().c_str()));
+  TEST_ASSERT_EQUAL_STRING("temp", doc["key"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("testdevice0001", doc["id"].as<const char*>());
+  TEST_ASSERT_TRUE(doc["timestamp"].as<long long>() > 0);
+  TEST_ASSERT_TRUE(doc["value"].as<double>() == 20.0);
+
+  temp = 20.4;  // inside the deadband
+  step(mgr, 2000);
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "temp"));
+
+  temp = 20.6;  // past it, measured from the last report (20.0)
+  step(mgr);
+  TEST_ASSERT_EQUAL_size_t(2, reportsOf(proc, "temp"));
+  TEST_ASSERT_TRUE(lastValue(proc) == 20.6);
+
+  temp = 25.0;  // past it again, but within minIntervalMs
+  step(mgr);
+  step(mgr);
+  TEST_ASSERT_EQUAL_size_t(2, reportsOf(proc, "temp"));
+  step(mgr, 1000);
+  TEST_ASSERT_EQUAL_size_t(3, reportsOf(proc, "temp"));
+  TEST_ASSERT_TRUE(lastValue(proc) == 25.0);
+
+  ReportStats stats = mgr.getReportStats();
+  TEST_ASSERT_EQUAL_UINT32(3, stats.reports);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.held);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.heartbeats);
+  TEST_ASSERT_EQUAL_UINT32(6, stats.samples);
+}
+
+void test_percent_deadband() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  long flow = 1000;
+  mgr.variable("flow", &flow);
+  ReportPolicy policy;
+  policy.deadbandPercent = 10;
+  policy.minIntervalMs = 0;
+  mgr.report("flow", policy);
+  step(mgr);
+
+  flow = 1090;
+  step(mgr);
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "flow"));
+  flow = 1100;
+  step(mgr);
+  TEST_ASSERT_EQUAL_size_t(2, reportsOf(proc, "flow"));
+  flow = 1000;  // 100 is under 10% of 1100
+  step(mgr);
+  TEST_ASSERT_EQUAL_size_t(2, reportsOf(proc, "flow"));
+}
+
+void test_heartbeat_reports_unchanged_values() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int level = 3;
+  mgr.variable("level", &level);
+  ReportPolicy policy;
+  policy.maxIntervalMs = 60000;
+  mgr.report("level", policy);
+  step(mgr);
+  step(mgr, 30000);
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "level"));
+  step(mgr, 30000);
+  TEST_ASSERT_EQUAL_size_t(2, reportsOf(proc, "level"));
+  TEST_ASSERT_EQUAL_UINT32(1, mgr.getReportStats().heartbeats);
+
+  level = 4;  // no deadband: any change
+  step(mgr, 1000);
+  TEST_ASSERT_EQUAL_size_t(3, reportsOf(proc, "level"));
+}
+
+void test_text_and_getter_variables() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  String state = "idle";
+  int reads = 0;
+  double volts = 3.7;
+  mgr.variable("state", &state);
+  mgr.variable("volts", [&]() {
+    reads++;
+    return volts;
+  });
+  ReportPolicy policy;
+  policy.minIntervalMs = 0;
+  policy.deadband = 0.1;
+  mgr.report("state", policy);  // the deadband does not apply to text
+  mgr.report("volts", policy);
+  TEST_ASSERT_EQUAL_INT(0, reads);
+
+  step(mgr);
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "state"));
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "volts"));
+  state = "pumping";
+  volts = 3.65;
+  step(mgr);
+  TEST_ASSERT_EQUAL_size_t(2, reportsOf(proc, "state"));
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "volts"));
+  TEST_ASSERT_TRUE(reads >= 2);  // sampled each time
+}
+
+// Sampling, reporting and answering a request all call the one getter, so a
+// stateful getter keeps a single state across them.
+void test_stateful_getter_is_shared_by_reports_and_requests() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  mgr.variable("calls", [n = 0]() mutable { return ++n; });
+  ReportPolicy policy;
+  policy.minIntervalMs = 0;
+  mgr.report("calls", policy);
+
+  step(mgr);  // sampled (1), then written into the report (2)
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "calls"));
+  TEST_ASSERT_EQUAL_DOUBLE(2, lastValue(proc));
+
+  char buf[RESULT_PAYLOAD_BYTES];
+  size_t n = mgr.runVariable("Hy/Post/Variable/testdevice0001/calls/r1", "", buf, sizeof(buf));
+  TEST_ASSERT_TRUE(n > 0 && n < sizeof(buf));
+  JsonDocument doc;
+  deserializeJson(doc, buf, n);
+  TEST_ASSERT_EQUAL_INT(3, doc["value"].as<int>());
+}
+
+void test_stop_reporting_and_unknown_names() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int n = 1;
+  mgr.variable("n", &n);
+  TEST_ASSERT_FALSE(mgr.report("missing"));
+  TEST_ASSERT_TRUE(mgr.report("n"));
+  step(mgr);
+  TEST_ASSERT_TRUE(mgr.stopReporting("n"));
+  TEST_ASSERT_FALSE(mgr.stopReporting("n"));
+  n = 2;
+  step(mgr, 5000);
+  TEST_ASSERT_EQUAL_size_t(1, reportsOf(proc, "n"));
+  TEST_ASSERT_EQUAL_UINT32(1, mgr.getReportStats().samples);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_absolute_deadband_and_min_interval);
+  RUN_TEST(test_percent_deadband);
+  RUN_TEST(test_heartbeat_reports_unchanged_values);
+  RUN_TEST(test_text_and_getter_variables);
+  RUN_TEST(test_stateful_getter_is_shared_by_reports_and_requests);
+  RUN_TEST(test_stop_reporting_and_unknown_names);
+  return UNITY_END();
+}
@@ -0,0 +1,181 @@
+// Native test matrix for the variable registry: every type variable<T>() takes
+// through a pointer, fixed char arrays, and getter variables, each read back
+// through runVariable() as the "value" field of the result JSON, and the
+// VARIABLE_COUNT_MAX limit reported back to the caller.
+#include <unity.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "managers/SubscriptionManager.h"
+#include "mocks/FakeProcessor.h"
+
+namespace {
+// The raw "value" of a variable's result, e.g. `42` or `"text"`.
+void expectValue(SubscriptionManager& mgr, const char* key, const char* expected) {
+  std::string topic = std::string("Hy/Post/Variable/testdevice0001/") + key + "/r1";
+  char buf[RESULT_PAYLOAD_BYTES];
+  size_t n = mgr.runVariable(topic.c_str(), "", buf, sizeof(buf));
+  TEST_ASSERT_TRUE(n > 0 && n < sizeof(buf));
+  std::string json(buf, n);
+  std::string head = std::string("{\"key\":\"") + key + "\",\"id\":\"testdevice0001\",\"request\":\"r1\",\"value\":";
+  TEST_ASSERT_TRUE(json.compare(0, head.size(), head) == 0);
+  std::string value = json.substr(head.size(), json.size() - head.size() - 1);
+  TEST_ASSERT_EQUAL_STRING(expected, value.c_str());
+}
+
+int fortyTwo() { return 42; }
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_pointer_types() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  bool b = true;
+  int8_t i8 = -8;
+  uint8_t u8 = 200;
+  int16_t i16 = -16000;
+  uint16_t u16 = 65000;
+  int i = -7;
+  unsigned u = 7;
+  long l = -123456;
+  unsigned long ul = 123456;
+  int32_t i32 = std::numeric_limits<int32_t>::min();
+  uint32_t u32 = std::numeric_limits<uint32_t>::max();
+  int64_t i64 = std::numeric_limits<int64_t>::min();
+  uint64_t u64 = std::numeric_limits<uint64_t>::max();
+  float f = 2.5f;
+  double d = 3.14;
+  String s = "say \"hi\"";
+  std::string ss = "std";
+  const int ci = 9;
+
+  mgr.variable("b", &b);
+  mgr.variable("i8", &i8);
+  mgr.variable("u8", &u8);
+  mgr.variable("i16", &i16);
+  mgr.variable("u16", &u16);
+  mgr.variable("i", &i);
+  mgr.variable("u", &u);
+  mgr.variable("l", &l);
+  mgr.variable("ul", &ul);
+  mgr.variable("i32", &i32);
+  mgr.variable("u32", &u32);
+  mgr.variable("i64", &i64);
+  mgr.variable("u64", &u64);
+  mgr.variable("f", &f);
+  mgr.variable("d", &d);
+  mgr.variable("s", &s);
+  mgr.variable("ss", &ss);
+  mgr.variable("ci", &ci);
+
+  expectValue(mgr, "b", "true");
+  expectValue(mgr, "i8", "-8");
+  expectValue(mgr, "u8", "200");
+  expectValue(mgr, "i16", "-16000");
+  expectValue(mgr, "u16", "65000");
+  expectValue(mgr, "i", "-7");
+  expectValue(mgr, "u", "7");
+  expectValue(mgr, "l", "-123456");
+  expectValue(mgr, "ul", "123456");
+  expectValue(mgr, "i32", "-2147483648");
+  expectValue(mgr, "u32", "4294967295");
+  expectValue(mgr, "i64", "-9223372036854775808");
+  expectValue(mgr, "u64", "18446744073709551615");
+  expectValue(mgr, "f", "2.5");
+  expectValue(mgr, "d", "3.14");
+  expectValue(mgr, "s", "\"say \\\"hi\\\"\"");
+  expectValue(mgr, "ss", "\"std\"");
+  expectValue(mgr, "ci", "9");
+
+  // values are read when requested, not when registered
+  b = false;
+  u32 = 1;
+  s = "new";
+  expectValue(mgr, "b", "false");
+  expectValue(mgr, "u32", "1");
+  expectValue(mgr, "s", "\"new\"");
+}
+
+void test_char_arrays() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  char name[16] = "pump-1";
+  char full[4] = {'a', 'b', 'c', 'd'};  // no terminator: read up to its size
+  mgr.variable("name", name);
+  mgr.variable("full", full);
+  expectValue(mgr, "name", "\"pump-1\"");
+  expectValue(mgr, "full", "\"abcd\"");
+  strcpy(name, "pump-2");
+  expectValue(mgr, "name", "\"pump-2\"");
+}
+
+void test_getters_run_only_when_requested() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int calls = 0;
+  String label = "computed";
+  mgr.variable("count", [&calls]() { return ++calls; });
+  mgr.variable("ratio", []() { return 0.25; });
+  mgr.variable("label", [&label]() { return label; });
+  mgr.variable("text", []() { return "literal"; });
+  mgr.variable("flag", []() { return true; });
+  mgr.variable("big", []() { return (int64_t)1 << 40; });
+  mgr.variable("fn", fortyTwo);
+  mgr.variable("fnptr", &fortyTwo);
+  int counter = 0;
+  mgr.variable("mutable", [counter]() mutable { return ++counter; });
+
+  TEST_ASSERT_EQUAL_INT(0, calls);
+  expectValue(mgr, "count", "1");
+  expectValue(mgr, "count", "2");
+  TEST_ASSERT_EQUAL_INT(2, calls);
+  expectValue(mgr, "ratio", "0.25");
+  expectValue(mgr, "label", "\"computed\"");
+  expectValue(mgr, "text", "\"literal\"");
+  expectValue(mgr, "flag", "true");
+  expectValue(mgr, "big", "1099511627776");
+  expectValue(mgr, "fn", "42");
+  expectValue(mgr, "fnptr", "42");
+  expectValue(mgr, "mutable", "1");
+  expectValue(mgr, "mutable", "2");
+}
+
+void test_reregistering_changes_the_type() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int n = 5;
+  String s = "five";
+  mgr.variable("v", &n);
+  expectValue(mgr, "v", "5");
+  mgr.variable("v", &s);
+  expectValue(mgr, "v", "\"five\"");
+  mgr.variable("v", []() { return 5.5; });
+  expectValue(mgr, "v", "5.5");
+}
+
+void test_registering_past_the_limit_fails() {
+  FakeProcessor proc;
+  SubscriptionManager mgr(proc);
+  int n = 5;
+  for (int i = 0; i < VARIABLE_COUNT_MAX; i++) {
+    TEST_ASSERT_TRUE(mgr.variable(("v" + std::to_string(i)).c_str(), &n));
+  }
+  TEST_ASSERT_FALSE(mgr.variable("extra", &n));
+  TEST_ASSERT_FALSE(mgr.variable("extra", []() { return 1; }));
+  TEST_ASSERT_TRUE(mgr.variable("v0", []() { return 6; }));  // repointing needs no room
+  expectValue(mgr, "v0", "6");
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pointer_types);
+  RUN_TEST(test_char_arrays);
+  RUN_TEST(test_getters_run_only_when_requested);
+  RUN_TEST(test_reregistering_changes_the_type);
+  RUN_TEST(test_registering_past_the_limit_fails);
+  return UNITY_END();
+}